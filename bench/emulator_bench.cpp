@@ -0,0 +1,169 @@
+#include <benchmark/benchmark.h>
+#include "bus.h"
+#include "flatbus.h"
+#include "batch.h"
+#include "instructions.h"
+#include <algorithm>
+#include <vector>
+
+// Cycles emulated per benchmark iteration
+static constexpr int32_t SLICE_CYCLES = 100000;
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      KERNELS                                                                                      KERNELS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+// Each kernel is loaded at 0x8000 and loops forever
+
+// Tight countdown loop, dominated by taken branches
+static const vector<uint8_t> branch_loop = {
+	INS_LDX_IM, 0x00,         // 8000: LDX #$00
+	INS_DEX,                  // 8002: DEX
+	INS_BNE, 0xFD,            // 8003: BNE $8002
+	INS_JMP_ABS, 0x00, 0x80,  // 8005: JMP $8000
+};
+
+// Copy a page of memory with indexed loads and stores
+static const vector<uint8_t> memcpy_loop = {
+	INS_LDY_IM, 0x00,         // 8000: LDY #$00
+	INS_LDA_ABSY, 0x00, 0x02, // 8002: LDA $0200,Y
+	INS_STA_ABSY, 0x00, 0x03, // 8005: STA $0300,Y
+	INS_INY,                  // 8008: INY
+	INS_BNE, 0xF7,            // 8009: BNE $8002
+	INS_JMP_ABS, 0x00, 0x80,  // 800B: JMP $8000
+};
+
+// Nested subroutine calls
+static const vector<uint8_t> call_loop = {
+	INS_JSR_ABS, 0x10, 0x80,  // 8000: JSR $8010
+	INS_JSR_ABS, 0x10, 0x80,  // 8003: JSR $8010
+	INS_JSR_ABS, 0x13, 0x80,  // 8006: JSR $8013
+	INS_JMP_ABS, 0x00, 0x80,  // 8009: JMP $8000
+	INS_NOP, INS_NOP, INS_NOP, INS_NOP,
+	INS_JSR_ABS, 0x13, 0x80,  // 8010: JSR $8013
+	INS_RTS,                  // 8013: RTS
+};
+
+// Mixed binary mode additions and subtractions
+static const vector<uint8_t> arithmetic_loop = {
+	INS_CLC,                  // 8000: CLC
+	INS_LDA_IM, 0x00,         // 8001: LDA #$00
+	INS_LDX_IM, 0x00,         // 8003: LDX #$00
+	INS_ADC_IM, 0x37,         // 8005: ADC #$37
+	INS_SBC_IM, 0x11,         // 8007: SBC #$11
+	INS_ADC_ZP, 0x10,         // 8009: ADC $10
+	INS_SBC_ZPX, 0x20,        // 800B: SBC $20,X
+	INS_DEX,                  // 800D: DEX
+	INS_BNE, 0xF5,            // 800E: BNE $8005
+	INS_JMP_ABS, 0x00, 0x80,  // 8010: JMP $8000
+};
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      HARNESS                                                                                      HARNESS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+static void LoadKernel(Bus& system, const vector<uint8_t>& program) {
+	std::copy(program.begin(), program.end(), system.rom);
+}
+
+static void LoadKernel(FlatBus& system, const vector<uint8_t>& program) {
+	std::copy(program.begin(), program.end(), system.memory + 0x8000);
+}
+
+// Measure the instruction mix of a kernel by single stepping it
+//    Run does not count instructions, so the instructions/s counter is derived from the cycle
+//    count and this ratio rather than slowing down the timed loop.
+template<typename System>
+static double MeasureInstructionsPerCycle(const vector<uint8_t>& program) {
+	System system;
+	LoadKernel(system, program);
+
+	int64_t instructions = 0;
+	int64_t cycles = 0;
+	while (cycles < SLICE_CYCLES) {
+		system.cpu.Run(1);
+		cycles += system.cpu.Cycles;
+		instructions++;
+	}
+	return static_cast<double>(instructions) / cycles;
+}
+
+template<typename System>
+static void RunKernel(benchmark::State& state, const vector<uint8_t>& program, bool blockCache = false, bool jit = false) {
+	const double instructionsPerCycle = MeasureInstructionsPerCycle<System>(program);
+
+	System system;
+	LoadKernel(system, program);
+	system.cpu.EnableBlockCache(blockCache);
+	system.cpu.EnableJit(jit);
+
+	int64_t cycles = 0;
+	for (auto _ : state) {
+		int status = system.cpu.Run(SLICE_CYCLES);
+		if (status < 0) {
+			state.SkipWithError("emulator stopped with an error status");
+			break;
+		}
+		cycles += system.cpu.Cycles;
+	}
+
+	state.counters["cycles/s"] = benchmark::Counter(static_cast<double>(cycles), benchmark::Counter::kIsRate);
+	state.counters["instructions/s"] = benchmark::Counter(cycles * instructionsPerCycle, benchmark::Counter::kIsRate);
+}
+
+static void BM_Bus(benchmark::State& state, const vector<uint8_t>& program) {
+	RunKernel<Bus>(state, program);
+}
+
+static void BM_BusCached(benchmark::State& state, const vector<uint8_t>& program) {
+	RunKernel<Bus>(state, program, true);
+}
+
+static void BM_BusJit(benchmark::State& state, const vector<uint8_t>& program) {
+	RunKernel<Bus>(state, program, true, true);
+}
+
+static void BM_FlatBus(benchmark::State& state, const vector<uint8_t>& program) {
+	RunKernel<FlatBus>(state, program);
+}
+
+// Many instances of a kernel in lockstep, for comparison with the per-instance numbers above
+static void BM_Batch(benchmark::State& state, const vector<uint8_t>& program) {
+	const double instructionsPerCycle = MeasureInstructionsPerCycle<FlatBus>(program);
+
+	CpuBatch batch(static_cast<int>(state.range(0)));
+	std::copy(program.begin(), program.end(), batch.rom);
+
+	int64_t cycles = 0;
+	for (auto _ : state) {
+		batch.Run(SLICE_CYCLES / 100);
+		for (int lane = 0; lane < batch.Size(); lane++)
+			cycles += batch.Cycles[lane];
+	}
+
+	state.counters["cycles/s"] = benchmark::Counter(static_cast<double>(cycles), benchmark::Counter::kIsRate);
+	state.counters["instructions/s"] = benchmark::Counter(cycles * instructionsPerCycle, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_CAPTURE(BM_Bus, BranchLoop, branch_loop);
+BENCHMARK_CAPTURE(BM_Bus, MemcpyLoop, memcpy_loop);
+BENCHMARK_CAPTURE(BM_Bus, CallLoop, call_loop);
+BENCHMARK_CAPTURE(BM_Bus, ArithmeticLoop, arithmetic_loop);
+
+BENCHMARK_CAPTURE(BM_BusCached, BranchLoop, branch_loop);
+BENCHMARK_CAPTURE(BM_BusCached, MemcpyLoop, memcpy_loop);
+BENCHMARK_CAPTURE(BM_BusCached, CallLoop, call_loop);
+BENCHMARK_CAPTURE(BM_BusCached, ArithmeticLoop, arithmetic_loop);
+
+BENCHMARK_CAPTURE(BM_BusJit, BranchLoop, branch_loop);
+BENCHMARK_CAPTURE(BM_BusJit, MemcpyLoop, memcpy_loop);
+BENCHMARK_CAPTURE(BM_BusJit, CallLoop, call_loop);
+BENCHMARK_CAPTURE(BM_BusJit, ArithmeticLoop, arithmetic_loop);
+
+BENCHMARK_CAPTURE(BM_FlatBus, BranchLoop, branch_loop);
+BENCHMARK_CAPTURE(BM_FlatBus, MemcpyLoop, memcpy_loop);
+BENCHMARK_CAPTURE(BM_FlatBus, CallLoop, call_loop);
+BENCHMARK_CAPTURE(BM_FlatBus, ArithmeticLoop, arithmetic_loop);
+
+BENCHMARK_CAPTURE(BM_Batch, BranchLoop, branch_loop)->Arg(64);
+BENCHMARK_CAPTURE(BM_Batch, MemcpyLoop, memcpy_loop)->Arg(64);
+BENCHMARK_CAPTURE(BM_Batch, CallLoop, call_loop)->Arg(64);
+BENCHMARK_CAPTURE(BM_Batch, ArithmeticLoop, arithmetic_loop)->Arg(64);
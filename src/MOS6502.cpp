@@ -1,38 +1,82 @@
 #include "MOS6502.h"
 #include "bus.h"
-#include "mappings.h"
+#include "decode.h"
+#include "decimal.h"
+#include "flatbus.h"
+#include "batch.h"
+#include "logbus.h"
 #include "exitcodes.h"
-#include <stdexcept>
+#include "jit.h"
+#include "profiler.h"
+#include "trace.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
 
-MOS6502::MOS6502() {
+// The JIT can be switched on for a whole process, e.g. to run the test suite through it:
+//    MOS6502_JIT=on    -- compile blocks once they are hot
+//    MOS6502_JIT=force -- compile every block the first time it runs
+//    Read once, the first time a core is created.
+enum class JitMode { OFF, ON, FORCE };
 
+static JitMode EnvironmentJitMode() {
+	static const JitMode mode = [] {
+		const char* value = std::getenv("MOS6502_JIT");
+		if (value && std::strcmp(value, "on") == 0)
+			return JitMode::ON;
+		if (value && std::strcmp(value, "force") == 0)
+			return JitMode::FORCE;
+		return JitMode::OFF;
+	}();
+	return mode;
 }
 
-MOS6502::~MOS6502() {
+template<typename BusT>
+MOS6502Core<BusT>::MOS6502Core() {
+	switch (EnvironmentJitMode()) {
+	case JitMode::ON:
+		EnableJit(true);
+		break;
+	case JitMode::FORCE:
+		EnableJit(true, 0);
+		break;
+	case JitMode::OFF:
+		break;
+	}
+}
+
+template<typename BusT>
+MOS6502Core<BusT>::~MOS6502Core() {
 
 }
 
 // Read from the bus
-uint8_t MOS6502::BusRead(uint16_t addr)
+template<typename BusT>
+uint8_t MOS6502Core<BusT>::BusRead(uint16_t addr)
 {
 	return bus->read(addr);
 }
 
 // Write to the bus
-void MOS6502::BusWrite(uint16_t addr, uint8_t data)
+template<typename BusT>
+void MOS6502Core<BusT>::BusWrite(uint16_t addr, uint8_t data)
 {
 	bus->write(addr, data);
 }
 
 // Read a byte from a given memory address
-uint8_t MOS6502::ReadByte(uint16_t addr)
+template<typename BusT>
+uint8_t MOS6502Core<BusT>::ReadByte(uint16_t addr)
 {
 	Cycles++;
 	return BusRead(addr);
 }
 
 // Read a word from a given memory address
-uint16_t MOS6502::ReadWord(uint16_t addr)
+template<typename BusT>
+uint16_t MOS6502Core<BusT>::ReadWord(uint16_t addr)
 {
 	Cycles += 2;
 	uint16_t low = BusRead(addr);
@@ -41,14 +85,16 @@ uint16_t MOS6502::ReadWord(uint16_t addr)
 }
 
 // Write a byte to a given memory address
-void MOS6502::WriteByte(uint16_t addr, uint8_t data)
+template<typename BusT>
+void MOS6502Core<BusT>::WriteByte(uint16_t addr, uint8_t data)
 {
 	Cycles++;
 	BusWrite(addr, data);
 }
 
 // Write a word to a given memory address
-void MOS6502::WriteWord(uint16_t addr, uint16_t data)
+template<typename BusT>
+void MOS6502Core<BusT>::WriteWord(uint16_t addr, uint16_t data)
 {
 	Cycles += 2;
 	BusWrite(addr, data & 0x00FF);
@@ -56,14 +102,27 @@ void MOS6502::WriteWord(uint16_t addr, uint16_t data)
 }
 
 // Fetch the next byte from the program counter
-uint8_t MOS6502::FetchByte()
+template<typename BusT>
+uint8_t MOS6502Core<BusT>::FetchByte()
 {
 	Cycles++;
 	return BusRead(PC++);
 }
 
+// Fetch an opcode from the program counter. Buses with breakpoints see these apart from other reads
+template<typename BusT>
+uint8_t MOS6502Core<BusT>::FetchOpcode()
+{
+	Cycles++;
+	if constexpr (requires(BusT& b) { b.fetch(uint16_t{}); })
+		return bus->fetch(PC++);
+	else
+		return BusRead(PC++);
+}
+
 // Fetch the next word from the program counter
-uint16_t MOS6502::FetchWord()
+template<typename BusT>
+uint16_t MOS6502Core<BusT>::FetchWord()
 {
 	Cycles += 2;
 	uint16_t low = BusRead(PC++);
@@ -71,15 +130,47 @@ uint16_t MOS6502::FetchWord()
 	return (high << 8) | low;
 }
 
+// Fetch a one byte operand
+template<typename BusT>
+template<bool predecoded>
+uint8_t MOS6502Core<BusT>::OperandByte()
+{
+	if constexpr (predecoded) {
+		Cycles++;
+		PC++;
+		return static_cast<uint8_t>(operand);
+	}
+	else {
+		return FetchByte();
+	}
+}
+
+// Fetch a two byte operand
+template<typename BusT>
+template<bool predecoded>
+uint16_t MOS6502Core<BusT>::OperandWord()
+{
+	if constexpr (predecoded) {
+		Cycles += 2;
+		PC += 2;
+		return operand;
+	}
+	else {
+		return FetchWord();
+	}
+}
+
 // Push a byte to the stack
-void MOS6502::PushStack(uint8_t data)
+template<typename BusT>
+void MOS6502Core<BusT>::PushStack(uint8_t data)
 {
 	Cycles += 2;
 	BusWrite(0x0100 | SP--, data);
 }
 
 // Pull a byte from the stack
-uint8_t MOS6502::PullStack()
+template<typename BusT>
+uint8_t MOS6502Core<BusT>::PullStack()
 {
 	Cycles += 2;
 	uint8_t data = BusRead(0x0100 | ++SP);
@@ -87,19 +178,48 @@ uint8_t MOS6502::PullStack()
 }
 
 // Set a given flag to a given T/F value
-void MOS6502::SetFlag(uint8_t flag, bool value) {
+template<typename BusT>
+void MOS6502Core<BusT>::SetFlag(uint8_t flag, bool value) {
 	(value) ? P |= flag : P &= ~flag;
 }
 
+// Read a given flag, resolving the lazily tracked Z and N flags
+template<typename BusT>
+bool MOS6502Core<BusT>::GetFlag(uint8_t flag) const {
+	if (flag == Z)
+		return lazyZ == 0;
+	if (flag == N)
+		return lazyN & N;
+	return P & flag;
+}
+
 // Set the Z and N flags with respect to a byte of data; Very common result of many opcodes
-void MOS6502::UpdateZNFlags(uint8_t data) {
-	SetFlag(Z, data == 0);
-	SetFlag(N, data & N);
+//    Only records the data, the flags are derived from it when read
+template<typename BusT>
+void MOS6502Core<BusT>::UpdateZNFlags(uint8_t data) {
+	lazyZ = data;
+	lazyN = data;
+}
+
+// Get the full processor status byte with the lazy flags folded in
+template<typename BusT>
+uint8_t MOS6502Core<BusT>::GetStatus() const {
+	return (P & ~(Z | N)) | ((lazyZ == 0) ? Z : 0) | (lazyN & N);
+}
+
+// Set the full processor status byte, seeding the lazy flags from it
+template<typename BusT>
+void MOS6502Core<BusT>::SetStatus(uint8_t value) {
+	P = value;
+	lazyZ = (value & Z) ? 0 : 1;
+	lazyN = value;
 }
 
 // Branch to a new address based on the current program counter and an offset
-void MOS6502::Branch() {
-	int8_t offset = static_cast<int8_t>(FetchByte());
+template<typename BusT>
+template<bool predecoded>
+void MOS6502Core<BusT>::Branch() {
+	int8_t offset = static_cast<int8_t>(OperandByte<predecoded>());
 	const uint16_t oldPC = PC;
 	PC += offset;
 	Cycles++;
@@ -108,76 +228,133 @@ void MOS6502::Branch() {
 		Cycles++;
 }
 // Branches if the given flag in the processor status matches the given T/F value
-void MOS6502::MaybeBranch(uint8_t flag, bool value) {
-	(P & flag) == ((value) ? flag : 0) ? Branch() : (void) FetchByte();
+template<typename BusT>
+template<bool predecoded>
+void MOS6502Core<BusT>::MaybeBranch(uint8_t flag, bool value) {
+	GetFlag(flag) == value ? Branch<predecoded>() : (void) OperandByte<predecoded>();
 }
 
 // Reset CPU
-void MOS6502::Reset() {
+template<typename BusT>
+void MOS6502Core<BusT>::Reset() {
 	Cycles = -2;
 	PC = ReadWord(0xFFFC);
 	SP = 0xFF;
-	P = 0;
+	SetStatus(0);
 	A = X = Y = 0;
 }
 
+// Add with carry, honoring decimal mode
+template<typename BusT>
+void MOS6502Core<BusT>::AddWithCarry(uint8_t data) {
+	uint16_t result = A + data + (P & C);
+	uint8_t byte_result = result & 0xFF;
+	if (P & D) {
+		// Z follows the binary sum, N, V and C come from the decimal tables
+		uint16_t low = adc_low_table[((P & C) << 8) | ((A & 0x0F) << 4) | (data & 0x0F)];
+		uint16_t high = adc_high_table[((low & DECIMAL_CARRY) << 4) | (A & 0xF0) | (data >> 4)];
+		uint8_t flags = high >> 8;
+		SetFlag(V, flags & DECIMAL_FLAG_V);
+		SetFlag(C, flags & DECIMAL_FLAG_C);
+		A = (high & 0xF0) | (low & 0x0F);
+		lazyZ = byte_result;
+		lazyN = flags;
+		return;
+	}
+	SetFlag(V, (A ^ byte_result) & (data ^ byte_result) & N);
+	SetFlag(C, result & 0xFF00);
+	A = byte_result;
+	UpdateZNFlags(A);
+}
+
+// Subtract with borrow, honoring decimal mode
+template<typename BusT>
+void MOS6502Core<BusT>::SubtractWithBorrow(uint8_t data) {
+	uint16_t result = A + static_cast<uint8_t>(~data) + (P & C);
+	uint8_t byte_result = result & 0xFF;
+	uint8_t decimal_result = 0;
+	if (P & D) {
+		// Only the accumulator differs from the binary subtraction
+		uint8_t borrow = !(P & C);
+		uint16_t low = sbc_low_table[(borrow << 8) | ((A & 0x0F) << 4) | (data & 0x0F)];
+		uint16_t high = sbc_high_table[((low & DECIMAL_CARRY) << 4) | (A & 0xF0) | (data >> 4)];
+		decimal_result = (high & 0xF0) | (low & 0x0F);
+	}
+	SetFlag(V, (A ^ byte_result) & (A ^ data) & N);
+	SetFlag(C, result & 0xFF00);
+	UpdateZNFlags(byte_result);
+	A = (P & D) ? decimal_result : byte_result;
+}
+
+// Compare a register with a value
+template<typename BusT>
+void MOS6502Core<BusT>::Compare(uint8_t reg, uint8_t data) {
+	uint8_t result = reg - data;
+	UpdateZNFlags(result);
+	SetFlag(C, reg >= data);
+}
+
 // Acquires the effective address of the current instruction. Useful for instructions that write to memory
-uint16_t MOS6502::FetchAddress(Operation operation) {
-	switch (operation.mode) {
+template<typename BusT>
+template<AddressMode mode, bool predecoded>
+uint16_t MOS6502Core<BusT>::FetchAddress() {
+	switch (mode) {
 	case RELATIVE:
-		return PC + FetchByte(); // Check this works with signed numbers
+		return PC + OperandByte<predecoded>(); // Check this works with signed numbers
 	case IMMEDIATE:
 		return ++PC; // Check if this is even used let alone if its correct (i dont think the answer to either is yes)
 	case ABSOLUTE:
-		return FetchWord();
+		return OperandWord<predecoded>();
 	case ZERO_PAGE:
-		return 0x0000 | FetchByte();
+		return 0x0000 | OperandByte<predecoded>();
 	case ABS_INDIRECT:
 	{
-		uint16_t abs_addr = FetchWord();
+		uint16_t abs_addr = OperandWord<predecoded>();
 		return ReadWord(abs_addr);
 	}
 	case X_ABSOLUTE:
 		Cycles++;
-		return FetchWord() + X;
+		return OperandWord<predecoded>() + X;
 	case Y_ABSOLUTE:
 		Cycles++;
-		return FetchWord() + Y;
+		return OperandWord<predecoded>() + Y;
 	case X_ZERO_PAGE:
 	{
 		Cycles++;
-		uint8_t ZPByte = FetchByte() + X;
+		uint8_t ZPByte = OperandByte<predecoded>() + X;
 		return 0x0000 | ZPByte;
 	}
 	case Y_ZERO_PAGE:
 	{
 		Cycles++;
-		uint8_t ZPByte = FetchByte() + Y;
+		uint8_t ZPByte = OperandByte<predecoded>() + Y;
 		return 0x0000 | ZPByte;
 	}
 	case X_INDEX_ZP_INDIRECT:
 	{
 		Cycles++;
-		uint8_t ZPByte = FetchByte() + X;
+		uint8_t ZPByte = OperandByte<predecoded>() + X;
 		return ReadWord(0x0000 | ZPByte);
 	}
 	case ZP_INDIRECT_Y_INDEX: // is this used? must be yeah?
 		Cycles++;
-		return ReadWord(0x0000 | FetchByte()) + Y;
+		return ReadWord(0x0000 | OperandByte<predecoded>()) + Y;
 	}
 	return 0; // Default return value, should not be reached
 }
 
 // Fetch data for the current instruction based on address mode
-uint8_t MOS6502::FetchData(Operation operation) {
-	switch (operation.mode) {
+template<typename BusT>
+template<AddressMode mode, bool predecoded>
+uint8_t MOS6502Core<BusT>::FetchData() {
+	switch (mode) {
 	case ACCUMULATOR:
 		return A;
 	case IMMEDIATE:
-		return FetchByte();
+		return OperandByte<predecoded>();
 	case X_ABSOLUTE:
 	{
-		uint16_t addr = FetchWord();
+		uint16_t addr = OperandWord<predecoded>();
 		uint8_t high = addr >> 8;
 		addr += X;
 		if (addr >> 8 != high)
@@ -186,7 +363,7 @@ uint8_t MOS6502::FetchData(Operation operation) {
 	}
 	case Y_ABSOLUTE:
 	{
-		uint16_t addr = FetchWord();
+		uint16_t addr = OperandWord<predecoded>();
 		uint8_t high = addr >> 8;
 		addr += Y;
 		if (addr >> 8 != high)
@@ -195,7 +372,7 @@ uint8_t MOS6502::FetchData(Operation operation) {
 	}
 	case ZP_INDIRECT_Y_INDEX:
 	{
-		uint16_t ind_addr = ReadWord(0x0000 | FetchByte());
+		uint16_t ind_addr = ReadWord(0x0000 | OperandByte<predecoded>());
 		uint8_t high = ind_addr >> 8;
 		ind_addr += Y;
 		if (ind_addr >> 8 != high)
@@ -203,49 +380,96 @@ uint8_t MOS6502::FetchData(Operation operation) {
 		return ReadByte(ind_addr);
 	}
 	default:
-		return ReadByte(FetchAddress(operation));
+		return ReadByte(FetchAddress<mode, predecoded>());
 	}
 }
 
+// Build the opcode handler table
+//    Each opcode gets its own handler, specialized on the instruction and address mode decoded for
+//    it, so executing an instruction is a single indirect call with no switch on either.
+template<typename BusT>
+template<const array<Operation, 256>& table, bool predecoded, size_t... opcodes>
+constexpr array<typename MOS6502Core<BusT>::Handler, 256> MOS6502Core<BusT>::ConstructHandlerTable(index_sequence<opcodes...>) {
+	return { &MOS6502Core::Dispatch<table[opcodes].instruction, table[opcodes].mode, predecoded>... };
+}
+
+template<typename BusT>
+const array<typename MOS6502Core<BusT>::Handler, 256> MOS6502Core<BusT>::handler_table = ConstructHandlerTable<decode_table, false>(make_index_sequence<256>{});
+
+template<typename BusT>
+const array<typename MOS6502Core<BusT>::Handler, 256> MOS6502Core<BusT>::nmos_handler_table = ConstructHandlerTable<nmos_decode_table, false>(make_index_sequence<256>{});
+
+template<typename BusT>
+const array<typename MOS6502Core<BusT>::Handler, 256> MOS6502Core<BusT>::predecoded_table = ConstructHandlerTable<decode_table, true>(make_index_sequence<256>{});
+
+template<typename BusT>
+const array<typename MOS6502Core<BusT>::Handler, 256> MOS6502Core<BusT>::nmos_predecoded_table = ConstructHandlerTable<nmos_decode_table, true>(make_index_sequence<256>{});
+
+// Switch between the legal opcodes only and the legal plus stable undocumented NMOS opcodes
+template<typename BusT>
+void MOS6502Core<BusT>::EnableUndocumented(bool enable) {
+	undocumented = enable;
+	handlers = enable ? nmos_handler_table.data() : handler_table.data();
+	FlushBlockCache();
+}
+
 // Fetch the next operation from memory
-Operation MOS6502::FetchOperation() {
-	uint8_t opcode = FetchByte();
-	Operation operation;
-	try {
-		operation = instruction_opcode_bimap.right.at(opcode);
-	}
-	catch (std::out_of_range& e) {
-		operation = Operation{ Instruction::INVALID, UNKNOWN };
-		status = E_INV;
-	}
-	return operation;
+template<typename BusT>
+typename MOS6502Core<BusT>::Handler MOS6502Core<BusT>::FetchOperation() {
+	// The fetch may stop at a breakpoint by switching the table, so read it afterwards
+	const uint8_t opcode = FetchOpcode();
+	return handlers[opcode];
+}
+
+template<typename BusT>
+const std::array<typename MOS6502Core<BusT>::Handler, 256> MOS6502Core<BusT>::halt_table = [] {
+	std::array<Handler, 256> table;
+	table.fill(&MOS6502Core::Halt);
+	return table;
+}();
+
+template<typename BusT>
+void MOS6502Core<BusT>::Break(int code) {
+	status = code;
+	handlers = halt_table.data();
+}
+
+// Undo the opcode fetch, leaving the instruction to run when execution resumes
+template<typename BusT>
+void MOS6502Core<BusT>::Halt(MOS6502Core& cpu) {
+	cpu.handlers = cpu.undocumented ? nmos_handler_table.data() : handler_table.data();
+	cpu.PC--;
+	cpu.Cycles--;
 }
 
 // Execute the current instruction
-void MOS6502::ExecuteOperation(Operation operation) {
-	switch (operation.instruction) {
+template<typename BusT>
+template<Instruction instruction, AddressMode mode, bool predecoded>
+void MOS6502Core<BusT>::ExecuteOperation() {
+	switch (instruction) {
 	case Instruction::INVALID:
+		status = E_INV;
 		return;
 	case Instruction::LDA:
-		A = FetchData(operation);
+		A = FetchData<mode, predecoded>();
 		UpdateZNFlags(A);
 		return;
 	case Instruction::LDX:
-		X = FetchData(operation);
+		X = FetchData<mode, predecoded>();
 		UpdateZNFlags(X);
 		return;
 	case Instruction::LDY:
-		Y = FetchData(operation);
+		Y = FetchData<mode, predecoded>();
 		UpdateZNFlags(Y);
 		return;
 	case Instruction::STA:
-		WriteByte(FetchAddress(operation), A);
+		WriteByte(FetchAddress<mode, predecoded>(), A);
 		return;
 	case Instruction::STX:
-		WriteByte(FetchAddress(operation), X);
+		WriteByte(FetchAddress<mode, predecoded>(), X);
 		return;
 	case Instruction::STY:
-		WriteByte(FetchAddress(operation), Y);
+		WriteByte(FetchAddress<mode, predecoded>(), Y);
 		return;
 	case Instruction::TAX:
 		Cycles++;
@@ -280,7 +504,7 @@ void MOS6502::ExecuteOperation(Operation operation) {
 		PushStack(A);
 		return;
 	case Instruction::PHP:
-		PushStack(P);
+		PushStack(GetStatus());
 		return;
 	case Instruction::PLA:
 		Cycles++;
@@ -289,80 +513,49 @@ void MOS6502::ExecuteOperation(Operation operation) {
 		return;
 	case Instruction::PLP:
 		Cycles++;
-		P = PullStack();
+		SetStatus(PullStack());
+		UnmaskIRQ();
 		return;
 	case Instruction::AND:
-		A = A & FetchData(operation);
+		A = A & FetchData<mode, predecoded>();
 		UpdateZNFlags(A);
 		return;
 	case Instruction::EOR:
-		A = A ^ FetchData(operation);
+		A = A ^ FetchData<mode, predecoded>();
 		UpdateZNFlags(A);
 		return;
 	case Instruction::ORA:
-		A = A | FetchData(operation);
+		A = A | FetchData<mode, predecoded>();
 		UpdateZNFlags(A);
 		return;
 	case Instruction::BIT:
 	{
-		uint8_t data = FetchData(operation);
+		uint8_t data = FetchData<mode, predecoded>();
 		uint8_t result = A & data;
-		UpdateZNFlags(result);
+		lazyZ = result;
+		lazyN = data;
 		SetFlag(V, data & V);
-		SetFlag(N, data & N);
 		return;
 	}
 	case Instruction::ADC:
-	{
-		uint8_t data = FetchData(operation);
-		uint16_t result = A + data + (P & C);
-		uint8_t byte_result = result & 0xFF;
-		SetFlag(V, (A ^ byte_result) & (data ^ byte_result) & N);
-		SetFlag(C, result & 0xFF00);
-		A = byte_result;
-		UpdateZNFlags(A);
+		AddWithCarry(FetchData<mode, predecoded>());
 		return;
-	}
 	case Instruction::SBC:
-	{
-		uint8_t data = FetchData(operation);
-		data = ~data;
-		uint16_t result = A + data + (P & C);
-		uint8_t byte_result = result & 0xFF;
-		SetFlag(V, (A ^ byte_result) & (A ^ ~data) & N);
-		SetFlag(C, !(result & 0xFF00));
-		A = byte_result;
-		UpdateZNFlags(A);
+		SubtractWithBorrow(FetchData<mode, predecoded>());
 		return;
-	}
 	case Instruction::CMP:
-	{
-		uint8_t data = FetchData(operation);
-		uint8_t result = A - data;
-		UpdateZNFlags(result);
-		SetFlag(C, A >= data);
+		Compare(A, FetchData<mode, predecoded>());
 		return;
-	}
 	case Instruction::CPX:
-	{
-		uint8_t data = FetchData(operation);
-		uint8_t result = X - data;
-		UpdateZNFlags(result);
-		SetFlag(C, X >= data);
+		Compare(X, FetchData<mode, predecoded>());
 		return;
-	}
 	case Instruction::CPY:
-	{
-		uint8_t data = FetchData(operation);
-		uint8_t result = Y - data;
-		UpdateZNFlags(result);
-		SetFlag(C, Y >= data);
+		Compare(Y, FetchData<mode, predecoded>());
 		return;
-	}
 	case Instruction::INC:
 	{
 		Cycles += 1;
-		uint16_t addr = FetchAddress(operation);
+		uint16_t addr = FetchAddress<mode, predecoded>();
 		uint8_t data = ReadByte(addr);
 		data++;
 		WriteByte(addr, data);
@@ -382,7 +575,7 @@ void MOS6502::ExecuteOperation(Operation operation) {
 	case Instruction::DEC:
 	{
 		Cycles += 1;
-		uint16_t addr = FetchAddress(operation);
+		uint16_t addr = FetchAddress<mode, predecoded>();
 		uint8_t data = ReadByte(addr);
 		data--;
 		WriteByte(addr, data);
@@ -402,13 +595,13 @@ void MOS6502::ExecuteOperation(Operation operation) {
 	case Instruction::ASL:
 	{
 		Cycles++;
-		if (operation.mode == ACCUMULATOR) {
+		if constexpr (mode == ACCUMULATOR) {
 			SetFlag(C, A & N);
 			A <<= 1;
 			UpdateZNFlags(A);
 		}
 		else {
-			uint16_t addr = FetchAddress(operation);
+			uint16_t addr = FetchAddress<mode, predecoded>();
 			uint8_t data = ReadByte(addr);
 			SetFlag(C, data & N);
 			data <<= 1;
@@ -420,13 +613,13 @@ void MOS6502::ExecuteOperation(Operation operation) {
 	case Instruction::LSR:
 	{
 		Cycles++;
-		if (operation.mode == ACCUMULATOR) {
+		if constexpr (mode == ACCUMULATOR) {
 			SetFlag(C, A & C);
 			A >>= 1;
 			UpdateZNFlags(A);
 		}
 		else {
-			uint16_t addr = FetchAddress(operation);
+			uint16_t addr = FetchAddress<mode, predecoded>();
 			uint8_t data = ReadByte(addr);
 			SetFlag(C, data & C);
 			data >>= 1;
@@ -439,13 +632,13 @@ void MOS6502::ExecuteOperation(Operation operation) {
 	{
 		Cycles++;
 		uint8_t carry = P & C;
-		if (operation.mode == ACCUMULATOR) {
+		if constexpr (mode == ACCUMULATOR) {
 			SetFlag(C, A & N);
 			A = (A << 1) | carry;
 			UpdateZNFlags(A);
 		}
 		else {
-			uint16_t addr = FetchAddress(operation);
+			uint16_t addr = FetchAddress<mode, predecoded>();
 			uint8_t data = ReadByte(addr);
 			SetFlag(C, data & N);
 			data = (data << 1) | carry;
@@ -458,13 +651,13 @@ void MOS6502::ExecuteOperation(Operation operation) {
 	{
 		Cycles++;
 		uint8_t carry = (P & C) ? 0x80 : 0;
-		if (operation.mode == ACCUMULATOR) {
+		if constexpr (mode == ACCUMULATOR) {
 			SetFlag(C, A & C);
 			A = (A >> 1) | carry;
 			UpdateZNFlags(A);
 		}
 		else {
-			uint16_t addr = FetchAddress(operation);
+			uint16_t addr = FetchAddress<mode, predecoded>();
 			uint8_t data = ReadByte(addr);
 			SetFlag(C, data & C);
 			data = (data >> 1) | carry;
@@ -476,12 +669,13 @@ void MOS6502::ExecuteOperation(Operation operation) {
 	case Instruction::JMP:
 	{
 		uint16_t jmp_addr;
-		if (operation.mode == ABSOLUTE) {
-			jmp_addr = FetchWord();
+		if constexpr (mode == ABSOLUTE) {
+			jmp_addr = OperandWord<predecoded>();
 		}
 		else {
-			uint8_t  ind_low = FetchByte();
-			uint16_t ind_high = FetchByte() << 8;
+			uint16_t ind_addr = OperandWord<predecoded>();
+			uint8_t  ind_low = ind_addr & 0xFF;
+			uint16_t ind_high = ind_addr & 0xFF00;
 			uint16_t low = ReadByte(ind_high | ind_low);
 			ind_low++;
 			uint16_t high = ReadByte(ind_high | ind_low) << 8;
@@ -493,7 +687,7 @@ void MOS6502::ExecuteOperation(Operation operation) {
 	case Instruction::JSR:
 	{
 		Cycles += 1;
-		uint16_t jmp_addr = FetchAddress(operation);
+		uint16_t jmp_addr = FetchAddress<mode, predecoded>();
 		WriteByte(0x0100 | SP--, (PC - 1) >> 8);
 		WriteByte(0x0100 | SP--, (PC - 1) & 0xFF);
 		PC = jmp_addr;
@@ -508,28 +702,28 @@ void MOS6502::ExecuteOperation(Operation operation) {
 		return;
 	}
 	case Instruction::BCC:
-		MaybeBranch(C, 0);
+		MaybeBranch<predecoded>(C, 0);
 		return;
 	case Instruction::BCS:
-		MaybeBranch(C, 1);
+		MaybeBranch<predecoded>(C, 1);
 		return;
 	case Instruction::BEQ:
-		MaybeBranch(Z, 1);
+		MaybeBranch<predecoded>(Z, 1);
 		return;
 	case Instruction::BMI:
-		MaybeBranch(N, 1);
+		MaybeBranch<predecoded>(N, 1);
 		return;
 	case Instruction::BNE:
-		MaybeBranch(Z, 0);
+		MaybeBranch<predecoded>(Z, 0);
 		return;
 	case Instruction::BPL:
-		MaybeBranch(N, 0);
+		MaybeBranch<predecoded>(N, 0);
 		return;
 	case Instruction::BVC:
-		MaybeBranch(V, 0);
+		MaybeBranch<predecoded>(V, 0);
 		return;
 	case Instruction::BVS:
-		MaybeBranch(V, 1);
+		MaybeBranch<predecoded>(V, 1);
 		return;
 	case Instruction::CLC:
 		SetFlag(C, 0);
@@ -542,6 +736,7 @@ void MOS6502::ExecuteOperation(Operation operation) {
 	case Instruction::CLI:
 		SetFlag(I, 0);
 		Cycles++;
+		UnmaskIRQ();
 		return;
 	case Instruction::CLV:
 		SetFlag(V, 0);
@@ -560,29 +755,535 @@ void MOS6502::ExecuteOperation(Operation operation) {
 		Cycles++;
 		return;
 	case Instruction::BRK:
-		(void) FetchByte();
+		(void) OperandByte<predecoded>();
 		WriteByte(0x0100 | SP--, PC >> 8);
 		WriteByte(0x0100 | SP--, PC & 0xFF);
 		SetFlag(B, 1);
-		WriteByte(0x0100 | SP--, P);
+		WriteByte(0x0100 | SP--, GetStatus());
 		PC = ReadWord(0xFFFE);
 		return;
 	case Instruction::NOP:
-		Cycles++;
+		// The undocumented NOPs with an operand read it like any other instruction
+		if constexpr (mode == IMPLIED)
+			Cycles++;
+		else
+			(void) FetchData<mode, predecoded>();
 		return;
 	case Instruction::RTI:
 	{
 		Cycles += 2;
-		P = ReadByte(0x0100 | ++SP);
+		SetStatus(ReadByte(0x0100 | ++SP));
 		SetFlag(B, 0);
 		uint16_t newPC = ReadByte(0x0100 | ++SP);
 		newPC |= (ReadByte(0x0100 | ++SP) << 8);
 		PC = newPC;
+		UnmaskIRQ();
+		return;
+	}
+
+	// Undocumented NMOS instructions
+	case Instruction::SLO:
+	{
+		Cycles++;
+		uint16_t addr = FetchAddress<mode, predecoded>();
+		uint8_t data = ReadByte(addr);
+		SetFlag(C, data & N);
+		data <<= 1;
+		WriteByte(addr, data);
+		A |= data;
+		UpdateZNFlags(A);
+		return;
+	}
+	case Instruction::RLA:
+	{
+		Cycles++;
+		uint8_t carry = P & C;
+		uint16_t addr = FetchAddress<mode, predecoded>();
+		uint8_t data = ReadByte(addr);
+		SetFlag(C, data & N);
+		data = (data << 1) | carry;
+		WriteByte(addr, data);
+		A &= data;
+		UpdateZNFlags(A);
 		return;
 	}
+	case Instruction::SRE:
+	{
+		Cycles++;
+		uint16_t addr = FetchAddress<mode, predecoded>();
+		uint8_t data = ReadByte(addr);
+		SetFlag(C, data & C);
+		data >>= 1;
+		WriteByte(addr, data);
+		A ^= data;
+		UpdateZNFlags(A);
+		return;
+	}
+	case Instruction::RRA:
+	{
+		Cycles++;
+		uint8_t carry = (P & C) ? 0x80 : 0;
+		uint16_t addr = FetchAddress<mode, predecoded>();
+		uint8_t data = ReadByte(addr);
+		SetFlag(C, data & C);
+		data = (data >> 1) | carry;
+		WriteByte(addr, data);
+		AddWithCarry(data);
+		return;
+	}
+	case Instruction::DCP:
+	{
+		Cycles++;
+		uint16_t addr = FetchAddress<mode, predecoded>();
+		uint8_t data = ReadByte(addr) - 1;
+		WriteByte(addr, data);
+		Compare(A, data);
+		return;
+	}
+	case Instruction::ISC:
+	{
+		Cycles++;
+		uint16_t addr = FetchAddress<mode, predecoded>();
+		uint8_t data = ReadByte(addr) + 1;
+		WriteByte(addr, data);
+		SubtractWithBorrow(data);
+		return;
+	}
+	case Instruction::LAX:
+		A = X = FetchData<mode, predecoded>();
+		UpdateZNFlags(A);
+		return;
+	case Instruction::SAX:
+		WriteByte(FetchAddress<mode, predecoded>(), A & X);
+		return;
+	case Instruction::ANC:
+		A &= FetchData<mode, predecoded>();
+		UpdateZNFlags(A);
+		SetFlag(C, A & N);
+		return;
+	case Instruction::ALR:
+		A &= FetchData<mode, predecoded>();
+		SetFlag(C, A & C);
+		A >>= 1;
+		UpdateZNFlags(A);
+		return;
+	case Instruction::ARR:
+	{
+		uint8_t data = A & FetchData<mode, predecoded>();
+		A = (data >> 1) | ((P & C) ? 0x80 : 0);
+		UpdateZNFlags(A);
+		if (P & D) {
+			// N and Z come from the rotated value, the nibbles are then adjusted like a decimal add
+			SetFlag(V, (data ^ A) & V);
+			if ((data & 0x0F) + (data & 0x01) > 0x05)
+				A = (A & 0xF0) | ((A + 0x06) & 0x0F);
+			bool carry = (data & 0xF0) + (data & 0x10) > 0x50;
+			SetFlag(C, carry);
+			if (carry)
+				A += 0x60;
+		}
+		else {
+			SetFlag(C, A & 0x40);
+			SetFlag(V, ((A >> 6) ^ (A >> 5)) & 0x01);
+		}
+		return;
+	}
+	case Instruction::SBX:
+	{
+		uint8_t data = FetchData<mode, predecoded>();
+		uint8_t value = A & X;
+		SetFlag(C, value >= data);
+		X = value - data;
+		UpdateZNFlags(X);
+		return;
+	}
+	}
+}
+
+// Enable or disable the predecoded block cache
+//    Blocks are only decoded from pages the bus can watch for writes, so buses without WatchCodePage
+//    (such as FlatBus) always run uncached. Changes made to ram or rom directly rather than through
+//    the bus are not seen by the cache; call FlushBlockCache after making them.
+template<typename BusT>
+void MOS6502Core<BusT>::EnableBlockCache(bool enable) {
+	if constexpr (requires(BusT& b) { b.WatchCodePage(uint8_t{}); }) {
+		if (enable && !blockCache) {
+			blockCache = std::make_unique<DecodedBlock[]>(BLOCK_CACHE_SIZE);
+			pageBlocks = std::make_unique<int16_t[]>(256);
+			std::fill_n(pageBlocks.get(), 256, int16_t{ -1 });
+		}
+		else if (!enable && blockCache) {
+			// Release the pages still watched for the blocks on them
+			FlushBlockCache();
+			jit.reset();
+			blockCache.reset();
+			pageBlocks.reset();
+		}
+	}
+}
+
+// Drop every cached block
+template<typename BusT>
+void MOS6502Core<BusT>::FlushBlockCache() {
+	if (!blockCache)
+		return;
+	for (int page = 0; page < 256; page++)
+		InvalidateCodePage(page);
+}
+
+// Invalidate a block and take it off its page's list, releasing the page once it holds no blocks
+template<typename BusT>
+void MOS6502Core<BusT>::DropBlock(DecodedBlock& block) {
+	const uint8_t page = block.start >> 8;
+	block.valid = false;
+	if (block.prev >= 0)
+		blockCache[block.prev].next = block.next;
+	else
+		pageBlocks[page] = block.next;
+	if (block.next >= 0)
+		blockCache[block.next].prev = block.prev;
+
+	if constexpr (requires(BusT& b) { b.UnwatchCodePage(uint8_t{}); }) {
+		if (pageBlocks[page] < 0)
+			bus->UnwatchCodePage(page);
 	}
 }
 
+// Drop the cached blocks decoded from a written address
+template<typename BusT>
+void MOS6502Core<BusT>::InvalidateCode(uint16_t addr) {
+	if (!blockCache) {
+		// Left watched from before the cache was disabled
+		if constexpr (requires(BusT& b) { b.UnwatchCodePage(uint8_t{}); })
+			bus->UnwatchCodePage(addr >> 8);
+		return;
+	}
+	for (int16_t i = pageBlocks[addr >> 8]; i >= 0;) {
+		DecodedBlock& block = blockCache[i];
+		i = block.next;
+		if ((addr & 0xFF) >= block.low && (addr & 0xFF) < block.high) {
+			DropBlock(block);
+
+			// The block may be the one running, so end the slice for RunCached to stop at once
+			EndSliceAt(0);
+		}
+	}
+}
+
+// Drop every cached block decoded from a page
+template<typename BusT>
+void MOS6502Core<BusT>::InvalidateCodePage(uint8_t page) {
+	if (!blockCache) {
+		if constexpr (requires(BusT& b) { b.UnwatchCodePage(uint8_t{}); })
+			bus->UnwatchCodePage(page);
+		return;
+	}
+	if (pageBlocks[page] >= 0)
+		EndSliceAt(0);
+	while (pageBlocks[page] >= 0)
+		DropBlock(blockCache[pageBlocks[page]]);
+}
+
+// Find the block starting at a given address, decoding it if it is not cached. Returns nullptr if
+// the address cannot be predecoded
+template<typename BusT>
+inline typename MOS6502Core<BusT>::DecodedBlock* MOS6502Core<BusT>::LookupBlock(uint16_t addr) {
+	DecodedBlock& block = blockCache[addr & (BLOCK_CACHE_SIZE - 1)];
+	if (block.valid && block.start == addr)
+		return &block;
+	return DecodeBlock(addr);
+}
+
+// Decode the block starting at a given address into its cache entry, evicting the block there
+template<typename BusT>
+typename MOS6502Core<BusT>::DecodedBlock* MOS6502Core<BusT>::DecodeBlock(uint16_t addr) {
+	if constexpr (requires(BusT& b) { b.WatchCodePage(uint8_t{}); }) {
+		const uint8_t* page = bus->DirectPage(addr >> 8);
+		if (!page)
+			return nullptr;
+
+		const int16_t index = addr & (BLOCK_CACHE_SIZE - 1);
+		DecodedBlock& block = blockCache[index];
+		if (block.valid)
+			DropBlock(block);
+
+		const OperationTable& operations = undocumented ? nmos_decode_table : decode_table;
+		const Handler* predecoded = undocumented ? nmos_predecoded_table.data() : predecoded_table.data();
+		block.start = addr;
+		block.count = 0;
+		block.executions = 0;
+		block.native = nullptr;
+		block.links[0] = block.links[1] = nullptr;
+		block.low = block.high = addr & 0xFF;
+		int offset = addr & 0xFF;
+		while (block.count < MAX_BLOCK_LENGTH) {
+			const uint8_t opcode = page[offset];
+			Operation operation = operations[opcode];
+			int length = operation_length(operation.mode);
+			if (offset + length > 0x100)
+				break;
+
+			DecodedInstruction& instruction = block.instructions[block.count++];
+			instruction.handler = predecoded[opcode];
+			instruction.pc = (addr & 0xFF00) | offset;
+			instruction.opcode = opcode;
+			instruction.operand = (length > 1 ? page[offset + 1] : 0) | (length > 2 ? page[offset + 2] << 8 : 0);
+			block.low = std::min<uint16_t>(block.low, offset);
+			block.high = std::max<uint16_t>(block.high, offset + length);
+			offset += length;
+
+			// Carry on at the target of a jump or call that stays on the page
+			const bool jumps = (operation.instruction == Instruction::JMP || operation.instruction == Instruction::JSR) &&
+				operation.mode == ABSOLUTE;
+			if (jumps && (instruction.operand >> 8) == (addr >> 8)) {
+				offset = instruction.operand & 0xFF;
+				continue;
+			}
+			if (ends_block(operation.instruction))
+				break;
+		}
+
+		if (block.count == 0)
+			return nullptr;
+
+		block.exit = (addr & 0xFF00) + offset;
+		block.valid = true;
+		block.prev = -1;
+		block.next = pageBlocks[addr >> 8];
+		if (block.next >= 0)
+			blockCache[block.next].prev = index;
+		pageBlocks[addr >> 8] = index;
+		bus->WatchCodePage(addr >> 8);
+		return &block;
+	}
+	else {
+		(void) addr;
+		return nullptr;
+	}
+}
+
+// Enable or disable compiling hot blocks to native code
+//    Requires the block cache, which is enabled along with it. Has no effect on platforms the JIT
+//    does not support or on buses the block cache cannot be used with.
+template<typename BusT>
+void MOS6502Core<BusT>::EnableJit(bool enable, uint32_t threshold) {
+	if (!enable) {
+		jit.reset();
+		FlushBlockCache();
+		return;
+	}
+
+	EnableBlockCache(true);
+	if (!blockCache || !JitCompiler::Supported())
+		return;
+	if (!jit)
+		jit = std::make_unique<JitCompiler>();
+	jitThreshold = threshold;
+}
+
+// Compile a block to native code, starting over with an empty code buffer if it is full
+template<typename BusT>
+void MOS6502Core<BusT>::CompileBlock(DecodedBlock& block) {
+	const char* base = reinterpret_cast<const char*>(this);
+	auto offset = [base](const void* field) { return reinterpret_cast<const char*>(field) - base; };
+	JitCompiler::Layout layout = {
+		offset(&A), offset(&X), offset(&Y), offset(&SP), offset(&P), offset(&lazyZ), offset(&lazyN),
+		offset(&Cycles), offset(&PC), offset(&status), offset(&sliceEnd), offset(&operand),
+		nullptr, nullptr,
+	};
+	if constexpr (requires(BusT& b) { b.ReadPageTable(); b.WritePageTable(); }) {
+		layout.readPages = bus->ReadPageTable();
+		layout.writePages = bus->WritePageTable();
+	}
+
+	const OperationTable& operations = undocumented ? nmos_decode_table : decode_table;
+	JitCompiler::Step steps[MAX_BLOCK_LENGTH];
+	for (int i = 0; i < block.count; i++) {
+		const DecodedInstruction& instruction = block.instructions[i];
+		steps[i] = { reinterpret_cast<void*>(instruction.handler), operations[instruction.opcode], instruction.pc, instruction.operand };
+	}
+
+	block.native = jit->Compile(layout, steps, block.count);
+	if (!block.native) {
+		jit->Reset();
+		for (int i = 0; i < BLOCK_CACHE_SIZE; i++)
+			blockCache[i].native = nullptr;
+		block.native = jit->Compile(layout, steps, block.count);
+	}
+}
+
+// Run loop used while the block cache is enabled
+//    Each block remembers the blocks execution continued into after it, so a loop of blocks is
+//    followed from one to the next without going back to the cache.
+template<typename BusT>
+template<bool traced>
+void MOS6502Core<BusT>::RunCached() {
+	DecodedBlock* previous = nullptr;
+	while (Cycles < sliceEnd)
+	{
+		DecodedBlock* block = nullptr;
+		if (previous) {
+			for (DecodedBlock* link : previous->links)
+				if (link && link->start == PC && link->valid) {
+					block = link;
+					break;
+				}
+		}
+		if (!block) {
+			block = LookupBlock(PC);
+			if (previous && block)
+				previous->links[PC != previous->exit] = block;
+		}
+
+		previous = block;
+		if (!block) {
+			const Handler handler = FetchOperation();
+			if (traced && status == 0)
+				TraceInstruction();
+			handler(*this);
+			if (status != 0)
+				return;
+			continue;
+		}
+
+		if (!traced) {
+			if (jit && !block->native && block->executions++ >= jitThreshold)
+				CompileBlock(*block);
+			if (block->native) {
+				block->native(this);
+				if (status != 0)
+					return;
+				continue;
+			}
+		}
+
+		const DecodedInstruction* instruction = block->instructions;
+		const DecodedInstruction* end = instruction + block->count;
+		for (; instruction != end; instruction++) {
+			// The opcode fetch, without going back to the bus. Blocks are never decoded from pages
+			// holding breakpoints, so there is nothing to check first
+			Cycles++;
+			PC++;
+			if (traced)
+				TraceInstruction();
+			operand = instruction->operand;
+			instruction->handler(*this);
+
+			// Dropping a block ends the slice, so there is no need to check it is still valid
+			if (status != 0)
+				return;
+			if (Cycles >= sliceEnd)
+				break;
+		}
+	}
+}
+
+// Run loop used without the block cache
+template<typename BusT>
+template<bool traced>
+void MOS6502Core<BusT>::RunUncached() {
+	while (Cycles < sliceEnd)
+	{
+		const Handler handler = FetchOperation();
+		if (traced && status == 0)
+			TraceInstruction();
+		handler(*this);
+		if (status != 0)
+			return;
+	}
+}
+
+// Whether Run has to see every instruction
+template<typename BusT>
+bool MOS6502Core<BusT>::Stepping() const {
+#ifdef MOS6502_PROFILE
+	return profiler != nullptr;
+#else
+	return false;
+#endif
+}
+
+// Run loop used while instructions are profiled
+template<typename BusT>
+void MOS6502Core<BusT>::RunStepped() {
+	while (Cycles < sliceEnd)
+	{
+#ifdef MOS6502_PROFILE
+		const uint16_t pc = PC;
+		const int32_t start = Cycles;
+		const uint8_t opcode = FetchOpcode();
+		if (trace && status == 0)
+			TraceInstruction();
+		handlers[opcode](*this);
+		if (status == E_BREAK)
+			return;
+
+		if (profiler) {
+			profiler->Record(pc, opcode, Cycles - start);
+			if (status == 0) {
+				switch (opcode) {
+				case INS_JSR_ABS:
+				case INS_BRK:
+					profiler->Call(PC);
+					break;
+				case INS_RTS:
+				case INS_RTI:
+					profiler->Return();
+					break;
+				}
+			}
+		}
+#else
+		FetchOperation()(*this);
+#endif
+
+		if (status != 0)
+			return;
+	}
+}
+
+// Append the instruction whose opcode was just fetched to the trace, with the state it starts in.
+// Called only once the fetch has passed any breakpoint, so an instruction halted at one is
+// recorded when it resumes rather than twice
+template<typename BusT>
+void MOS6502Core<BusT>::TraceInstruction() {
+	const uint16_t pc = PC - 1;
+	const uint64_t cycle = clock + Cycles - 1;
+	Trace::Entry& entry = trace->Next();
+	entry.cycleLow = static_cast<uint32_t>(cycle);
+	entry.cycleHigh = static_cast<uint16_t>(cycle >> 32);
+	entry.pc = pc;
+
+	// The instruction bytes come straight from a directly mapped page where possible
+	const uint8_t* page = nullptr;
+	if constexpr (requires(BusT& b) { b.DirectPage(uint8_t{}); })
+		page = bus->DirectPage(pc >> 8);
+	if (page && (pc & 0xFF) <= 0xFD) {
+		entry.opcode = page[pc & 0xFF];
+		entry.operands[0] = page[(pc & 0xFF) + 1];
+		entry.operands[1] = page[(pc & 0xFF) + 2];
+	}
+	else {
+		entry.opcode = Peek(pc);
+		entry.operands[0] = Peek(pc + 1);
+		entry.operands[1] = Peek(pc + 2);
+	}
+	entry.A = A;
+	entry.X = X;
+	entry.Y = Y;
+	entry.SP = SP;
+	entry.P = GetStatus();
+}
+
+// Read memory for inspection, without the side effects a device read could have
+template<typename BusT>
+uint8_t MOS6502Core<BusT>::Peek(uint16_t addr) {
+	if constexpr (requires(BusT& b) { b.Peek(uint16_t{}); })
+		return bus->Peek(addr);
+	else
+		return 0;
+}
+
 // Run the emulator
 //    Runs the emulator for a requested number of cycles, or indefinitely if chosen. The function
 //    may return early in the case of an error in execution. The function may also return late if
@@ -591,17 +1292,57 @@ void MOS6502::ExecuteOperation(Operation operation) {
 //    status > 0 -- overused cycles
 //    status < 0 -- error code
 //    status = 0 -- normal termination
-int MOS6502::Run(int32_t CyclesRequested, bool noStop) {
+template<typename BusT>
+int MOS6502Core<BusT>::Run(int32_t CyclesRequested, bool noStop) {
 	Cycles = 0;
-	while (Cycles < CyclesRequested || noStop)
-	{
-		Operation operation = FetchOperation();
-		if (status != 0)
-			return status;
+	if (status != 0)
+		return status;
+
+	// P may have been changed from outside since the last run
+	SetStatus(P);
+	running = true;
 
-		ExecuteOperation(operation);
+	// Instructions run uninterrupted in slices that end at the stop cycle or the next scheduled
+	// event. Anything else that needs the loop's attention, such as an interrupt being raised,
+	// ends the slice early by pulling sliceEnd in, so the hot loops only ever compare Cycles
+	// against it. Without a stop cycle the run only ends on an error
+	const int32_t stop = noStop ? INT32_MAX : CyclesRequested;
+	while (Cycles < stop) {
+		if (nmiPending || (irqLines && !(P & I))) {
+			ServiceInterrupt();
+#ifdef MOS6502_PROFILE
+			if (profiler)
+				profiler->Interrupt(PC, 7);
+#endif
+		}
+
+		sliceEnd = stop;
+		if (!scheduler.Empty())
+			EndSliceAt(scheduler.Next());
+
+		if (Stepping())
+			RunStepped();
+		else if (blockCache)
+			trace ? RunCached<true>() : RunCached<false>();
+		else
+			trace ? RunUncached<true>() : RunUncached<false>();
+
+		if (status != 0)
+			break;
+		if (scheduler.Next() <= clock + Cycles) {
+			RunEvents();
+			if (status != 0)
+				break;
+		}
 	}
 
+	running = false;
+	if (Cycles > 0)
+		clock += Cycles;
+
+	// Leave a complete status byte behind for inspection
+	P = GetStatus();
+
 	// return error status
 	if (status != 0)
 		return status;
@@ -611,4 +1352,189 @@ int MOS6502::Run(int32_t CyclesRequested, bool noStop) {
 		return Cycles - CyclesRequested;
 
 	return 0;
-}
\ No newline at end of file
+}
+
+// Fire the events that are due, with a complete status byte in P while they run
+template<typename BusT>
+void MOS6502Core<BusT>::RunEvents() {
+	P = GetStatus();
+	scheduler.RunDue(clock + Cycles);
+	SetStatus(P);
+}
+
+// End the current slice of Run by the given Clock value, or straight away if it has passed
+template<typename BusT>
+void MOS6502Core<BusT>::EndSliceAt(uint64_t when) {
+	if (!running)
+		return;
+	int64_t end = (when > clock) ? static_cast<int64_t>(std::min<uint64_t>(when - clock, INT32_MAX)) : 0;
+	if (end < sliceEnd)
+		sliceEnd = static_cast<int32_t>(end);
+}
+
+template<typename BusT>
+void MOS6502Core<BusT>::ResetClockAndLines() {
+	scheduler.Clear();
+	replayEvent = 0;
+	clock = 0;
+	Cycles = 0;
+	irqLines = 0;
+	nmiLine = false;
+	nmiPending = false;
+}
+
+// Drive the IRQ line. The line is held while any source asserts it, and an IRQ is taken whenever
+// it is held and the I flag is clear
+template<typename BusT>
+void MOS6502Core<BusT>::SetIRQ(bool asserted, uint32_t source) {
+	if (!replayLog)
+		DriveIRQ(asserted ? (irqLines | source) : (irqLines & ~source));
+}
+
+// Drive the NMI line. An NMI is taken once each time the line becomes asserted
+template<typename BusT>
+void MOS6502Core<BusT>::SetNMI(bool asserted) {
+	if (!replayLog)
+		DriveNMI(asserted);
+}
+
+template<typename BusT>
+void MOS6502Core<BusT>::DriveIRQ(uint32_t lines) {
+	if (lines == irqLines)
+		return;
+	if (recordLog)
+		recordLog->Append({ Clock(), InputLog::Kind::IRQ, 0, lines });
+
+	const bool raised = lines & ~irqLines;
+	irqLines = lines;
+	if (raised)
+		EndSliceAt(0);
+}
+
+template<typename BusT>
+void MOS6502Core<BusT>::DriveNMI(bool asserted) {
+	if (asserted == nmiLine)
+		return;
+	if (recordLog)
+		recordLog->Append({ Clock(), InputLog::Kind::NMI, 0, asserted });
+
+	if (asserted) {
+		nmiPending = true;
+		EndSliceAt(0);
+	}
+	nmiLine = asserted;
+}
+
+// Start recording with the lines as they are, so a replay from here does not depend on them
+template<typename BusT>
+void MOS6502Core<BusT>::RecordInputs(InputLog* log) {
+	recordLog = log;
+	if (!log)
+		return;
+	if (irqLines)
+		log->Append({ Clock(), InputLog::Kind::IRQ, 0, irqLines });
+	if (nmiLine)
+		log->Append({ Clock(), InputLog::Kind::NMI, 0, 1 });
+}
+
+template<typename BusT>
+void MOS6502Core<BusT>::ReplayInputs(const InputLog* log) {
+	ReplayInputs(nullptr, {});
+	if (!log)
+		return;
+
+	replayLog = log;
+	replayReads = InputLog::Reader(*log);
+	replayLines = InputLog::Reader(*log);
+	replayReads.Seek(Clock());
+	replayLines.Seek(Clock());
+	ReplayNextLineChange();
+}
+
+template<typename BusT>
+void MOS6502Core<BusT>::ReplayInputs(const InputLog* log, const InputLog::Position& start) {
+	// Changes already due would have been applied at the next instruction boundary
+	while (replayEvent && replayNext.cycle <= Clock()) {
+		scheduler.Cancel(replayEvent);
+		ApplyLineChange(replayNext);
+		ReplayNextLineChange();
+	}
+	if (replayEvent)
+		scheduler.Cancel(replayEvent);
+	replayEvent = 0;
+	replayLog = log;
+	if (!log)
+		return;
+
+	replayReads = InputLog::Reader(*log);
+	replayLines = InputLog::Reader(*log);
+	replayReads.SeekTo(start);
+	replayLines.SeekTo(start);
+	ReplayNextLineChange();
+}
+
+// Schedule the next interrupt line change in the log, which schedules the one after it
+template<typename BusT>
+void MOS6502Core<BusT>::ReplayNextLineChange() {
+	do {
+		if (!replayLines.Next(replayNext)) {
+			replayEvent = 0;
+			return;
+		}
+	} while (replayNext.kind == InputLog::Kind::READ);
+
+	replayEvent = ScheduleAt(replayNext.cycle, [this] {
+		ApplyLineChange(replayNext);
+		ReplayNextLineChange();
+	});
+}
+
+template<typename BusT>
+void MOS6502Core<BusT>::ApplyLineChange(const InputLog::Input& input) {
+	if (input.kind == InputLog::Kind::IRQ)
+		DriveIRQ(input.value);
+	else
+		DriveNMI(input.value != 0);
+}
+
+// Value of a device read, taken from the log
+template<typename BusT>
+uint8_t MOS6502Core<BusT>::ReplayRead(uint16_t addr) {
+	InputLog::Input input;
+	if (!replayReads.Next(input, InputLog::Kind::READ) || input.cycle != Clock() || input.addr != addr) {
+		status = E_DESYNC;
+		return 0;
+	}
+	return static_cast<uint8_t>(input.value);
+}
+
+// Called when an instruction may have cleared the I flag, so a held IRQ gets taken
+template<typename BusT>
+void MOS6502Core<BusT>::UnmaskIRQ() {
+	if (irqLines && !GetFlag(I))
+		EndSliceAt(0);
+}
+
+// Enter the pending interrupt handler, NMI taking priority over IRQ. Like BRK this takes 7
+// cycles: two internal cycles, three pushes and the vector fetch
+template<typename BusT>
+void MOS6502Core<BusT>::ServiceInterrupt() {
+	uint16_t vector = 0xFFFE;
+	if (nmiPending) {
+		nmiPending = false;
+		vector = 0xFFFA;
+	}
+
+	Cycles += 2;
+	WriteByte(0x0100 | SP--, PC >> 8);
+	WriteByte(0x0100 | SP--, PC & 0xFF);
+	WriteByte(0x0100 | SP--, (GetStatus() & ~B) | U);
+	SetFlag(I, 1);
+	PC = ReadWord(vector);
+}
+
+// Instantiate the core for each bus it is used with
+template class MOS6502Core<Bus>;
+template class MOS6502Core<FlatBus>;
+template class MOS6502Core<LaneBus>;
+template class MOS6502Core<LogBus>;
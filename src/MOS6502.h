@@ -1,13 +1,28 @@
 #pragma once
+#include <array>
 #include <cstdint>
+#include <memory>
+#include <utility>
+#include "inputlog.h"
 #include "instructions.h"
+#include "scheduler.h"
 
 class Bus;
+class JitCompiler;
+class Profiler;
+class Trace;
+
+// MOS6502 core, parameterized on the bus it is connected to
+//    The bus type only needs inline-able read(addr) and write(addr, data) members. Binding it at
+//    compile time lets a flat memory bus be inlined straight into the instruction handlers.
+template<typename BusT>
+class MOS6502Core {
+	// The bus saves and restores the clock and interrupt lines along with the registers
+	friend BusT;
 
-class MOS6502 {
 public:
-	MOS6502();
-	~MOS6502();
+	MOS6502Core();
+	~MOS6502Core();
 
 	// Register
 	uint16_t PC; // Program Counter
@@ -15,24 +30,34 @@ public:
 	uint8_t  A;  // Accumulator Register
 	uint8_t  X;  // X Register
 	uint8_t  Y;  // Y Register
-	uint8_t  P;  // Processor Status
+	uint8_t  P;  // Processor Status (Z and N are only current outside of Run, see GetStatus)
 
 	// Flags
-	const uint8_t C = (1 << 0); // Carry
-	const uint8_t Z = (1 << 1); // Zero
-	const uint8_t I = (1 << 2); // Interrupt Disable
-	const uint8_t D = (1 << 3); // Decimal Mode
-	const uint8_t B = (1 << 4); // Break Command
-	const uint8_t U = (1 << 5); // Unused
-	const uint8_t V = (1 << 6); // Overflow
-	const uint8_t N = (1 << 7); // Negative
+	static constexpr uint8_t C = (1 << 0); // Carry
+	static constexpr uint8_t Z = (1 << 1); // Zero
+	static constexpr uint8_t I = (1 << 2); // Interrupt Disable
+	static constexpr uint8_t D = (1 << 3); // Decimal Mode
+	static constexpr uint8_t B = (1 << 4); // Break Command
+	static constexpr uint8_t U = (1 << 5); // Unused
+	static constexpr uint8_t V = (1 << 6); // Overflow
+	static constexpr uint8_t N = (1 << 7); // Negative
 
 	int32_t Cycles;
 	int status = 0;
 
+private: // Lazy flags
+	// While running, Z and N are not kept in P. Instead the core remembers the value each flag was
+	// last derived from and only folds them back into P when the full status byte is needed.
+	uint8_t lazyZ = 1; // Z is set when this is zero
+	uint8_t lazyN = 0; // N is bit 7 of this
+
+public:
+	uint8_t GetStatus() const;
+	void    SetStatus(uint8_t value);
+
 public: // Bus interface
-	Bus* bus = nullptr;
-	void ConnectBus(Bus* m) { bus = m; }
+	BusT* bus = nullptr;
+	void ConnectBus(BusT* m) { bus = m; }
 
 private: // Bus methods
 	uint8_t BusRead(uint16_t addr);
@@ -46,24 +71,225 @@ private: // CPU R/W methods
 
 	uint8_t  FetchByte();
 	uint16_t FetchWord();
+	uint8_t  FetchOpcode();
+
+	// Operand of the current instruction: fetched from the bus, or taken from operand when the
+	// instruction was predecoded into a block
+	template<bool predecoded> uint8_t  OperandByte();
+	template<bool predecoded> uint16_t OperandWord();
+	uint16_t operand = 0;
 
 	void    PushStack(uint8_t data);
 	uint8_t PullStack();
 
 private: // Helper functions
 	void SetFlag(uint8_t flag, bool value);
+	bool GetFlag(uint8_t flag) const;
 	void UpdateZNFlags(uint8_t data);
-	void Branch();
-	void MaybeBranch(uint8_t flag, bool value);
+	template<bool predecoded> void Branch();
+	template<bool predecoded> void MaybeBranch(uint8_t flag, bool value);
+	void AddWithCarry(uint8_t data);
+	void SubtractWithBorrow(uint8_t data);
+	void Compare(uint8_t reg, uint8_t data);
 public:
 	void Reset();
 	
-private: // Execution methods
-	uint16_t  FetchAddress(Operation operation);
-	uint8_t   FetchData(Operation operation);
-	Operation FetchOperation();
-	void      ExecuteOperation(Operation operation);
+public: // Execution methods
+	using Handler = void (*)(MOS6502Core&);
+
+private:
+	template<AddressMode mode, bool predecoded = false> uint16_t FetchAddress();
+	template<AddressMode mode, bool predecoded = false> uint8_t  FetchData();
+	Handler FetchOperation();
+	template<bool traced> void RunUncached();
+	template<Instruction instruction, AddressMode mode, bool predecoded> void ExecuteOperation();
+
+	template<Instruction instruction, AddressMode mode, bool predecoded>
+	static void Dispatch(MOS6502Core& cpu) { cpu.ExecuteOperation<instruction, mode, predecoded>(); }
+
+	template<const std::array<Operation, 256>& table, bool predecoded, size_t... opcodes>
+	static constexpr std::array<Handler, 256> ConstructHandlerTable(std::index_sequence<opcodes...>);
+	static const std::array<Handler, 256> handler_table;      // Legal opcodes
+	static const std::array<Handler, 256> nmos_handler_table; // Legal and stable undocumented opcodes
+
+	// Handlers for instructions in decoded blocks, which take their operand from operand
+	static const std::array<Handler, 256> predecoded_table;
+	static const std::array<Handler, 256> nmos_predecoded_table;
+
+	const Handler* handlers = handler_table.data(); // Table opcodes are dispatched through
+	bool undocumented = false;
+
+	// Dispatched in place of an instruction the bus stopped at
+	static void Halt(MOS6502Core& cpu);
+	static const std::array<Handler, 256> halt_table;
+
+public:
+	// Called by the bus while fetching an opcode to stop Run with the given status before the
+	// instruction executes. Running again after clearing status fetches the opcode again.
+	void Break(int code);
+
+	// Execute the stable undocumented NMOS opcodes (LAX, SAX, DCP, ISC, SLO, RLA, SRE, RRA, ANC,
+	// ALR, ARR, SBX and the multi-byte NOPs) instead of stopping on them with E_INV
+	void EnableUndocumented(bool enable);
+	bool UndocumentedEnabled() const { return undocumented; }
+
+private: // Block cache
+	static constexpr int BLOCK_CACHE_SIZE = 1024;
+	static constexpr int MAX_BLOCK_LENGTH = 16;
+
+	struct DecodedInstruction {
+		Handler  handler;
+		uint16_t operand; // Operand bytes, little endian
+		uint16_t pc;      // Address of the opcode
+		uint8_t  opcode;
+	};
+
+	// Run of instructions predecoded from directly mapped memory. A block never leaves its page. It
+	// follows absolute jumps and subroutine calls to targets on the same page, and ends at the first
+	// other instruction that can change the flow of control.
+	struct DecodedBlock {
+		uint16_t start = 0;
+		uint16_t exit = 0;                        // Address following the last instruction
+		uint16_t low = 0;                         // Offsets on the page of the bytes decoded, [low, high)
+		uint16_t high = 0;
+		uint8_t  count = 0;
+		bool     valid = false;
+		int16_t  prev = -1;                       // Neighbours in the list of blocks on the same page
+		int16_t  next = -1;
+		uint32_t executions = 0;                  // Times entered since it was decoded
+		void (*native)(void* cpu) = nullptr;      // Compiled code, if hot
+		DecodedBlock* links[2] = {};              // Blocks last run after this one: falling through, and jumping
+		DecodedInstruction instructions[MAX_BLOCK_LENGTH];
+	};
+
+	std::unique_ptr<DecodedBlock[]> blockCache;
+	std::unique_ptr<int16_t[]> pageBlocks;        // First valid block decoded from each page, or -1
+
+	DecodedBlock* LookupBlock(uint16_t addr);
+	DecodedBlock* DecodeBlock(uint16_t addr);
+	void DropBlock(DecodedBlock& block);
+	template<bool traced> void RunCached();
+
+public:
+	//    Each page of memory that blocks are decoded from is watched by the bus for writes. A write
+	//    only drops the blocks decoded from the bytes it changes, and the page stops being watched
+	//    once no blocks are left on it.
+	void EnableBlockCache(bool enable);
+	void FlushBlockCache();
+	void InvalidateCode(uint16_t addr);      // Drop the blocks covering one byte
+	void InvalidateCodePage(uint8_t page);   // Drop every block on a page
+
+private: // JIT
+	std::unique_ptr<JitCompiler> jit;
+	uint32_t jitThreshold = 0;
+
+	void CompileBlock(DecodedBlock& block);
+
+public:
+	// Blocks entered this many times are compiled to native code
+	static constexpr uint32_t JIT_DEFAULT_THRESHOLD = 64;
+
+	void EnableJit(bool enable, uint32_t threshold = JIT_DEFAULT_THRESHOLD);
+
+private: // Event scheduling
+	Scheduler scheduler;
+	uint64_t  clock = 0;      // Cycles completed by previous runs
+	int32_t   sliceEnd = 0;   // Cycles value at which the current slice of Run ends
+	bool      running = false;
+
+	void RunEvents();
+	void EndSliceAt(uint64_t when);
+
+public:
+	// Cycles executed since the core was created, including the run in progress
+	uint64_t Clock() const { return clock + (running ? Cycles : 0); }
+
+	// Call back after the given number of cycles, or at an absolute Clock value. Events fire
+	// between instructions, at the first instruction boundary at or after their due time, and may
+	// run during the Run call that reaches them. Inside a callback P is complete.
+	Scheduler::EventId Schedule(uint64_t delay, Scheduler::Callback callback) { return ScheduleAt(Clock() + delay, std::move(callback)); }
+	Scheduler::EventId ScheduleAt(uint64_t when, Scheduler::Callback callback) {
+		EndSliceAt(when);
+		return scheduler.Add(when, std::move(callback));
+	}
+	bool CancelEvent(Scheduler::EventId id) { return scheduler.Cancel(id); }
+
+	// Drop every pending event, release the interrupt lines and restart Clock at 0, as on a newly
+	// created core. Registers and memory are left alone. Not to be called from inside Run
+	void ResetClockAndLines();
+
+private: // Interrupts
+	uint32_t irqLines = 0;       // Sources currently asserting IRQ
+	bool     nmiLine = false;
+	bool     nmiPending = false; // NMI edge seen but not yet taken
+
+	void UnmaskIRQ();
+	void ServiceInterrupt();
+	void DriveIRQ(uint32_t lines);
+	void DriveNMI(bool asserted);
+
+public:
+	//    Interrupts are taken between instructions, using the vectors at 0xFFFA (NMI) and 0xFFFE
+	//    (IRQ). Raising one ends the current slice of Run, so an idle line costs nothing.
+	void SetIRQ(bool asserted, uint32_t source = 1);
+	void SetNMI(bool asserted);
+
+private: // Input recording and replay
+	InputLog*         recordLog = nullptr;
+	const InputLog*   replayLog = nullptr;
+	InputLog::Reader  replayReads;
+	InputLog::Reader  replayLines;
+	InputLog::Input   replayNext;     // Line change the pending replay event applies
+	Scheduler::EventId replayEvent = 0;
+
+	void ReplayNextLineChange();
+	void ApplyLineChange(const InputLog::Input& input);
+
+public:
+	// Log every device read and interrupt line change into the given log, or stop with nullptr
+	void RecordInputs(InputLog* log);
+
+	// Take device reads and interrupt line changes from the given log instead of from outside,
+	//    starting with the inputs made at the current Clock value, or stop with nullptr. While
+	//    replaying, SetIRQ and SetNMI are ignored. A read that does not match the log stops Run
+	//    with E_DESYNC. Stopping applies any line change logged for the current Clock value.
+	void ReplayInputs(const InputLog* log);
+	// Replay starting at the given position, e.g. the End of the log when a snapshot was taken
+	void ReplayInputs(const InputLog* log, const InputLog::Position& start);
+	bool Replaying() const { return replayLog != nullptr; }
+
+	// Called by the bus for each device read
+	void    RecordRead(uint16_t addr, uint8_t data) { if (recordLog) recordLog->Append({ Clock(), InputLog::Kind::READ, addr, data }); }
+	uint8_t ReplayRead(uint16_t addr);
+
+private: // Instrumentation
+	// A trace is recorded by whichever loop Run is already using, through the block cache when it
+	// is enabled. While a profiler is attached, Run instead steps through instructions one at a time
+	// without the block cache or JIT, so that each one is seen
+	Trace* trace = nullptr;
+
+	bool Stepping() const;
+	void RunStepped();
+	void TraceInstruction();
+	uint8_t Peek(uint16_t addr);
+
+public:
+	// Record every instruction Run executes into the given trace, or stop with nullptr. Compiled
+	// blocks are run through their predecoded handlers instead while a trace is attached
+	void AttachTrace(Trace* t) { trace = t; }
+
+#ifdef MOS6502_PROFILE
+private: // Profiling
+	Profiler* profiler = nullptr;
+
+public:
+	// Feed every instruction Run executes to the given profiler, or stop with nullptr
+	void AttachProfiler(Profiler* p) { profiler = p; }
+#endif
 
 public:
 	int Run(int32_t CyclesRequested, bool noStop = false);
-};
\ No newline at end of file
+};
+
+// The CPU as connected to the system Bus
+using MOS6502 = MOS6502Core<Bus>;
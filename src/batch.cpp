@@ -0,0 +1,676 @@
+#include "batch.h"
+#include "decode.h"
+#include "exitcodes.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BATCH_SSE2 1
+#endif
+
+namespace {
+
+// Flags
+constexpr uint8_t FLAG_C = (1 << 0);
+constexpr uint8_t FLAG_Z = (1 << 1);
+constexpr uint8_t FLAG_D = (1 << 3);
+constexpr uint8_t FLAG_V = (1 << 6);
+constexpr uint8_t FLAG_N = (1 << 7);
+
+// CpuBatch::LANE_WIDTH lanes of 8-bit values. Comparisons produce 0xFF in lanes where they hold
+#ifdef BATCH_SSE2
+struct Vec { __m128i v; };
+
+inline Vec  Load(const uint8_t* p)   { return { _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)) }; }
+inline void Store(uint8_t* p, Vec a) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a.v); }
+inline Vec  Splat(uint8_t x)         { return { _mm_set1_epi8(static_cast<char>(x)) }; }
+
+inline Vec operator+(Vec a, Vec b) { return { _mm_add_epi8(a.v, b.v) }; }
+inline Vec operator-(Vec a, Vec b) { return { _mm_sub_epi8(a.v, b.v) }; }
+inline Vec operator&(Vec a, Vec b) { return { _mm_and_si128(a.v, b.v) }; }
+inline Vec operator|(Vec a, Vec b) { return { _mm_or_si128(a.v, b.v) }; }
+inline Vec operator^(Vec a, Vec b) { return { _mm_xor_si128(a.v, b.v) }; }
+
+inline Vec AddSaturate(Vec a, Vec b)  { return { _mm_adds_epu8(a.v, b.v) }; }
+inline Vec Equal(Vec a, Vec b)        { return { _mm_cmpeq_epi8(a.v, b.v) }; }
+inline Vec GreaterEqual(Vec a, Vec b) { return { _mm_cmpeq_epi8(_mm_max_epu8(a.v, b.v), a.v) }; }
+inline Vec Select(Vec mask, Vec a, Vec b) { return { _mm_or_si128(_mm_and_si128(mask.v, a.v), _mm_andnot_si128(mask.v, b.v)) }; }
+inline bool Any(Vec mask)             { return _mm_movemask_epi8(mask.v) != 0; }
+inline Vec  ShiftRight1(Vec a)        { return { _mm_and_si128(_mm_srli_epi16(a.v, 1), _mm_set1_epi8(0x7F)) }; }
+
+// Program counters and cycle counts of LANE_WIDTH lanes, under a byte mask of the lanes
+inline void Select16(uint16_t* p, Vec mask, __m128i value0, __m128i value1) {
+	const __m128i mask0 = _mm_unpacklo_epi8(mask.v, mask.v);
+	const __m128i mask1 = _mm_unpackhi_epi8(mask.v, mask.v);
+	__m128i* q = reinterpret_cast<__m128i*>(p);
+	_mm_storeu_si128(q, _mm_or_si128(_mm_and_si128(mask0, value0), _mm_andnot_si128(mask0, _mm_loadu_si128(q))));
+	_mm_storeu_si128(q + 1, _mm_or_si128(_mm_and_si128(mask1, value1), _mm_andnot_si128(mask1, _mm_loadu_si128(q + 1))));
+}
+inline void Select16(uint16_t* p, Vec mask, uint16_t value) {
+	const __m128i v = _mm_set1_epi16(static_cast<short>(value));
+	Select16(p, mask, v, v);
+}
+inline void Select16(uint16_t* p, Vec mask, const uint16_t* values) {
+	const __m128i* v = reinterpret_cast<const __m128i*>(values);
+	Select16(p, mask, _mm_loadu_si128(v), _mm_loadu_si128(v + 1));
+}
+// Byte mask of the lanes with no error and cycles left to run
+inline Vec Running(const int32_t* cycles, const int* status, int32_t limit) {
+	const __m128i l = _mm_set1_epi32(limit);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i words[2];
+	for (int i = 0; i < 2; i++) {
+		const __m128i* c = reinterpret_cast<const __m128i*>(cycles + 8 * i);
+		const __m128i* s = reinterpret_cast<const __m128i*>(status + 8 * i);
+		const __m128i low = _mm_and_si128(_mm_cmplt_epi32(_mm_loadu_si128(c), l), _mm_cmpeq_epi32(_mm_loadu_si128(s), zero));
+		const __m128i high = _mm_and_si128(_mm_cmplt_epi32(_mm_loadu_si128(c + 1), l), _mm_cmpeq_epi32(_mm_loadu_si128(s + 1), zero));
+		words[i] = _mm_packs_epi32(low, high);
+	}
+	return { _mm_packs_epi16(words[0], words[1]) };
+}
+
+// Lowest program counter of the lanes in a mask, 0xFFFF if there are none
+inline uint16_t Lowest(const uint16_t* p, Vec mask) {
+	// Unsigned minimum through the signed one, with the lanes outside the mask at 0xFFFF
+	const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+	const __m128i* q = reinterpret_cast<const __m128i*>(p);
+	const __m128i low = _mm_or_si128(_mm_loadu_si128(q), _mm_xor_si128(_mm_unpacklo_epi8(mask.v, mask.v), _mm_set1_epi8(-1)));
+	const __m128i high = _mm_or_si128(_mm_loadu_si128(q + 1), _mm_xor_si128(_mm_unpackhi_epi8(mask.v, mask.v), _mm_set1_epi8(-1)));
+	__m128i m = _mm_min_epi16(_mm_xor_si128(low, bias), _mm_xor_si128(high, bias));
+	m = _mm_min_epi16(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_min_epi16(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	m = _mm_min_epi16(m, _mm_shufflelo_epi16(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	return static_cast<uint16_t>(_mm_cvtsi128_si32(m) ^ 0x8000);
+}
+
+// Byte mask of the lanes at a program counter
+inline Vec EqualTo(const uint16_t* p, uint16_t value) {
+	const __m128i v = _mm_set1_epi16(static_cast<short>(value));
+	const __m128i* q = reinterpret_cast<const __m128i*>(p);
+	return { _mm_packs_epi16(_mm_cmpeq_epi16(_mm_loadu_si128(q), v), _mm_cmpeq_epi16(_mm_loadu_si128(q + 1), v)) };
+}
+
+inline void Add32(int32_t* p, Vec bytes) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low = _mm_unpacklo_epi8(bytes.v, zero);
+	const __m128i high = _mm_unpackhi_epi8(bytes.v, zero);
+	const __m128i words[4] = { _mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+		_mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero) };
+	__m128i* q = reinterpret_cast<__m128i*>(p);
+	for (int i = 0; i < 4; i++)
+		_mm_storeu_si128(q + i, _mm_add_epi32(_mm_loadu_si128(q + i), words[i]));
+}
+#else
+struct Vec { uint8_t v[CpuBatch::LANE_WIDTH]; };
+
+#define LANEWISE(expr) Vec r; for (int i = 0; i < CpuBatch::LANE_WIDTH; i++) r.v[i] = static_cast<uint8_t>(expr); return r
+
+inline Vec  Load(const uint8_t* p)   { LANEWISE(p[i]); }
+inline void Store(uint8_t* p, Vec a) { std::copy(a.v, a.v + CpuBatch::LANE_WIDTH, p); }
+inline Vec  Splat(uint8_t x)         { LANEWISE(x); }
+
+inline Vec operator+(Vec a, Vec b) { LANEWISE(a.v[i] + b.v[i]); }
+inline Vec operator-(Vec a, Vec b) { LANEWISE(a.v[i] - b.v[i]); }
+inline Vec operator&(Vec a, Vec b) { LANEWISE(a.v[i] & b.v[i]); }
+inline Vec operator|(Vec a, Vec b) { LANEWISE(a.v[i] | b.v[i]); }
+inline Vec operator^(Vec a, Vec b) { LANEWISE(a.v[i] ^ b.v[i]); }
+
+inline Vec AddSaturate(Vec a, Vec b)  { LANEWISE(std::min(a.v[i] + b.v[i], 0xFF)); }
+inline Vec Equal(Vec a, Vec b)        { LANEWISE(a.v[i] == b.v[i] ? 0xFF : 0); }
+inline Vec GreaterEqual(Vec a, Vec b) { LANEWISE(a.v[i] >= b.v[i] ? 0xFF : 0); }
+inline Vec Select(Vec mask, Vec a, Vec b) { LANEWISE((mask.v[i] & a.v[i]) | (~mask.v[i] & b.v[i])); }
+inline bool Any(Vec mask)             { return std::any_of(mask.v, mask.v + CpuBatch::LANE_WIDTH, [](uint8_t m) { return m != 0; }); }
+inline Vec  ShiftRight1(Vec a)        { LANEWISE(a.v[i] >> 1); }
+
+// Program counters and cycle counts of LANE_WIDTH lanes, under a byte mask of the lanes
+inline void Select16(uint16_t* p, Vec mask, uint16_t value) {
+	for (int i = 0; i < CpuBatch::LANE_WIDTH; i++)
+		p[i] = mask.v[i] ? value : p[i];
+}
+inline void Select16(uint16_t* p, Vec mask, const uint16_t* values) {
+	for (int i = 0; i < CpuBatch::LANE_WIDTH; i++)
+		p[i] = mask.v[i] ? values[i] : p[i];
+}
+// Byte mask of the lanes with no error and cycles left to run
+inline Vec Running(const int32_t* cycles, const int* status, int32_t limit) { LANEWISE((status[i] == 0 && cycles[i] < limit) ? 0xFF : 0); }
+
+// Lowest program counter of the lanes in a mask, 0xFFFF if there are none
+inline uint16_t Lowest(const uint16_t* p, Vec mask) {
+	uint16_t lowest = 0xFFFF;
+	for (int i = 0; i < CpuBatch::LANE_WIDTH; i++)
+		if (mask.v[i])
+			lowest = std::min(lowest, p[i]);
+	return lowest;
+}
+
+// Byte mask of the lanes at a program counter
+inline Vec EqualTo(const uint16_t* p, uint16_t value) { LANEWISE((p[i] == value) ? 0xFF : 0); }
+
+inline void Add32(int32_t* p, Vec bytes) {
+	for (int i = 0; i < CpuBatch::LANE_WIDTH; i++)
+		p[i] += bytes.v[i];
+}
+
+#undef LANEWISE
+#endif
+
+inline Vec IsZero(Vec a) { return Equal(a, Splat(0)); }
+inline Vec Not(Vec a)    { return a ^ Splat(0xFF); }
+
+// Update Z and N in a status vector from a result vector
+inline Vec SetZN(Vec p, Vec result) {
+	return (p & Splat(static_cast<uint8_t>(~(FLAG_Z | FLAG_N)))) | (IsZero(result) & Splat(FLAG_Z)) | (result & Splat(FLAG_N));
+}
+
+// Binary add with carry, matching the scalar core's ADC (and SBC, with data inverted)
+inline Vec AddWithCarry(Vec a, Vec data, Vec& p) {
+	Vec carryIn = p & Splat(FLAG_C);
+	Vec sum = a + data;
+	Vec carry = Not(Equal(AddSaturate(a, data), sum)) | (Equal(sum, Splat(0xFF)) & Not(IsZero(carryIn)));
+	Vec result = sum + carryIn;
+	Vec overflow = Not(IsZero((a ^ result) & (data ^ result) & Splat(FLAG_N)));
+
+	p = (p & Splat(static_cast<uint8_t>(~(FLAG_C | FLAG_V)))) | (carry & Splat(FLAG_C)) | (overflow & Splat(FLAG_V));
+	p = SetZN(p, result);
+	return result;
+}
+
+// Compare a register with data, matching the scalar core's CMP/CPX/CPY
+inline void Compare(Vec reg, Vec data, Vec& p) {
+	p = (p & Splat(static_cast<uint8_t>(~FLAG_C))) | (GreaterEqual(reg, data) & Splat(FLAG_C));
+	p = SetZN(p, reg - data);
+}
+
+// How an instruction with a SIMD kernel uses its operand
+enum class Access { NONE, READ, WRITE, MODIFY };
+
+struct Kernel {
+	uint8_t cycles; // Base cycle count, 0 if the instruction has no kernel
+	Access  access;
+};
+
+constexpr bool IsMemoryMode(AddressMode mode) {
+	return mode == ZERO_PAGE || mode == X_ZERO_PAGE || mode == Y_ZERO_PAGE ||
+		mode == ABSOLUTE || mode == X_ABSOLUTE || mode == Y_ABSOLUTE;
+}
+
+// Kernel for an operation, with the cycle counts of the scalar core
+//    Reads from indexed absolute addresses take one more cycle when they cross a page; writes and
+//    read-modify-write instructions on them always take it.
+constexpr Kernel KernelFor(Operation operation) {
+	const AddressMode mode = operation.mode;
+	const bool memory = IsMemoryMode(mode);
+	const bool indexed = (mode == X_ABSOLUTE || mode == Y_ABSOLUTE);
+	const uint8_t read = (mode == IMMEDIATE) ? 2 : (mode == ZERO_PAGE) ? 3 : 4;
+
+	switch (operation.instruction) {
+	case Instruction::LDA: case Instruction::LDX: case Instruction::LDY: case Instruction::AND:
+	case Instruction::ORA: case Instruction::EOR: case Instruction::ADC: case Instruction::SBC:
+	case Instruction::CMP: case Instruction::CPX: case Instruction::CPY: case Instruction::BIT:
+		if (memory || mode == IMMEDIATE)
+			return { read, Access::READ };
+		break;
+	case Instruction::STA: case Instruction::STX: case Instruction::STY:
+		if (memory)
+			return { static_cast<uint8_t>(read + indexed), Access::WRITE };
+		break;
+	case Instruction::INC: case Instruction::DEC: case Instruction::ASL: case Instruction::LSR:
+	case Instruction::ROL: case Instruction::ROR:
+		if (mode == ACCUMULATOR)
+			return { 2, Access::NONE };
+		if (memory)
+			return { static_cast<uint8_t>(read + 2 + indexed), Access::MODIFY };
+		break;
+	case Instruction::TAX: case Instruction::TAY: case Instruction::TXA: case Instruction::TYA:
+	case Instruction::TSX: case Instruction::TXS: case Instruction::INX: case Instruction::INY:
+	case Instruction::DEX: case Instruction::DEY: case Instruction::CLC: case Instruction::SEC:
+	case Instruction::CLV: case Instruction::CLD: case Instruction::SED:
+		return { 2, Access::NONE };
+	case Instruction::NOP:
+		if (mode == IMPLIED)
+			return { 2, Access::NONE };
+		break;
+	case Instruction::PHA: return { 3, Access::NONE };
+	case Instruction::PLA: return { 4, Access::NONE };
+	case Instruction::JSR: return { 6, Access::NONE };
+	case Instruction::RTS: return { 6, Access::NONE };
+	case Instruction::JMP:
+		if (mode == ABSOLUTE)
+			return { 3, Access::NONE };
+		break;
+	case Instruction::BCC: case Instruction::BCS: case Instruction::BEQ: case Instruction::BMI:
+	case Instruction::BNE: case Instruction::BPL: case Instruction::BVC: case Instruction::BVS:
+		return { 2, Access::NONE };
+	default:
+		break;
+	}
+	return { 0, Access::NONE };
+}
+
+// Flag a branch tests, and the value of it that takes the branch
+constexpr uint8_t BranchFlag(Instruction instruction) {
+	switch (instruction) {
+	case Instruction::BCC: case Instruction::BCS: return FLAG_C;
+	case Instruction::BEQ: case Instruction::BNE: return FLAG_Z;
+	case Instruction::BMI: case Instruction::BPL: return FLAG_N;
+	default:                                      return FLAG_V;
+	}
+}
+
+constexpr bool BranchWhenSet(Instruction instruction) {
+	return instruction == Instruction::BCS || instruction == Instruction::BEQ ||
+		instruction == Instruction::BMI || instruction == Instruction::BVS;
+}
+
+}
+
+void LaneBus::write(uint16_t addr, uint8_t data) {
+	if (addr < 0x8000)
+		ram[addr] = data;
+	else
+		cpu.status = E_BADW;
+}
+
+CpuBatch::CpuBatch(int instances)
+	: instances(instances)
+	, lanes((instances + LANE_WIDTH - 1) / LANE_WIDTH * LANE_WIDTH)
+	, ram(static_cast<size_t>(instances) << 15, 0xFF)
+	, group(lanes, 0)
+	, operand(lanes, 0)
+	, extra(lanes, 0)
+	, address(lanes, 0) {
+	for (auto& i : rom) i = 0xFF;
+
+	// Power on reset location (points to start of ROM)
+	rom[0x7FFC] = 0x00;
+	rom[0x7FFD] = 0x80;
+
+	PC.assign(lanes, 0);
+	SP.assign(lanes, 0);
+	A.assign(lanes, 0);
+	X.assign(lanes, 0);
+	Y.assign(lanes, 0);
+	P.assign(lanes, 0);
+	Cycles.assign(lanes, 0);
+	status.assign(lanes, 0);
+
+	// Padding lanes never run
+	for (int lane = instances; lane < lanes; lane++)
+		status[lane] = E_INV;
+
+	scalar.rom = rom;
+	Reset();
+}
+
+// Reset every lane
+void CpuBatch::Reset() {
+	uint16_t resetVector = rom[0x7FFC] | (rom[0x7FFD] << 8);
+	for (int lane = 0; lane < instances; lane++) {
+		PC[lane] = resetVector;
+		SP[lane] = 0xFF;
+		A[lane] = X[lane] = Y[lane] = P[lane] = 0;
+		Cycles[lane] = 0;
+		status[lane] = 0;
+	}
+}
+
+uint8_t CpuBatch::Read(int lane, uint16_t addr) const {
+	return (addr < 0x8000) ? ram[(static_cast<size_t>(lane) << 15) + addr] : rom[addr - 0x8000];
+}
+
+// Execute one instruction on a single lane with the scalar core
+void CpuBatch::ScalarStep(int lane) {
+	MOS6502Core<LaneBus>& cpu = scalar.cpu;
+	scalar.ram = Ram(lane);
+	cpu.PC = PC[lane];
+	cpu.SP = SP[lane];
+	cpu.A = A[lane];
+	cpu.X = X[lane];
+	cpu.Y = Y[lane];
+	cpu.P = P[lane];
+	cpu.status = 0;
+
+	cpu.Run(1);
+
+	PC[lane] = cpu.PC;
+	SP[lane] = cpu.SP;
+	A[lane] = cpu.A;
+	X[lane] = cpu.X;
+	Y[lane] = cpu.Y;
+	P[lane] = cpu.P;
+	Cycles[lane] += cpu.Cycles;
+	status[lane] = cpu.status;
+	scalarSteps++;
+}
+
+// Compute the effective address of every lane in the group, and read the data there if the
+// instruction reads it. Immediate operands are taken from the operand word
+//    The word is the one operand of shared code, or each lane's own in address[] otherwise. Lanes
+//    that would write to the shared image are stepped through the scalar core, which raises the
+//    error, and left out of the group. Stores of a register are made here as well.
+void CpuBatch::Gather(AddressMode mode, bool shared, uint16_t word, bool reads, bool writes, const uint8_t* stored) {
+	// Work through raw pointers, as stores through a byte pointer could otherwise alias the vectors
+	// and have them reloaded for every lane
+	uint8_t* const members = group.data();
+	uint8_t* const data = operand.data();
+	uint8_t* const penalty = extra.data();
+	uint16_t* const addresses = address.data();
+	uint8_t* const memory = ram.data();
+	const uint8_t* const x = X.data();
+	const uint8_t* const y = Y.data();
+	const int count = instances;
+
+	auto gather = [&](auto effective) {
+		for (int lane = 0; lane < count; lane++) {
+			if (!members[lane])
+				continue;
+			const uint16_t base = shared ? word : addresses[lane];
+			const uint16_t addr = effective(lane, base);
+			if (writes && addr >= 0x8000) {
+				members[lane] = 0x00;
+				ScalarStep(lane);
+				continue;
+			}
+			addresses[lane] = addr;
+			penalty[lane] = ((addr >> 8) != (base >> 8)) ? 1 : 0;
+			if (reads)
+				data[lane] = (addr < 0x8000) ? memory[(static_cast<size_t>(lane) << 15) + addr] : rom[addr - 0x8000];
+			if (stored)
+				memory[(static_cast<size_t>(lane) << 15) + addr] = stored[lane];
+		}
+	};
+
+	switch (mode) {
+	case IMMEDIATE:
+		for (int lane = 0; lane < count; lane++)
+			data[lane] = static_cast<uint8_t>(shared ? word : addresses[lane]);
+		break;
+	case ZERO_PAGE:   gather([](int, uint16_t base) { return static_cast<uint16_t>(base & 0xFF); }); break;
+	case X_ZERO_PAGE: gather([&](int lane, uint16_t base) { return static_cast<uint16_t>((base + x[lane]) & 0xFF); }); break;
+	case Y_ZERO_PAGE: gather([&](int lane, uint16_t base) { return static_cast<uint16_t>((base + y[lane]) & 0xFF); }); break;
+	case X_ABSOLUTE:  gather([&](int lane, uint16_t base) { return static_cast<uint16_t>(base + x[lane]); }); break;
+	case Y_ABSOLUTE:  gather([&](int lane, uint16_t base) { return static_cast<uint16_t>(base + y[lane]); }); break;
+	default:          gather([](int, uint16_t base) { return base; }); break;
+	}
+}
+
+// Execute one instruction on every lane of the group at once
+//    Every lane of the group is at the same program counter, so only the operand, and with it
+//    the effective address and branch target, can differ between them when the code is in RAM.
+//    Lanes the kernel cannot handle are stepped through the scalar core and left out. Returns
+//    false, without executing anything, if the instruction has no kernel.
+bool CpuBatch::VectorStep(uint16_t pc, uint8_t opcode) {
+	const Operation operation = decode_table[opcode];
+	const Instruction instruction = operation.instruction;
+	const AddressMode mode = operation.mode;
+	const Kernel kernel = KernelFor(operation);
+	if (kernel.cycles == 0)
+		return false;
+
+	// Code in the shared image has the same operand for every lane, code in RAM has one per lane
+	const int length = operation_length(mode);
+	const bool shared = (pc >= 0x8000 && pc + length <= 0x10000);
+	uint16_t word = 0;
+	if (shared) {
+		if (length > 1)
+			word = rom[pc + 1 - 0x8000];
+		if (length > 2)
+			word |= rom[pc + 2 - 0x8000] << 8;
+	}
+	else if (length > 1) {
+		for (int lane = 0; lane < instances; lane++)
+			if (group[lane])
+				address[lane] = Read(lane, pc + 1) | ((length > 2) ? (Read(lane, pc + 2) << 8) : 0);
+	}
+
+	// Decimal mode is left to the scalar core
+	if (instruction == Instruction::ADC || instruction == Instruction::SBC) {
+		for (int base = 0; base < lanes; base += LANE_WIDTH) {
+			const Vec mask = Load(&group[base]);
+			if (!Any(mask & Not(IsZero(Load(&P[base]) & Splat(FLAG_D)))))
+				continue;
+			for (int lane = base; lane < base + LANE_WIDTH; lane++) {
+				if (group[lane] && (P[lane] & FLAG_D)) {
+					group[lane] = 0x00;
+					ScalarStep(lane);
+				}
+			}
+		}
+	}
+
+	const uint8_t* stored = (instruction == Instruction::STA) ? A.data() : (instruction == Instruction::STX) ? X.data() :
+		(instruction == Instruction::STY) ? Y.data() : nullptr;
+	if (kernel.access != Access::NONE)
+		Gather(mode, shared, word, kernel.access != Access::WRITE, kernel.access != Access::READ, stored);
+
+	// Stack accesses, and the targets of branches in RAM
+	const uint16_t next = static_cast<uint16_t>(pc + length);
+	const bool perLane = (instruction == Instruction::PHA || instruction == Instruction::PLA ||
+		instruction == Instruction::JSR || instruction == Instruction::RTS || (mode == RELATIVE && !shared));
+	for (int lane = 0; perLane && lane < instances; lane++) {
+		if (!group[lane])
+			continue;
+
+		uint8_t* stack = Ram(lane) + 0x0100;
+		const uint8_t sp = SP[lane];
+		switch (instruction) {
+		case Instruction::PHA:
+			stack[sp] = A[lane];
+			break;
+		case Instruction::PLA:
+			operand[lane] = stack[static_cast<uint8_t>(sp + 1)];
+			break;
+		case Instruction::JSR:
+			stack[sp] = static_cast<uint8_t>((next - 1) >> 8);
+			stack[static_cast<uint8_t>(sp - 1)] = static_cast<uint8_t>(next - 1);
+			break;
+		case Instruction::RTS:
+			address[lane] = (stack[static_cast<uint8_t>(sp + 1)] | (stack[static_cast<uint8_t>(sp + 2)] << 8)) + 1;
+			break;
+		default:
+			address[lane] = next + static_cast<int8_t>(address[lane]);
+			extra[lane] = ((address[lane] >> 8) != (next >> 8)) ? 2 : 1;
+			break;
+		}
+	}
+
+	// Shared code has one branch target for every lane
+	const uint16_t target = static_cast<uint16_t>(next + static_cast<int8_t>(word));
+	const bool cross = (target >> 8) != (next >> 8);
+	const uint8_t flag = BranchFlag(instruction);
+	const Vec condition = Splat(BranchWhenSet(instruction) ? flag : 0);
+
+	for (int base = 0; base < lanes; base += LANE_WIDTH) {
+		const Vec mask = Load(&group[base]);
+		if (!Any(mask))
+			continue;
+
+		Vec a = Load(&A[base]);
+		Vec x = Load(&X[base]);
+		Vec y = Load(&Y[base]);
+		Vec sp = Load(&SP[base]);
+		Vec p = Load(&P[base]);
+		Vec data = Load(&operand[base]);
+		Vec cycles = Splat(kernel.cycles);
+		Vec taken = Splat(0);
+
+		switch (instruction) {
+		case Instruction::LDA: a = data; p = SetZN(p, a); break;
+		case Instruction::LDX: x = data; p = SetZN(p, x); break;
+		case Instruction::LDY: y = data; p = SetZN(p, y); break;
+		case Instruction::AND: a = a & data; p = SetZN(p, a); break;
+		case Instruction::ORA: a = a | data; p = SetZN(p, a); break;
+		case Instruction::EOR: a = a ^ data; p = SetZN(p, a); break;
+		case Instruction::ADC: a = AddWithCarry(a, data, p); break;
+		case Instruction::SBC: a = AddWithCarry(a, Not(data), p); break;
+		case Instruction::CMP: Compare(a, data, p); break;
+		case Instruction::CPX: Compare(x, data, p); break;
+		case Instruction::CPY: Compare(y, data, p); break;
+		case Instruction::BIT:
+			p = (p & Splat(static_cast<uint8_t>(~(FLAG_Z | FLAG_V | FLAG_N)))) | (IsZero(a & data) & Splat(FLAG_Z)) |
+				(data & Splat(FLAG_V | FLAG_N));
+			break;
+		case Instruction::INC: data = data + Splat(1); p = SetZN(p, data); break;
+		case Instruction::DEC: data = data - Splat(1); p = SetZN(p, data); break;
+		case Instruction::ASL:
+		case Instruction::ROL:
+		{
+			// Shifts and rotates work on the accumulator or the data read
+			const Vec value = (mode == ACCUMULATOR) ? a : data;
+			const Vec in = (instruction == Instruction::ROL) ? (p & Splat(FLAG_C)) : Splat(0);
+			const Vec result = (value + value) | in;
+			p = (p & Splat(static_cast<uint8_t>(~FLAG_C))) | (Not(IsZero(value & Splat(0x80))) & Splat(FLAG_C));
+			p = SetZN(p, result);
+			if (mode == ACCUMULATOR)
+				a = result;
+			else
+				data = result;
+			break;
+		}
+		case Instruction::LSR:
+		case Instruction::ROR:
+		{
+			const Vec value = (mode == ACCUMULATOR) ? a : data;
+			const Vec in = (instruction == Instruction::ROR) ? (Not(IsZero(p & Splat(FLAG_C))) & Splat(0x80)) : Splat(0);
+			const Vec result = ShiftRight1(value) | in;
+			p = (p & Splat(static_cast<uint8_t>(~FLAG_C))) | (value & Splat(FLAG_C));
+			p = SetZN(p, result);
+			if (mode == ACCUMULATOR)
+				a = result;
+			else
+				data = result;
+			break;
+		}
+		case Instruction::TAX: x = a; p = SetZN(p, x); break;
+		case Instruction::TAY: y = a; p = SetZN(p, y); break;
+		case Instruction::TXA: a = x; p = SetZN(p, a); break;
+		case Instruction::TYA: a = y; p = SetZN(p, a); break;
+		case Instruction::TSX: x = sp; p = SetZN(p, x); break;
+		case Instruction::TXS: sp = x; break;
+		case Instruction::INX: x = x + Splat(1); p = SetZN(p, x); break;
+		case Instruction::INY: y = y + Splat(1); p = SetZN(p, y); break;
+		case Instruction::DEX: x = x - Splat(1); p = SetZN(p, x); break;
+		case Instruction::DEY: y = y - Splat(1); p = SetZN(p, y); break;
+		case Instruction::CLC: p = p & Splat(static_cast<uint8_t>(~FLAG_C)); break;
+		case Instruction::SEC: p = p | Splat(FLAG_C); break;
+		case Instruction::CLV: p = p & Splat(static_cast<uint8_t>(~FLAG_V)); break;
+		case Instruction::CLD: p = p & Splat(static_cast<uint8_t>(~FLAG_D)); break;
+		case Instruction::SED: p = p | Splat(FLAG_D); break;
+		case Instruction::PHA: sp = sp - Splat(1); break;
+		case Instruction::PLA: sp = sp + Splat(1); a = data; p = SetZN(p, a); break;
+		case Instruction::JSR: sp = sp - Splat(2); break;
+		case Instruction::RTS: sp = sp + Splat(2); break;
+		default:
+			if (mode == RELATIVE)
+				taken = mask & Equal(p & Splat(flag), condition);
+			break;
+		}
+
+		Store(&A[base], Select(mask, a, Load(&A[base])));
+		Store(&X[base], Select(mask, x, Load(&X[base])));
+		Store(&Y[base], Select(mask, y, Load(&Y[base])));
+		Store(&SP[base], Select(mask, sp, Load(&SP[base])));
+		Store(&P[base], Select(mask, p, Load(&P[base])));
+		Store(&operand[base], data);
+
+		// Move on to the next instruction, or to the target of a jump or taken branch
+		switch (instruction) {
+		case Instruction::JMP:
+		case Instruction::JSR:
+			if (shared)
+				Select16(&PC[base], mask, word);
+			else
+				Select16(&PC[base], mask, &address[base]);
+			break;
+		case Instruction::RTS:
+			Select16(&PC[base], mask, &address[base]);
+			break;
+		default:
+			Select16(&PC[base], mask, next);
+			if (mode == RELATIVE) {
+				if (shared) {
+					Select16(&PC[base], taken, target);
+					cycles = cycles + (taken & Splat(cross ? 2 : 1));
+				}
+				else {
+					Select16(&PC[base], taken, &address[base]);
+					cycles = cycles + (taken & Load(&extra[base]));
+				}
+			}
+			break;
+		}
+
+		// Reads from indexed absolute addresses crossing a page take a cycle more
+		if (kernel.access == Access::READ && (mode == X_ABSOLUTE || mode == Y_ABSOLUTE))
+			cycles = cycles + Load(&extra[base]);
+		Add32(&Cycles[base], cycles & mask);
+	}
+
+	// Scatter the results of read-modify-write instructions back to each lane's RAM
+	if (kernel.access == Access::MODIFY) {
+		uint8_t* const memory = ram.data();
+		const uint8_t* const members = group.data();
+		const uint8_t* const data = operand.data();
+		const uint16_t* const addresses = address.data();
+		for (int lane = 0; lane < instances; lane++)
+			if (members[lane])
+				memory[(static_cast<size_t>(lane) << 15) + addresses[lane]] = data[lane];
+	}
+
+	vectorSteps++;
+	return true;
+}
+
+// Run every lane for a requested number of cycles
+//    Each step runs the lanes at the lowest program counter, so lanes that have gone ahead on one
+//    side of a branch wait there for the rest to catch up. Each lane stops once it has used the
+//    requested cycles or hit an error, which is left in its status entry. Lanes with an error
+//    stay stopped until Reset.
+void CpuBatch::Run(int32_t CyclesRequested) {
+	for (int lane = 0; lane < instances; lane++)
+		Cycles[lane] = 0;
+
+	while (true) {
+		// Find the lowest program counter of the running lanes
+		int pc = 0x10000;
+		for (int base = 0; base < lanes; base += LANE_WIDTH) {
+			const Vec running = Running(&Cycles[base], &status[base], CyclesRequested);
+			Store(&group[base], running);
+			if (Any(running))
+				pc = std::min<int>(pc, Lowest(&PC[base], running));
+		}
+
+		if (pc == 0x10000)
+			return;
+
+		// Group the lanes there. In RAM only those agreeing on the opcode with the first of them
+		// take part, and the others run in a later step
+		for (int base = 0; base < lanes; base += LANE_WIDTH)
+			Store(&group[base], Load(&group[base]) & EqualTo(&PC[base], static_cast<uint16_t>(pc)));
+
+		uint8_t opcode = 0;
+		if (pc >= 0x8000) {
+			opcode = rom[pc - 0x8000];
+		}
+		else {
+			bool first = true;
+			for (int lane = 0; lane < instances; lane++) {
+				if (!group[lane])
+					continue;
+				const uint8_t laneOpcode = Read(lane, static_cast<uint16_t>(pc));
+				if (first)
+					opcode = laneOpcode;
+				else if (laneOpcode != opcode)
+					group[lane] = 0x00;
+				first = false;
+			}
+		}
+
+		if (VectorStep(static_cast<uint16_t>(pc), opcode))
+			continue;
+
+		for (int lane = 0; lane < instances; lane++)
+			if (group[lane])
+				ScalarStep(lane);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "MOS6502.h"
+#include <cstdint>
+#include <vector>
+
+// Memory view of a single instance in a CpuBatch
+//    Lanes share one read-only image for 0x8000-0xFFFF (program and vectors) and each own 32KB of
+//    RAM at 0x0000-0x7FFF, so a batch of instances costs 32KB per instance plus one image.
+class LaneBus
+{
+public:
+	LaneBus() { cpu.ConnectBus(this); }
+
+	LaneBus(const LaneBus&) = delete;
+	LaneBus& operator=(const LaneBus&) = delete;
+
+	MOS6502Core<LaneBus> cpu;
+	const uint8_t* rom = nullptr; // 0x8000 - 0xFFFF, shared
+	uint8_t*       ram = nullptr; // 0x0000 - 0x7FFF, private to the lane
+
+	void write(uint16_t addr, uint8_t data);
+	uint8_t read(uint16_t addr) { return (addr < 0x8000) ? ram[addr] : rom[addr - 0x8000]; }
+	uint8_t Peek(uint16_t addr) const { return (addr < 0x8000) ? ram[addr] : rom[addr - 0x8000]; }
+};
+
+// Batch of independent MOS6502 instances executed in lockstep
+//    Register state is held in structure-of-arrays form. Each step takes the running lanes at the
+//    lowest program counter that agree on the opcode there, so lanes split by a branch wait for
+//    each other where the paths meet again, and runs that instruction for the whole group at once
+//    with SIMD kernels. Loads, stores and read-modify-write instructions on the zero page and
+//    absolute addresses, indexed or not, gather and scatter each lane's own RAM; branches, jumps,
+//    subroutine calls and the stack are covered as well. Only the lanes a kernel cannot handle
+//    (decimal arithmetic, writes to the shared image) and instructions without a kernel are
+//    stepped through the scalar core.
+class CpuBatch
+{
+public:
+	static constexpr int LANE_WIDTH = 16; // Lanes processed per vector
+
+	explicit CpuBatch(int instances);
+
+	CpuBatch(const CpuBatch&) = delete;
+	CpuBatch& operator=(const CpuBatch&) = delete;
+
+public: // Components
+	uint8_t rom[32 * 1024]; // 0x8000 - 0xFFFF, shared by every lane
+
+	// Registers, one entry per lane (padded to a multiple of LANE_WIDTH)
+	std::vector<uint16_t> PC;
+	std::vector<uint8_t>  SP;
+	std::vector<uint8_t>  A;
+	std::vector<uint8_t>  X;
+	std::vector<uint8_t>  Y;
+	std::vector<uint8_t>  P;
+	std::vector<int32_t>  Cycles;
+	std::vector<int>      status;
+
+	int Size() const { return instances; }
+	uint8_t* Ram(int lane) { return &ram[static_cast<size_t>(lane) << 15]; }
+
+	// Steps taken with the SIMD kernels and with the scalar fallback, for tuning workloads
+	uint64_t vectorSteps = 0;
+	uint64_t scalarSteps = 0;
+
+public:
+	void Reset();
+	void Run(int32_t CyclesRequested);
+
+private:
+	int instances;
+	int lanes; // instances rounded up to LANE_WIDTH
+	std::vector<uint8_t> ram;
+
+	// Per-lane state of the step being executed
+	std::vector<uint8_t>  group;   // 0xFF for lanes taking part, 0x00 otherwise
+	std::vector<uint8_t>  operand; // Data read for the lane, or to be written by it
+	std::vector<uint8_t>  extra;   // Cycles taken beyond the instruction's base count
+	std::vector<uint16_t> address; // Operand word, then effective address or jump target
+
+	LaneBus scalar;
+
+	uint8_t Read(int lane, uint16_t addr) const;
+	void    Gather(AddressMode mode, bool shared, uint16_t word, bool reads, bool writes, const uint8_t* stored);
+	bool    VectorStep(uint16_t pc, uint8_t opcode);
+	void    ScalarStep(int lane);
+};
@@ -1,11 +1,30 @@
 #include "bus.h"
 #include "exitcodes.h"
-#include <iostream>
+#include <cstring>
 
 Bus::Bus() {
 	cpu.ConnectBus(this);
 	for (auto& i : ram) i = 0xFF;
 
+	// Build the page table
+	for (int page = 0; page < 64; page++)
+		romPages[page] = &rom[page << 8];
+	for (int page = 0; page < 256; page++) {
+		devices[page] = nullptr;
+		traps[page] = 0;
+		dirty[page] = DIRTY_ALL;
+		MapMemory(page);
+	}
+
+	ResetVectors();
+	cpu.Reset();
+}
+
+Bus::~Bus() {
+
+}
+
+void Bus::ResetVectors() {
 	// NMI handler (not implemented)
 	vectors[0] = 0xFF;
 	vectors[1] = 0xFF;
@@ -17,30 +36,331 @@ Bus::Bus() {
 	// BRK/IRQ handler (not implemented)
 	vectors[4] = 0xFF;
 	vectors[5] = 0xFF;
+}
 
-	cpu.Reset();
+// Memory a page reads from when no device is attached to it, or nullptr
+const uint8_t* Bus::BackingPage(uint8_t page) const {
+	if (page <= 0x7F)
+		return &ram[page << 8];
+	if (page <= 0xBF)
+		return romPages[page - 0x80];
+	return nullptr;
 }
 
-Bus::~Bus() {
+// Point a page at its default backing memory
+void Bus::MapMemory(uint8_t page) {
+	memoryPages[page] = (page <= 0x7F) ? &ram[page << 8] : nullptr;
+	readPages[page] = (traps[page] & READ_TRAPS) ? nullptr : BackingPage(page);
+	writePages[page] = (traps[page] & WRITE_TRAPS) ? nullptr : memoryPages[page];
+}
 
+// Route accesses to a page through the slow path for the given reason
+void Bus::SetTrap(uint8_t page, uint8_t trap) {
+	traps[page] |= trap;
+	if (trap & WRITE_TRAPS)
+		writePages[page] = nullptr;
+	if (trap & READ_TRAPS)
+		readPages[page] = nullptr;
 }
 
+// Remove a reason for trapping a page, restoring the fast path once none are left
+void Bus::ClearTrap(uint8_t page, uint8_t trap) {
+	traps[page] &= ~trap;
+	if (devices[page])
+		return;
+	if (!(traps[page] & WRITE_TRAPS))
+		writePages[page] = memoryPages[page];
+	if (!(traps[page] & READ_TRAPS))
+		readPages[page] = BackingPage(page);
+}
+
+// Map an image over the ROM pages, starting at 0x8000
+void Bus::MapRom(const RomImage& image) {
+	for (int page = 0; page < 64; page++) {
+		romPages[page] = (static_cast<size_t>(page) < image.Pages()) ? image.Data() + (page << 8) : &rom[page << 8];
+		if (!devices[0x80 + page])
+			MapMemory(0x80 + page);
+	}
+	cpu.FlushBlockCache();
+}
+
+// Point the ROM pages back at rom[]
+void Bus::UnmapRom() {
+	for (int page = 0; page < 64; page++) {
+		romPages[page] = &rom[page << 8];
+		if (!devices[0x80 + page])
+			MapMemory(0x80 + page);
+	}
+	cpu.FlushBlockCache();
+}
+
+// Attach a device to a range of pages. Accesses to those pages are forwarded to the device
+void Bus::MapDevice(uint8_t firstPage, uint8_t lastPage, Device* device) {
+	for (int page = firstPage; page <= lastPage; page++) {
+		readPages[page] = nullptr;
+		writePages[page] = nullptr;
+		memoryPages[page] = nullptr;
+		devices[page] = device;
+	}
+	cpu.FlushBlockCache();
+}
+
+// Detach any device from a range of pages, restoring the default memory map
+void Bus::UnmapDevice(uint8_t firstPage, uint8_t lastPage) {
+	for (int page = firstPage; page <= lastPage; page++) {
+		devices[page] = nullptr;
+		MapMemory(page);
+	}
+	cpu.FlushBlockCache();
+}
+
+// Handle a write to a page without direct backing memory
+void Bus::SlowWrite(uint16_t addr, uint8_t data) {
+	uint8_t page = addr >> 8;
+	if ((traps[page] & TRAP_WATCH_WRITE) && writeWatches[addr]) {
+		lastHit = addr;
+		cpu.status = E_WATCHW;
+	}
+
+	if (uint8_t* memory = memoryPages[page]) {
+		// Only the blocks decoded from this byte are dropped, so data next to code does not
+		// keep evicting it. The page stays watched while blocks are left on it
+		if (traps[page] & TRAP_CODE)
+			cpu.InvalidateCode(addr);
+		if (traps[page] & TRAP_DIRTY) {
+			ClearTrap(page, TRAP_DIRTY);
+			dirty[page] = DIRTY_ALL;
+		}
+		memory[addr & 0xFF] = data;
+		return;
+	}
+
+	if (Device* device = devices[addr >> 8]) {
+		device->write(addr, data);
+		return;
+	}
 
-//0x0000-0x7FFF ram 0x8000-0xFFFF rom
-void Bus::write(uint16_t addr, uint8_t data) {
-	if (addr >= 0x0000 && addr <= 0x7FFF)
-		ram[addr] = data;
 	cpu.status = E_BADW;
 }
 
-uint8_t Bus::read(uint16_t addr) {
-	if (addr >= 0x0000 && addr <= 0x7FFF)
-		return ram[addr];
-	else if (addr >= 0x8000 && addr <= 0xAFFF)
-		return rom[addr % 0x4000];
-	else if (addr >= 0xFFFA && addr <= 0xFFFF)
+// Handle a read from a page without direct backing memory
+uint8_t Bus::SlowRead(uint16_t addr) {
+	uint8_t page = addr >> 8;
+	if ((traps[page] & TRAP_WATCH_READ) && readWatches[addr]) {
+		lastHit = addr;
+		cpu.status = E_WATCHR;
+	}
+
+	if (Device* device = devices[page]) {
+		if (cpu.Replaying())
+			return cpu.ReplayRead(addr);
+		uint8_t data = device->read(addr);
+		cpu.RecordRead(addr, data);
+		return data;
+	}
+	if (const uint8_t* memory = BackingPage(page))
+		return memory[addr & 0xFF];
+	if (addr >= 0xFFFA)
 		return vectors[addr - 0xFFFA];
 
 	cpu.status = E_BADR;
 	return 0;
-}
\ No newline at end of file
+}
+
+// Handle an opcode fetch from a page without direct backing memory
+uint8_t Bus::SlowFetch(uint16_t addr) {
+	if ((traps[addr >> 8] & TRAP_BREAK) && breakpoints[addr]) {
+		// The fetch is repeated at the same clock when execution resumes from this breakpoint
+		if (addr != resumeAddr || cpu.Clock() != resumeClock) {
+			lastHit = addr;
+			resumeAddr = addr;
+			resumeClock = cpu.Clock();
+			cpu.Break(E_BREAK);
+			return 0;
+		}
+	}
+	return SlowRead(addr);
+}
+
+void Bus::SetWatch(std::bitset<0x10000>& bits, uint8_t trap, uint16_t addr, bool enable) {
+	bits[addr] = enable;
+
+	// The page stays trapped while any address on it is still watched
+	const uint8_t page = addr >> 8;
+	bool watched = false;
+	for (int i = 0; i < 256 && !watched; i++)
+		watched = bits[(page << 8) | i];
+
+	if (watched) {
+		SetTrap(page, trap);
+		cpu.InvalidateCodePage(page);
+	}
+	else {
+		ClearTrap(page, trap);
+	}
+}
+
+void Bus::ClearWatches() {
+	breakpoints.reset();
+	readWatches.reset();
+	writeWatches.reset();
+	for (int page = 0; page < 256; page++)
+		ClearTrap(page, TRAP_WATCH_WRITE | TRAP_WATCH_READ | TRAP_BREAK);
+}
+
+uint8_t Bus::Peek(uint16_t addr) const {
+	const uint8_t page = addr >> 8;
+	if (devices[page])
+		return 0;
+	if (const uint8_t* memory = BackingPage(page))
+		return memory[addr & 0xFF];
+	if (addr >= 0xFFFA)
+		return vectors[addr - 0xFFFA];
+	return 0;
+}
+
+// Stores like write(), keeping cached code and dirty pages current, but never reaches a device or
+// a watchpoint
+bool Bus::Poke(uint16_t addr, uint8_t data) {
+	const uint8_t page = addr >> 8;
+	if (devices[page])
+		return false;
+
+	if (uint8_t* memory = memoryPages[page]) {
+		if (traps[page] & TRAP_DIRTY) {
+			ClearTrap(page, TRAP_DIRTY);
+			dirty[page] = DIRTY_ALL;
+		}
+		memory[addr & 0xFF] = data;
+	}
+	else if (page >= 0x80 && page <= 0xBF && romPages[page - 0x80] == &rom[(page - 0x80) << 8]) {
+		rom[addr - 0x8000] = data;
+	}
+	else if (addr >= 0xFFFA) {
+		vectors[addr - 0xFFFA] = data;
+	}
+	else {
+		return false;
+	}
+
+	cpu.InvalidateCode(addr);
+	return true;
+}
+
+// Start or stop tracking which pages are written. Tracking starts with no page reported dirty
+void Bus::EnableDirtyTracking(bool enable) {
+	if (enable == dirtyTracking)
+		return;
+	dirtyTracking = enable;
+
+	for (int page = 0; page < 256; page++) {
+		if (enable) {
+			// Snapshots cannot trust pages changed before tracking started
+			dirty[page] = DIRTY_SNAPSHOT;
+			MarkClean(page, DIRTY_USER);
+		}
+		else {
+			dirty[page] = DIRTY_ALL;
+			ClearTrap(page, TRAP_DIRTY);
+		}
+	}
+}
+
+// Pages written since tracking was enabled or the last ClearDirtyPages
+std::bitset<256> Bus::DirtyPages() const {
+	std::bitset<256> pages;
+	for (int page = 0; page < 256; page++)
+		pages[page] = (dirty[page] & DIRTY_USER) != 0;
+	return pages;
+}
+
+void Bus::ClearDirtyPages() {
+	for (int page = 0; page < 256; page++)
+		if (dirty[page] & DIRTY_USER)
+			MarkClean(page, DIRTY_USER);
+}
+
+// Mark a page clean for one consumer and watch it for the next write. Without tracking pages are
+// always considered dirty
+void Bus::MarkClean(uint8_t page, uint8_t consumer) {
+	if (!dirtyTracking)
+		return;
+	dirty[page] &= ~consumer;
+	if (memoryPages[page])
+		SetTrap(page, TRAP_DIRTY);
+}
+
+// Capture the CPU registers and memory. Pages that still match the last synchronized snapshot
+// share its storage instead of being copied. With dirty tracking enabled, clean writable pages are
+// known to match and are not compared
+Snapshot Bus::TakeSnapshot() {
+	Snapshot snapshot;
+	snapshot.PC = cpu.PC;
+	snapshot.SP = cpu.SP;
+	snapshot.A = cpu.A;
+	snapshot.X = cpu.X;
+	snapshot.Y = cpu.Y;
+	snapshot.P = cpu.P;
+	snapshot.Cycles = cpu.Cycles;
+	snapshot.status = cpu.status;
+	snapshot.clock = cpu.Clock();
+	snapshot.irqLines = cpu.irqLines;
+	snapshot.nmiLine = cpu.nmiLine;
+	snapshot.nmiPending = cpu.nmiPending;
+	std::memcpy(snapshot.vectors.data(), vectors, sizeof(vectors));
+
+	for (int i = 0; i < Snapshot::PAGES; i++) {
+		const uint8_t* memory = SnapshotPage(i);
+		if (!snapshotPages[i] || (!SnapshotPageClean(i) && std::memcmp(snapshotPages[i]->data(), memory, 256) != 0)) {
+			auto page = std::make_shared<Snapshot::Page>();
+			std::memcpy(page->data(), memory, 256);
+			snapshotPages[i] = std::move(page);
+		}
+		snapshot.pages[i] = snapshotPages[i];
+		MarkClean(i, DIRTY_SNAPSHOT);
+	}
+	return snapshot;
+}
+
+// Return the CPU registers and memory to a snapshot. Only pages that differ from it are copied
+void Bus::Restore(const Snapshot& snapshot) {
+	cpu.PC = snapshot.PC;
+	cpu.SP = snapshot.SP;
+	cpu.A = snapshot.A;
+	cpu.X = snapshot.X;
+	cpu.Y = snapshot.Y;
+	cpu.P = snapshot.P;
+	cpu.Cycles = snapshot.Cycles;
+	cpu.status = snapshot.status;
+	cpu.clock = snapshot.clock;
+	cpu.irqLines = snapshot.irqLines;
+	cpu.nmiLine = snapshot.nmiLine;
+	cpu.nmiPending = snapshot.nmiPending;
+	std::memcpy(vectors, snapshot.vectors.data(), sizeof(vectors));
+
+	for (int i = 0; i < Snapshot::PAGES; i++) {
+		const uint8_t* memory = SnapshotPage(i);
+		const uint8_t* saved = snapshot.pages[i]->data();
+		if (snapshotPages[i] == snapshot.pages[i] && SnapshotPageClean(i))
+			continue;
+		if (std::memcmp(memory, saved, 256) != 0) {
+			uint8_t* target = (i < Snapshot::RAM_PAGES) ? &ram[i << 8] : &rom[(i - Snapshot::RAM_PAGES) << 8];
+			if (i >= Snapshot::RAM_PAGES) {
+				// A mapped ROM image cannot be written, so a page that differs from it goes back to rom[]
+				if (memory != target) {
+					romPages[i - Snapshot::RAM_PAGES] = target;
+					if (!devices[i])
+						MapMemory(i);
+				}
+			}
+			std::memcpy(target, saved, 256);
+			dirty[i] |= DIRTY_USER;
+
+			// The copy bypasses the code page traps, so drop any blocks decoded from this page.
+			// Snapshot pages are numbered like the bus pages they cover
+			cpu.InvalidateCodePage(i);
+		}
+		snapshotPages[i] = snapshot.pages[i];
+		MarkClean(i, DIRTY_SNAPSHOT);
+	}
+}
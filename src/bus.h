@@ -1,5 +1,9 @@
 #pragma once
 #include "MOS6502.h"
+#include "device.h"
+#include "romimage.h"
+#include "snapshot.h"
+#include <bitset>
 #include <cstdint>
 
 class Bus
@@ -8,11 +12,17 @@ public:
 	Bus();
 	~Bus();
 
+	Bus(const Bus&) = delete;
+	Bus& operator=(const Bus&) = delete;
+
 public: // Components
 	MOS6502 cpu;
 	uint8_t ram[32 * 1024]; // 0x0000 - 0x7FFF
 	uint8_t rom[16 * 1024]; // 0x8000 - 0xBFFF
 	uint8_t vectors[6];     // 0xFFFA - 0xFFFF
+
+	// Put the vectors back to their power-on values
+	void ResetVectors();
 	// Program ROM
 	//     header: 1 byte, indicating number of chunks of rom data
 	// I/O devices
@@ -25,7 +35,150 @@ Memory layout:
    ----------------------------------------------------------------------------------------
 */
 
+private: // Page table
+	// One entry per 256-byte page. A non-null entry points at the backing bytes of that page and
+	// is accessed directly; a null entry sends the access through the slow path, which handles
+	// devices, the vectors, trapped pages and invalid accesses.
+	const uint8_t* readPages[256];
+	uint8_t*       writePages[256];
+	uint8_t*       memoryPages[256]; // Writable backing memory, kept even while the page is trapped
+	const uint8_t* romPages[64];     // Backing bytes of 0x8000 - 0xBFFF: rom[] or a mapped RomImage
+	Device*        devices[256];
+	uint8_t        traps[256];
+
+	// Page traps: reasons a page is routed through the slow read or write path
+	static constexpr uint8_t TRAP_CODE        = (1 << 0); // Page holds predecoded code
+	static constexpr uint8_t TRAP_DIRTY       = (1 << 1); // Page is clean and waiting for its first write
+	static constexpr uint8_t TRAP_WATCH_WRITE = (1 << 2); // Page holds write watchpoints
+	static constexpr uint8_t TRAP_WATCH_READ  = (1 << 3); // Page holds read watchpoints
+	static constexpr uint8_t TRAP_BREAK       = (1 << 4); // Page holds breakpoints
+	static constexpr uint8_t WRITE_TRAPS = TRAP_CODE | TRAP_DIRTY | TRAP_WATCH_WRITE;
+	static constexpr uint8_t READ_TRAPS  = TRAP_WATCH_READ | TRAP_BREAK;
+
+	void SetTrap(uint8_t page, uint8_t trap);
+	void ClearTrap(uint8_t page, uint8_t trap);
+	void MapMemory(uint8_t page);
+	const uint8_t* BackingPage(uint8_t page) const;
+
+	uint8_t SlowRead(uint16_t addr);
+	uint8_t SlowFetch(uint16_t addr);
+	void    SlowWrite(uint16_t addr, uint8_t data);
+
+public: // Code watching
+	const uint8_t* DirectPage(uint8_t page) const { return readPages[page]; }
+	void WatchCodePage(uint8_t page) { SetTrap(page, TRAP_CODE); }
+	void UnwatchCodePage(uint8_t page) { ClearTrap(page, TRAP_CODE); }
+
+	// Page tables for generated code to access memory through directly
+	const uint8_t* const* ReadPageTable() const { return readPages; }
+	uint8_t* const* WritePageTable() const { return writePages; }
+
+private: // Dirty page tracking
+	// While tracking, every clean writable page is trapped. The first write to it marks it dirty for
+	// every consumer and lifts the trap, so the remaining writes to a dirty page stay on the fast
+	// path and nothing is paid while tracking is disabled.
+	static constexpr uint8_t DIRTY_USER     = (1 << 0); // Reported through DirtyPages
+	static constexpr uint8_t DIRTY_SNAPSHOT = (1 << 1); // Changed since the last snapshot sync
+	static constexpr uint8_t DIRTY_ALL      = DIRTY_USER | DIRTY_SNAPSHOT;
+
+	bool    dirtyTracking = false;
+	uint8_t dirty[256];
+
+	void MarkClean(uint8_t page, uint8_t consumer);
+
+public: // Dirty page tracking
+	//    Only writes made through write() are seen; changes made directly to ram[] are not.
+	void EnableDirtyTracking(bool enable);
+	bool DirtyTracking() const { return dirtyTracking; }
+	bool PageDirty(uint8_t page) const { return dirty[page] & DIRTY_USER; }
+	std::bitset<256> DirtyPages() const;
+	void ClearDirtyPages();
+
+private: // Snapshots
+	// Pages of the snapshot this system was last synchronized with, shared by the next snapshot
+	// wherever the memory still matches
+	std::shared_ptr<const Snapshot::Page> snapshotPages[Snapshot::PAGES];
+
+	bool SnapshotPageClean(int page) const { return dirtyTracking && memoryPages[page] && !(dirty[page] & DIRTY_SNAPSHOT); }
+	const uint8_t* SnapshotPage(int page) const { return (page < Snapshot::RAM_PAGES) ? &ram[page << 8] : romPages[page - Snapshot::RAM_PAGES]; }
+
+public: // Snapshots
+	Snapshot TakeSnapshot();
+	void     Restore(const Snapshot& snapshot);
+
+public: // ROM images
+	//    Mapping an image points the ROM pages it covers straight at the image instead of rom[], so
+	//    many systems can run the same image without copying it. Pages past the end of the image
+	//    keep reading rom[].
+	void MapRom(const RomImage& image);
+	void UnmapRom();
+
+private: // Breakpoints and watchpoints
+	std::bitset<0x10000> breakpoints;
+	std::bitset<0x10000> readWatches;
+	std::bitset<0x10000> writeWatches;
+	uint16_t lastHit = 0;
+	uint16_t resumeAddr = 0;  // Breakpoint last stopped at, passed over when execution resumes
+	uint64_t resumeClock = 0;
+
+	void SetWatch(std::bitset<0x10000>& bits, uint8_t trap, uint16_t addr, bool enable);
+
+public: // Breakpoints and watchpoints
+	//    Each kind is a 64K-bit bitmap, and only pages holding at least one are routed through the
+	//    slow paths, so execution elsewhere pays nothing for them. Run stops with E_BREAK before an
+	//    instruction at a breakpoint is executed, and with E_WATCHR or E_WATCHW once the
+	//    instruction making a watched access completes. Clearing status and running again carries
+	//    on from a breakpoint without stopping at it a second time. Opcode fetches and operand
+	//    fetches count as reads.
+	void SetBreakpoint(uint16_t addr, bool enable = true) { SetWatch(breakpoints, TRAP_BREAK, addr, enable); }
+	void SetReadWatch(uint16_t addr, bool enable = true)  { SetWatch(readWatches, TRAP_WATCH_READ, addr, enable); }
+	void SetWriteWatch(uint16_t addr, bool enable = true) { SetWatch(writeWatches, TRAP_WATCH_WRITE, addr, enable); }
+	void ClearWatches();
+
+	bool Breakpoint(uint16_t addr) const { return breakpoints[addr]; }
+	bool ReadWatch(uint16_t addr) const  { return readWatches[addr]; }
+	bool WriteWatch(uint16_t addr) const { return writeWatches[addr]; }
+
+	// Address of the breakpoint or watched access that last stopped Run
+	uint16_t LastHit() const { return lastHit; }
+
+public: // Devices
+	void MapDevice(uint8_t firstPage, uint8_t lastPage, Device* device);
+	void UnmapDevice(uint8_t firstPage, uint8_t lastPage);
+
 public: // Read and Write methods
-	void write(uint16_t addr, uint8_t data);
+	void    write(uint16_t addr, uint8_t data);
 	uint8_t read(uint16_t addr);
-};
\ No newline at end of file
+
+	// Read an opcode, which is where breakpoints are checked
+	uint8_t fetch(uint16_t addr);
+
+	// Read without side effects, for debugging tools. Device pages and unmapped addresses read 0
+	uint8_t Peek(uint16_t addr) const;
+
+	// Write without side effects, for debugging tools. ROM can be patched unless an image is mapped
+	// over it. Returns false for device pages and unmapped addresses
+	bool    Poke(uint16_t addr, uint8_t data);
+};
+
+inline void Bus::write(uint16_t addr, uint8_t data) {
+	uint8_t* page = writePages[addr >> 8];
+	if (page)
+		page[addr & 0xFF] = data;
+	else
+		SlowWrite(addr, data);
+}
+
+inline uint8_t Bus::read(uint16_t addr) {
+	const uint8_t* page = readPages[addr >> 8];
+	if (page)
+		return page[addr & 0xFF];
+	return SlowRead(addr);
+}
+
+inline uint8_t Bus::fetch(uint16_t addr) {
+	const uint8_t* page = readPages[addr >> 8];
+	if (page)
+		return page[addr & 0xFF];
+	return SlowFetch(addr);
+}
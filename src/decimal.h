@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Decimal mode ADC and SBC for the NMOS 6502, split into nibble tables built at compile time
+//    Each table is indexed by (carry << 8) | (a_nibble << 4) | m_nibble, so a decimal add or
+//    subtract costs two lookups. Results match the NMOS part for valid and invalid BCD operands:
+//    ADC takes Z from the binary sum and N and V from the sum before the high nibble is adjusted,
+//    while SBC sets every flag as the binary subtraction does and only the accumulator differs.
+using DecimalTable = std::array<uint16_t, 512>;
+
+static constexpr uint16_t DECIMAL_CARRY = 0x10; // Carry (ADC) or borrow (SBC) into the high nibble
+static constexpr uint8_t  DECIMAL_FLAG_C = (1 << 0);
+static constexpr uint8_t  DECIMAL_FLAG_V = (1 << 6);
+static constexpr uint8_t  DECIMAL_FLAG_N = (1 << 7);
+
+// ADC low nibble: adjusted result nibble, plus DECIMAL_CARRY
+constexpr DecimalTable construct_adc_low_table() {
+	DecimalTable table{};
+	for (int carry = 0; carry < 2; carry++)
+		for (int a = 0; a < 16; a++)
+			for (int m = 0; m < 16; m++) {
+				int sum = a + m + carry;
+				if (sum >= 0x0A)
+					sum = ((sum + 0x06) & 0x0F) | DECIMAL_CARRY;
+				table[(carry << 8) | (a << 4) | m] = static_cast<uint16_t>(sum);
+			}
+	return table;
+}
+
+// ADC high nibble: adjusted result nibble in bits 4-7, with the N, V and C flags in the high byte
+constexpr DecimalTable construct_adc_high_table() {
+	DecimalTable table{};
+	for (int carry = 0; carry < 2; carry++)
+		for (int a = 0; a < 16; a++)
+			for (int m = 0; m < 16; m++) {
+				int sum = a + m + carry;
+				int signedSum = (a >= 8 ? a - 16 : a) + (m >= 8 ? m - 16 : m) + carry;
+
+				uint8_t flags = 0;
+				if (sum & 0x08)
+					flags |= DECIMAL_FLAG_N;
+				if (signedSum < -8 || signedSum > 7)
+					flags |= DECIMAL_FLAG_V;
+				if (sum >= 0x0A)
+					sum += 0x06;
+				if (sum >= 0x10)
+					flags |= DECIMAL_FLAG_C;
+				table[(carry << 8) | (a << 4) | m] = static_cast<uint16_t>((flags << 8) | ((sum & 0x0F) << 4));
+			}
+	return table;
+}
+
+// SBC low nibble, indexed by the incoming borrow: adjusted result nibble, plus DECIMAL_CARRY when
+// borrowing from the high nibble
+constexpr DecimalTable construct_sbc_low_table() {
+	DecimalTable table{};
+	for (int borrow = 0; borrow < 2; borrow++)
+		for (int a = 0; a < 16; a++)
+			for (int m = 0; m < 16; m++) {
+				int difference = a - m - borrow;
+				uint16_t entry = difference & 0x0F;
+				if (difference < 0)
+					entry = ((difference - 0x06) & 0x0F) | DECIMAL_CARRY;
+				table[(borrow << 8) | (a << 4) | m] = entry;
+			}
+	return table;
+}
+
+// SBC high nibble, indexed by the borrow from the low nibble: adjusted result nibble in bits 4-7
+constexpr DecimalTable construct_sbc_high_table() {
+	DecimalTable table{};
+	for (int borrow = 0; borrow < 2; borrow++)
+		for (int a = 0; a < 16; a++)
+			for (int m = 0; m < 16; m++) {
+				int difference = a - m - borrow;
+				if (difference < 0)
+					difference -= 0x06;
+				table[(borrow << 8) | (a << 4) | m] = static_cast<uint16_t>((difference & 0x0F) << 4);
+			}
+	return table;
+}
+
+static constexpr DecimalTable adc_low_table = construct_adc_low_table();
+static constexpr DecimalTable adc_high_table = construct_adc_high_table();
+static constexpr DecimalTable sbc_low_table = construct_sbc_low_table();
+static constexpr DecimalTable sbc_high_table = construct_sbc_high_table();
+
+static_assert(adc_low_table[(1 << 8) | (0x9 << 4) | 0x9] == (DECIMAL_CARRY | 0x9), "9 + 9 + 1 = 19");
+static_assert(adc_high_table[(1 << 8) | (0x9 << 4) | 0x0] == ((DECIMAL_FLAG_C | DECIMAL_FLAG_N) << 8), "90 + 10 = 100");
+static_assert(sbc_low_table[(0 << 8) | (0x0 << 4) | 0x1] == (DECIMAL_CARRY | 0x9), "10 - 1 = 09");
+static_assert(sbc_high_table[(1 << 8) | (0x0 << 4) | 0x0] == (0x9 << 4), "00 - 01 = 99");
@@ -0,0 +1,436 @@
+#pragma once
+
+#include <array>
+#include "instructions.h"
+
+using OperationTable = array<Operation, 256>;
+
+// Sentinel entry for opcodes that do not decode to a legal instruction
+static constexpr Operation INVALID_OPERATION = { Instruction::INVALID, UNKNOWN };
+
+// Build the opcode decode table at compile time
+//    Each opcode byte indexes its Operation directly, replacing the bimap lookup on the execution
+//    path. Unassigned opcodes decode to INVALID_OPERATION.
+constexpr OperationTable construct_decode_table() {
+	OperationTable table{};
+	table.fill(INVALID_OPERATION);
+
+	// Load/Store Operations
+	    // LDA
+	table[INS_LDA_IM] = { Instruction::LDA, IMMEDIATE };
+	table[INS_LDA_ZP] = { Instruction::LDA, ZERO_PAGE };
+	table[INS_LDA_ZPX] = { Instruction::LDA, X_ZERO_PAGE };
+	table[INS_LDA_ABS] = { Instruction::LDA, ABSOLUTE };
+	table[INS_LDA_ABSX] = { Instruction::LDA, X_ABSOLUTE };
+	table[INS_LDA_ABSY] = { Instruction::LDA, Y_ABSOLUTE };
+	table[INS_LDA_INDX] = { Instruction::LDA, X_INDEX_ZP_INDIRECT };
+	table[INS_LDA_INDY] = { Instruction::LDA, ZP_INDIRECT_Y_INDEX };
+
+	    // LDX
+	table[INS_LDX_IM] = { Instruction::LDX, IMMEDIATE };
+	table[INS_LDX_ZP] = { Instruction::LDX, ZERO_PAGE };
+	table[INS_LDX_ZPY] = { Instruction::LDX, Y_ZERO_PAGE };
+	table[INS_LDX_ABS] = { Instruction::LDX, ABSOLUTE };
+	table[INS_LDX_ABSY] = { Instruction::LDX, Y_ABSOLUTE };
+
+	    // LDY
+	table[INS_LDY_IM] = { Instruction::LDY, IMMEDIATE };
+	table[INS_LDY_ZP] = { Instruction::LDY, ZERO_PAGE };
+	table[INS_LDY_ZPX] = { Instruction::LDY, X_ZERO_PAGE };
+	table[INS_LDY_ABS] = { Instruction::LDY, ABSOLUTE };
+	table[INS_LDY_ABSX] = { Instruction::LDY, X_ABSOLUTE };
+
+	    // STA
+	table[INS_STA_ZP] = { Instruction::STA, ZERO_PAGE };
+	table[INS_STA_ZPX] = { Instruction::STA, X_ZERO_PAGE };
+	table[INS_STA_ABS] = { Instruction::STA, ABSOLUTE };
+	table[INS_STA_ABSX] = { Instruction::STA, X_ABSOLUTE };
+	table[INS_STA_ABSY] = { Instruction::STA, Y_ABSOLUTE };
+	table[INS_STA_INDX] = { Instruction::STA, X_INDEX_ZP_INDIRECT };
+	table[INS_STA_INDY] = { Instruction::STA, ZP_INDIRECT_Y_INDEX };
+
+	    // STX
+	table[INS_STX_ZP] = { Instruction::STX, ZERO_PAGE };
+	table[INS_STX_ZPY] = { Instruction::STX, Y_ZERO_PAGE };
+	table[INS_STX_ABS] = { Instruction::STX, ABSOLUTE };
+
+	    // STY
+	table[INS_STY_ZP] = { Instruction::STY, ZERO_PAGE };
+	table[INS_STY_ZPX] = { Instruction::STY, X_ZERO_PAGE };
+	table[INS_STY_ABS] = { Instruction::STY, ABSOLUTE };
+
+	// Register Transfers
+	    // TAX
+	table[INS_TAX] = { Instruction::TAX, IMPLIED };
+
+	    // TAY
+	table[INS_TAY] = { Instruction::TAY, IMPLIED };
+
+	    // TXA
+	table[INS_TXA] = { Instruction::TXA, IMPLIED };
+
+	    // TYA
+	table[INS_TYA] = { Instruction::TYA, IMPLIED };
+
+	// Stack Operations
+	    // TSX
+	table[INS_TSX] = { Instruction::TSX, IMPLIED };
+
+	    // TXS
+	table[INS_TXS] = { Instruction::TXS, IMPLIED };
+
+	    // PHA
+	table[INS_PHA] = { Instruction::PHA, IMPLIED };
+
+	    // PHP
+	table[INS_PHP] = { Instruction::PHP, IMPLIED };
+
+	    // PLA
+	table[INS_PLA] = { Instruction::PLA, IMPLIED };
+
+	    // PLP
+	table[INS_PLP] = { Instruction::PLP, IMPLIED };
+
+	// Logical
+	    // AND
+	table[INS_AND_IM] = { Instruction::AND, IMMEDIATE };
+	table[INS_AND_ZP] = { Instruction::AND, ZERO_PAGE };
+	table[INS_AND_ZPX] = { Instruction::AND, X_ZERO_PAGE };
+	table[INS_AND_ABS] = { Instruction::AND, ABSOLUTE };
+	table[INS_AND_ABSX] = { Instruction::AND, X_ABSOLUTE };
+	table[INS_AND_ABSY] = { Instruction::AND, Y_ABSOLUTE };
+	table[INS_AND_INDX] = { Instruction::AND, X_INDEX_ZP_INDIRECT };
+	table[INS_AND_INDY] = { Instruction::AND, ZP_INDIRECT_Y_INDEX };
+
+	    // EOR
+	table[INS_EOR_IM] = { Instruction::EOR, IMMEDIATE };
+	table[INS_EOR_ZP] = { Instruction::EOR, ZERO_PAGE };
+	table[INS_EOR_ZPX] = { Instruction::EOR, X_ZERO_PAGE };
+	table[INS_EOR_ABS] = { Instruction::EOR, ABSOLUTE };
+	table[INS_EOR_ABSX] = { Instruction::EOR, X_ABSOLUTE };
+	table[INS_EOR_ABSY] = { Instruction::EOR, Y_ABSOLUTE };
+	table[INS_EOR_INDX] = { Instruction::EOR, X_INDEX_ZP_INDIRECT };
+	table[INS_EOR_INDY] = { Instruction::EOR, ZP_INDIRECT_Y_INDEX };
+
+	    // ORA
+	table[INS_ORA_IM] = { Instruction::ORA, IMMEDIATE };
+	table[INS_ORA_ZP] = { Instruction::ORA, ZERO_PAGE };
+	table[INS_ORA_ZPX] = { Instruction::ORA, X_ZERO_PAGE };
+	table[INS_ORA_ABS] = { Instruction::ORA, ABSOLUTE };
+	table[INS_ORA_ABSX] = { Instruction::ORA, X_ABSOLUTE };
+	table[INS_ORA_ABSY] = { Instruction::ORA, Y_ABSOLUTE };
+	table[INS_ORA_INDX] = { Instruction::ORA, X_INDEX_ZP_INDIRECT };
+	table[INS_ORA_INDY] = { Instruction::ORA, ZP_INDIRECT_Y_INDEX };
+
+	    // BIT
+	table[INS_BIT_ZP] = { Instruction::BIT, ZERO_PAGE };
+	table[INS_BIT_ABS] = { Instruction::BIT, ABSOLUTE };
+
+	// Arithmetic
+	    // ADC
+	table[INS_ADC_IM] = { Instruction::ADC, IMMEDIATE };
+	table[INS_ADC_ZP] = { Instruction::ADC, ZERO_PAGE };
+	table[INS_ADC_ZPX] = { Instruction::ADC, X_ZERO_PAGE };
+	table[INS_ADC_ABS] = { Instruction::ADC, ABSOLUTE };
+	table[INS_ADC_ABSX] = { Instruction::ADC, X_ABSOLUTE };
+	table[INS_ADC_ABSY] = { Instruction::ADC, Y_ABSOLUTE };
+	table[INS_ADC_INDX] = { Instruction::ADC, X_INDEX_ZP_INDIRECT };
+	table[INS_ADC_INDY] = { Instruction::ADC, ZP_INDIRECT_Y_INDEX };
+
+	    // SBC
+	table[INS_SBC_IM] = { Instruction::SBC, IMMEDIATE };
+	table[INS_SBC_ZP] = { Instruction::SBC, ZERO_PAGE };
+	table[INS_SBC_ZPX] = { Instruction::SBC, X_ZERO_PAGE };
+	table[INS_SBC_ABS] = { Instruction::SBC, ABSOLUTE };
+	table[INS_SBC_ABSX] = { Instruction::SBC, X_ABSOLUTE };
+	table[INS_SBC_ABSY] = { Instruction::SBC, Y_ABSOLUTE };
+	table[INS_SBC_INDX] = { Instruction::SBC, X_INDEX_ZP_INDIRECT };
+	table[INS_SBC_INDY] = { Instruction::SBC, ZP_INDIRECT_Y_INDEX };
+
+	    // CMP
+	table[INS_CMP_IM] = { Instruction::CMP, IMMEDIATE };
+	table[INS_CMP_ZP] = { Instruction::CMP, ZERO_PAGE };
+	table[INS_CMP_ZPX] = { Instruction::CMP, X_ZERO_PAGE };
+	table[INS_CMP_ABS] = { Instruction::CMP, ABSOLUTE };
+	table[INS_CMP_ABSX] = { Instruction::CMP, X_ABSOLUTE };
+	table[INS_CMP_ABSY] = { Instruction::CMP, Y_ABSOLUTE };
+	table[INS_CMP_INDX] = { Instruction::CMP, X_INDEX_ZP_INDIRECT };
+	table[INS_CMP_INDY] = { Instruction::CMP, ZP_INDIRECT_Y_INDEX };
+
+	    // CPX
+	table[INS_CPX_IM] = { Instruction::CPX, IMMEDIATE };
+	table[INS_CPX_ZP] = { Instruction::CPX, ZERO_PAGE };
+	table[INS_CPX_ABS] = { Instruction::CPX, ABSOLUTE };
+
+	    // CPY
+	table[INS_CPY_IM] = { Instruction::CPY, IMMEDIATE };
+	table[INS_CPY_ZP] = { Instruction::CPY, ZERO_PAGE };
+	table[INS_CPY_ABS] = { Instruction::CPY, ABSOLUTE };
+
+	// Increments & Decrements
+	    // INC
+	table[INS_INC_ZP] = { Instruction::INC, ZERO_PAGE };
+	table[INS_INC_ZPX] = { Instruction::INC, X_ZERO_PAGE };
+	table[INS_INC_ABS] = { Instruction::INC, ABSOLUTE };
+	table[INS_INC_ABSX] = { Instruction::INC, X_ABSOLUTE };
+
+	    // INX
+	table[INS_INX] = { Instruction::INX, IMPLIED };
+
+	    // INY
+	table[INS_INY] = { Instruction::INY, IMPLIED };
+
+	    // DEC
+	table[INS_DEC_ZP] = { Instruction::DEC, ZERO_PAGE };
+	table[INS_DEC_ZPX] = { Instruction::DEC, X_ZERO_PAGE };
+	table[INS_DEC_ABS] = { Instruction::DEC, ABSOLUTE };
+	table[INS_DEC_ABSX] = { Instruction::DEC, X_ABSOLUTE };
+
+	    // DEX
+	table[INS_DEX] = { Instruction::DEX, IMPLIED };
+
+	    // DEY
+	table[INS_DEY] = { Instruction::DEY, IMPLIED };
+
+	// Shifts
+	    // ASL
+	table[INS_ASL_ACC] = { Instruction::ASL, ACCUMULATOR };
+	table[INS_ASL_ZP] = { Instruction::ASL, ZERO_PAGE };
+	table[INS_ASL_ZPX] = { Instruction::ASL, X_ZERO_PAGE };
+	table[INS_ASL_ABS] = { Instruction::ASL, ABSOLUTE };
+	table[INS_ASL_ABSX] = { Instruction::ASL, X_ABSOLUTE };
+
+	    // LSR
+	table[INS_LSR_ACC] = { Instruction::LSR, ACCUMULATOR };
+	table[INS_LSR_ZP] = { Instruction::LSR, ZERO_PAGE };
+	table[INS_LSR_ZPX] = { Instruction::LSR, X_ZERO_PAGE };
+	table[INS_LSR_ABS] = { Instruction::LSR, ABSOLUTE };
+	table[INS_LSR_ABSX] = { Instruction::LSR, X_ABSOLUTE };
+
+	    // ROL
+	table[INS_ROL_ACC] = { Instruction::ROL, ACCUMULATOR };
+	table[INS_ROL_ZP] = { Instruction::ROL, ZERO_PAGE };
+	table[INS_ROL_ZPX] = { Instruction::ROL, X_ZERO_PAGE };
+	table[INS_ROL_ABS] = { Instruction::ROL, ABSOLUTE };
+	table[INS_ROL_ABSX] = { Instruction::ROL, X_ABSOLUTE };
+
+	    // ROR
+	table[INS_ROR_ACC] = { Instruction::ROR, ACCUMULATOR };
+	table[INS_ROR_ZP] = { Instruction::ROR, ZERO_PAGE };
+	table[INS_ROR_ZPX] = { Instruction::ROR, X_ZERO_PAGE };
+	table[INS_ROR_ABS] = { Instruction::ROR, ABSOLUTE };
+	table[INS_ROR_ABSX] = { Instruction::ROR, X_ABSOLUTE };
+
+	// Jumps & Calls
+	    // JMP
+	table[INS_JMP_ABS] = { Instruction::JMP, ABSOLUTE };
+	table[INS_JMP_IND] = { Instruction::JMP, ABS_INDIRECT };
+
+	    // JSR
+	table[INS_JSR_ABS] = { Instruction::JSR, ABSOLUTE };
+
+	    // RTS
+	table[INS_RTS] = { Instruction::RTS, IMPLIED };
+
+	// Branches
+	table[INS_BCC] = { Instruction::BCC, RELATIVE };
+	table[INS_BCS] = { Instruction::BCS, RELATIVE };
+	table[INS_BEQ] = { Instruction::BEQ, RELATIVE };
+	table[INS_BMI] = { Instruction::BMI, RELATIVE };
+	table[INS_BNE] = { Instruction::BNE, RELATIVE };
+	table[INS_BPL] = { Instruction::BPL, RELATIVE };
+	table[INS_BVC] = { Instruction::BVC, RELATIVE };
+	table[INS_BVS] = { Instruction::BVS, RELATIVE };
+
+	// Status Flag Changes
+	table[INS_CLC] = { Instruction::CLC, IMPLIED };
+	table[INS_CLD] = { Instruction::CLD, IMPLIED };
+	table[INS_CLI] = { Instruction::CLI, IMPLIED };
+	table[INS_CLV] = { Instruction::CLV, IMPLIED };
+	table[INS_SEC] = { Instruction::SEC, IMPLIED };
+	table[INS_SED] = { Instruction::SED, IMPLIED };
+	table[INS_SEI] = { Instruction::SEI, IMPLIED };
+
+	// System Functions
+	table[INS_BRK] = { Instruction::BRK, IMPLIED };
+	table[INS_NOP] = { Instruction::NOP, IMPLIED };
+	table[INS_RTI] = { Instruction::RTI, IMPLIED };
+
+	return table;
+}
+
+inline constexpr OperationTable decode_table = construct_decode_table();
+
+// Number of legal opcodes in the decode table
+constexpr int count_legal_opcodes() {
+	int count = 0;
+	for (const Operation& operation : decode_table)
+		if (operation.instruction != Instruction::INVALID)
+			count++;
+	return count;
+}
+
+static_assert(count_legal_opcodes() == 151, "decode table must cover every legal opcode exactly once");
+
+// Build the decode table with the stable undocumented NMOS opcodes added
+//    The unstable opcodes (XAA, AHX, TAS, SHX, SHY, LAS, LAX #imm) and the JAM opcodes that halt
+//    the processor still decode to INVALID_OPERATION.
+constexpr OperationTable construct_nmos_decode_table() {
+	OperationTable table = decode_table;
+
+	// Undocumented NMOS Operations (only decoded when enabled per instance)
+	    // Read-modify-write combinations
+	    // SLO
+	table[INS_SLO_ZP] = { Instruction::SLO, ZERO_PAGE };
+	table[INS_SLO_ZPX] = { Instruction::SLO, X_ZERO_PAGE };
+	table[INS_SLO_ABS] = { Instruction::SLO, ABSOLUTE };
+	table[INS_SLO_ABSX] = { Instruction::SLO, X_ABSOLUTE };
+	table[INS_SLO_ABSY] = { Instruction::SLO, Y_ABSOLUTE };
+	table[INS_SLO_INDX] = { Instruction::SLO, X_INDEX_ZP_INDIRECT };
+	table[INS_SLO_INDY] = { Instruction::SLO, ZP_INDIRECT_Y_INDEX };
+
+	    // RLA
+	table[INS_RLA_ZP] = { Instruction::RLA, ZERO_PAGE };
+	table[INS_RLA_ZPX] = { Instruction::RLA, X_ZERO_PAGE };
+	table[INS_RLA_ABS] = { Instruction::RLA, ABSOLUTE };
+	table[INS_RLA_ABSX] = { Instruction::RLA, X_ABSOLUTE };
+	table[INS_RLA_ABSY] = { Instruction::RLA, Y_ABSOLUTE };
+	table[INS_RLA_INDX] = { Instruction::RLA, X_INDEX_ZP_INDIRECT };
+	table[INS_RLA_INDY] = { Instruction::RLA, ZP_INDIRECT_Y_INDEX };
+
+	    // SRE
+	table[INS_SRE_ZP] = { Instruction::SRE, ZERO_PAGE };
+	table[INS_SRE_ZPX] = { Instruction::SRE, X_ZERO_PAGE };
+	table[INS_SRE_ABS] = { Instruction::SRE, ABSOLUTE };
+	table[INS_SRE_ABSX] = { Instruction::SRE, X_ABSOLUTE };
+	table[INS_SRE_ABSY] = { Instruction::SRE, Y_ABSOLUTE };
+	table[INS_SRE_INDX] = { Instruction::SRE, X_INDEX_ZP_INDIRECT };
+	table[INS_SRE_INDY] = { Instruction::SRE, ZP_INDIRECT_Y_INDEX };
+
+	    // RRA
+	table[INS_RRA_ZP] = { Instruction::RRA, ZERO_PAGE };
+	table[INS_RRA_ZPX] = { Instruction::RRA, X_ZERO_PAGE };
+	table[INS_RRA_ABS] = { Instruction::RRA, ABSOLUTE };
+	table[INS_RRA_ABSX] = { Instruction::RRA, X_ABSOLUTE };
+	table[INS_RRA_ABSY] = { Instruction::RRA, Y_ABSOLUTE };
+	table[INS_RRA_INDX] = { Instruction::RRA, X_INDEX_ZP_INDIRECT };
+	table[INS_RRA_INDY] = { Instruction::RRA, ZP_INDIRECT_Y_INDEX };
+
+	    // DCP
+	table[INS_DCP_ZP] = { Instruction::DCP, ZERO_PAGE };
+	table[INS_DCP_ZPX] = { Instruction::DCP, X_ZERO_PAGE };
+	table[INS_DCP_ABS] = { Instruction::DCP, ABSOLUTE };
+	table[INS_DCP_ABSX] = { Instruction::DCP, X_ABSOLUTE };
+	table[INS_DCP_ABSY] = { Instruction::DCP, Y_ABSOLUTE };
+	table[INS_DCP_INDX] = { Instruction::DCP, X_INDEX_ZP_INDIRECT };
+	table[INS_DCP_INDY] = { Instruction::DCP, ZP_INDIRECT_Y_INDEX };
+
+	    // ISC
+	table[INS_ISC_ZP] = { Instruction::ISC, ZERO_PAGE };
+	table[INS_ISC_ZPX] = { Instruction::ISC, X_ZERO_PAGE };
+	table[INS_ISC_ABS] = { Instruction::ISC, ABSOLUTE };
+	table[INS_ISC_ABSX] = { Instruction::ISC, X_ABSOLUTE };
+	table[INS_ISC_ABSY] = { Instruction::ISC, Y_ABSOLUTE };
+	table[INS_ISC_INDX] = { Instruction::ISC, X_INDEX_ZP_INDIRECT };
+	table[INS_ISC_INDY] = { Instruction::ISC, ZP_INDIRECT_Y_INDEX };
+
+	    // Combined loads and stores
+	    // LAX
+	table[INS_LAX_ZP] = { Instruction::LAX, ZERO_PAGE };
+	table[INS_LAX_ZPY] = { Instruction::LAX, Y_ZERO_PAGE };
+	table[INS_LAX_ABS] = { Instruction::LAX, ABSOLUTE };
+	table[INS_LAX_ABSY] = { Instruction::LAX, Y_ABSOLUTE };
+	table[INS_LAX_INDX] = { Instruction::LAX, X_INDEX_ZP_INDIRECT };
+	table[INS_LAX_INDY] = { Instruction::LAX, ZP_INDIRECT_Y_INDEX };
+
+	    // SAX
+	table[INS_SAX_ZP] = { Instruction::SAX, ZERO_PAGE };
+	table[INS_SAX_ZPY] = { Instruction::SAX, Y_ZERO_PAGE };
+	table[INS_SAX_ABS] = { Instruction::SAX, ABSOLUTE };
+	table[INS_SAX_INDX] = { Instruction::SAX, X_INDEX_ZP_INDIRECT };
+
+	    // Immediate combinations
+	table[INS_ANC_IM_0B] = { Instruction::ANC, IMMEDIATE };
+	table[INS_ANC_IM_2B] = { Instruction::ANC, IMMEDIATE };
+	table[INS_ALR_IM] = { Instruction::ALR, IMMEDIATE };
+	table[INS_ARR_IM] = { Instruction::ARR, IMMEDIATE };
+	table[INS_SBX_IM] = { Instruction::SBX, IMMEDIATE };
+	table[INS_SBC_IM_EB] = { Instruction::SBC, IMMEDIATE };
+
+	    // NOPs
+	table[INS_NOP_1A] = { Instruction::NOP, IMPLIED };
+	table[INS_NOP_3A] = { Instruction::NOP, IMPLIED };
+	table[INS_NOP_5A] = { Instruction::NOP, IMPLIED };
+	table[INS_NOP_7A] = { Instruction::NOP, IMPLIED };
+	table[INS_NOP_DA] = { Instruction::NOP, IMPLIED };
+	table[INS_NOP_FA] = { Instruction::NOP, IMPLIED };
+	table[INS_NOP_IM_80] = { Instruction::NOP, IMMEDIATE };
+	table[INS_NOP_IM_82] = { Instruction::NOP, IMMEDIATE };
+	table[INS_NOP_IM_89] = { Instruction::NOP, IMMEDIATE };
+	table[INS_NOP_IM_C2] = { Instruction::NOP, IMMEDIATE };
+	table[INS_NOP_IM_E2] = { Instruction::NOP, IMMEDIATE };
+	table[INS_NOP_ZP_04] = { Instruction::NOP, ZERO_PAGE };
+	table[INS_NOP_ZP_44] = { Instruction::NOP, ZERO_PAGE };
+	table[INS_NOP_ZP_64] = { Instruction::NOP, ZERO_PAGE };
+	table[INS_NOP_ZPX_14] = { Instruction::NOP, X_ZERO_PAGE };
+	table[INS_NOP_ZPX_34] = { Instruction::NOP, X_ZERO_PAGE };
+	table[INS_NOP_ZPX_54] = { Instruction::NOP, X_ZERO_PAGE };
+	table[INS_NOP_ZPX_74] = { Instruction::NOP, X_ZERO_PAGE };
+	table[INS_NOP_ZPX_D4] = { Instruction::NOP, X_ZERO_PAGE };
+	table[INS_NOP_ZPX_F4] = { Instruction::NOP, X_ZERO_PAGE };
+	table[INS_NOP_ABS_0C] = { Instruction::NOP, ABSOLUTE };
+	table[INS_NOP_ABSX_1C] = { Instruction::NOP, X_ABSOLUTE };
+	table[INS_NOP_ABSX_3C] = { Instruction::NOP, X_ABSOLUTE };
+	table[INS_NOP_ABSX_5C] = { Instruction::NOP, X_ABSOLUTE };
+	table[INS_NOP_ABSX_7C] = { Instruction::NOP, X_ABSOLUTE };
+	table[INS_NOP_ABSX_DC] = { Instruction::NOP, X_ABSOLUTE };
+	table[INS_NOP_ABSX_FC] = { Instruction::NOP, X_ABSOLUTE };
+
+	return table;
+}
+
+inline constexpr OperationTable nmos_decode_table = construct_nmos_decode_table();
+
+constexpr int count_nmos_opcodes() {
+	int count = 0;
+	for (const Operation& operation : nmos_decode_table)
+		if (operation.instruction != Instruction::INVALID)
+			count++;
+	return count;
+}
+
+static_assert(count_nmos_opcodes() == 151 + 85, "undocumented opcodes must not overlap the legal ones");
+
+// Number of bytes an instruction occupies, including the opcode
+constexpr int operation_length(AddressMode mode) {
+	switch (mode) {
+	case ABSOLUTE:
+	case ABS_INDIRECT:
+	case X_ABSOLUTE:
+	case Y_ABSOLUTE:
+		return 3;
+	case RELATIVE:
+	case IMMEDIATE:
+	case ZERO_PAGE:
+	case X_ZERO_PAGE:
+	case Y_ZERO_PAGE:
+	case X_INDEX_ZP_INDIRECT:
+	case ZP_INDIRECT_Y_INDEX:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+// Whether an instruction may continue somewhere other than the next instruction
+constexpr bool ends_block(Instruction instruction) {
+	switch (instruction) {
+	case Instruction::JMP: case Instruction::JSR: case Instruction::RTS: case Instruction::RTI:
+	case Instruction::BRK: case Instruction::BCC: case Instruction::BCS: case Instruction::BEQ:
+	case Instruction::BMI: case Instruction::BNE: case Instruction::BPL: case Instruction::BVC:
+	case Instruction::BVS: case Instruction::INVALID:
+		return true;
+	default:
+		return false;
+	}
+}
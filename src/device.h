@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+// Memory mapped I/O device
+//    Devices are attached to whole 256-byte pages of the bus. Accesses to those pages bypass the
+//    fast memory path and are forwarded here with the full 16-bit address.
+class Device
+{
+public:
+	virtual ~Device() = default;
+
+	virtual uint8_t read(uint16_t addr) = 0;
+	virtual void    write(uint16_t addr, uint8_t data) = 0;
+};
@@ -1,4 +1,8 @@
 // CPU Error codes
 #define E_INV    -1	     // Invalid opcode
 #define E_BADR   -2      // Read from invalid memory
-#define E_BADW   -3      // Write to invalid memory
\ No newline at end of file
+#define E_BADW   -3      // Write to invalid memory
+#define E_DESYNC -4      // Replay diverged from its input log
+#define E_BREAK  -5      // Stopped at a breakpoint, before executing it
+#define E_WATCHR -6      // Stopped after a read from a watched address
+#define E_WATCHW -7      // Stopped after a write to a watched address
\ No newline at end of file
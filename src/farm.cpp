@@ -0,0 +1,181 @@
+#include "farm.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+// Index of the worker running on this thread, used so that jobs submitted from inside a callback
+// land on the submitting worker's own queue
+static thread_local int currentWorker = -1;
+
+SystemFarm::SystemFarm(unsigned workers) {
+	if (workers == 0)
+		workers = 1;
+
+	for (unsigned i = 0; i < workers; i++)
+		queues.push_back(std::make_unique<Queue>());
+	for (unsigned i = 0; i < workers; i++)
+		threads.emplace_back(&SystemFarm::WorkerLoop, this, i);
+}
+
+SystemFarm::~SystemFarm() {
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+std::future<FarmResult> SystemFarm::Submit(FarmJob job) {
+	auto promise = std::make_shared<std::promise<FarmResult>>();
+	std::future<FarmResult> result = promise->get_future();
+	Push([job = std::move(job), promise](Bus& system) {
+		try {
+			promise->set_value(Execute(system, job));
+		}
+		catch (...) {
+			promise->set_exception(std::current_exception());
+		}
+	});
+	return result;
+}
+
+std::future<void> SystemFarm::Submit(FarmJob job, Callback callback) {
+	auto promise = std::make_shared<std::promise<void>>();
+	std::future<void> result = promise->get_future();
+	Push([job = std::move(job), callback = std::move(callback), promise](Bus& system) {
+		try {
+			callback(Execute(system, job));
+			promise->set_value();
+		}
+		catch (...) {
+			promise->set_exception(std::current_exception());
+		}
+	});
+	return result;
+}
+
+void SystemFarm::Wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return outstanding == 0; });
+}
+
+void SystemFarm::Push(Task task) {
+	unsigned target = (currentWorker >= 0) ? currentWorker : next++ % queues.size();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		outstanding++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(queues[target]->mutex);
+		queues[target]->tasks.push_back(std::move(task));
+	}
+	{
+		// Publish under the sleep mutex so a worker checking for work cannot miss the wake-up
+		std::lock_guard<std::mutex> lock(mutex);
+		queued++;
+	}
+	wake.notify_one();
+}
+
+// Take a task from this worker's own queue, or steal one from another worker
+bool SystemFarm::Pop(unsigned worker, Task& task) {
+	{
+		Queue& own = *queues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			queued--;
+			return true;
+		}
+	}
+	for (size_t i = 1; i < queues.size(); i++) {
+		Queue& victim = *queues[(worker + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void SystemFarm::WorkerLoop(unsigned worker) {
+	currentWorker = static_cast<int>(worker);
+	auto system = std::make_unique<Bus>();
+
+	for (;;) {
+		Task task;
+		if (!Pop(worker, task)) {
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || queued > 0; });
+			if (stopping && queued == 0)
+				return;
+			continue;
+		}
+
+		task(*system);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--outstanding == 0)
+			idle.notify_all();
+	}
+}
+
+// Load a job's memory and registers into a worker's system
+void SystemFarm::Load(Bus& system, const FarmJob& job) {
+	std::memset(system.ram, 0xFF, sizeof(system.ram));
+	std::copy_n(job.ram.data(), std::min(job.ram.size(), sizeof(system.ram)), system.ram);
+	if (job.image) {
+		system.MapRom(*job.image);
+	}
+	else {
+		std::memset(system.rom, 0x00, sizeof(system.rom));
+		std::copy_n(job.rom.data(), std::min(job.rom.size(), sizeof(system.rom)), system.rom);
+
+		// The previous job's code is gone, so are any blocks decoded from it
+		system.cpu.FlushBlockCache();
+	}
+
+	system.ResetVectors();
+	system.cpu.status = 0;
+	system.cpu.PC = job.PC;
+	system.cpu.SP = job.SP;
+	system.cpu.A = job.A;
+	system.cpu.X = job.X;
+	system.cpu.Y = job.Y;
+	system.cpu.P = job.P;
+}
+
+// Prepare a worker's system for a job, run it and collect the final state
+FarmResult SystemFarm::Execute(Bus& system, const FarmJob& job) {
+	// Nothing but memory may carry over from the worker's previous job. A snapshot brings its own
+	// clock, lines and vectors but no events
+	system.cpu.ResetClockAndLines();
+	if (job.snapshot)
+		system.Restore(*job.snapshot);
+	else
+		Load(system, job);
+
+	FarmResult result;
+	result.exitCode = system.cpu.Run(job.cycles);
+	result.PC = system.cpu.PC;
+	result.SP = system.cpu.SP;
+	result.A = system.cpu.A;
+	result.X = system.cpu.X;
+	result.Y = system.cpu.Y;
+	result.P = system.cpu.P;
+	result.Cycles = system.cpu.Cycles;
+	if (job.captureRam)
+		result.ram.assign(system.ram, system.ram + sizeof(system.ram));
+
+	// The image belongs to the job and may be released once it finishes
+	if (job.image)
+		system.UnmapRom();
+	return result;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "bus.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A single emulation run to be executed by a SystemFarm
+struct FarmJob {
+	std::vector<uint8_t> rom; // Loaded at 0x8000, at most 16KB
+	std::shared_ptr<const RomImage> image; // Mapped at 0x8000 without copying, instead of rom
+	std::vector<uint8_t> ram; // Loaded at 0x0000, at most 32KB. Remaining RAM is filled with 0xFF
+
+	// Initial register state
+	uint16_t PC = 0x8000;
+	uint8_t  SP = 0xFF;
+	uint8_t  A = 0;
+	uint8_t  X = 0;
+	uint8_t  Y = 0;
+	uint8_t  P = 0;
+
+	// When set, the job starts from this snapshot and the fields above are ignored. Only the pages
+	// that differ from the worker's current memory are copied in
+	std::shared_ptr<const Snapshot> snapshot;
+
+	int32_t cycles = 0;       // Cycle budget handed to Run
+	bool    captureRam = false; // Copy the final RAM contents into the result
+};
+
+// Final state of a FarmJob
+struct FarmResult {
+	uint16_t PC;
+	uint8_t  SP;
+	uint8_t  A;
+	uint8_t  X;
+	uint8_t  Y;
+	uint8_t  P;
+	int32_t  Cycles;
+	int      exitCode; // Return value of Run: error code, excess cycles or 0
+	std::vector<uint8_t> ram; // Only filled when the job asked for it
+};
+
+// Pool of worker threads, each owning one emulator, that runs FarmJobs concurrently
+//    Every worker keeps its own job queue. Jobs submitted from outside the pool are spread over
+//    the queues round-robin; a worker pops from the back of its own queue and, once that is empty,
+//    steals from the front of the others. Each worker reuses a single Bus for all of its jobs,
+//    putting its clock, pending events, interrupt lines and vectors back to their power-on state
+//    before each one. An exception thrown by a job or its callback is delivered through the
+//    returned future instead of reaching the worker.
+class SystemFarm
+{
+public:
+	using Callback = std::function<void(const FarmResult&)>;
+
+	explicit SystemFarm(unsigned workers = std::thread::hardware_concurrency());
+	~SystemFarm();
+
+	SystemFarm(const SystemFarm&) = delete;
+	SystemFarm& operator=(const SystemFarm&) = delete;
+
+public:
+	std::future<FarmResult> Submit(FarmJob job);
+	// The future becomes ready once the callback has returned
+	std::future<void> Submit(FarmJob job, Callback callback);
+
+	// Block until every submitted job has finished
+	void Wait();
+
+	unsigned Workers() const { return static_cast<unsigned>(queues.size()); }
+
+private:
+	using Task = std::function<void(Bus&)>;
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;           // Guards sleeping, waking and completion
+	std::condition_variable wake; // Signalled when work arrives or the farm shuts down
+	std::condition_variable idle; // Signalled when the last outstanding job finishes
+	std::atomic<size_t> queued{ 0 };  // Tasks waiting in a queue
+	size_t outstanding = 0;           // Tasks submitted but not yet finished
+	std::atomic<unsigned> next{ 0 };  // Round-robin queue for the next submission
+	bool stopping = false;
+
+	void Push(Task task);
+	bool Pop(unsigned worker, Task& task);
+	void WorkerLoop(unsigned worker);
+
+	static void Load(Bus& system, const FarmJob& job);
+	static FarmResult Execute(Bus& system, const FarmJob& job);
+};
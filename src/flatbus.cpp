@@ -0,0 +1,16 @@
+#include "flatbus.h"
+
+FlatBus::FlatBus() {
+	cpu.ConnectBus(this);
+	for (auto& i : memory) i = 0xFF;
+
+	// Power on reset location (points to 0x8000, matching Bus)
+	memory[0xFFFC] = 0x00;
+	memory[0xFFFD] = 0x80;
+
+	cpu.Reset();
+}
+
+FlatBus::~FlatBus() {
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "MOS6502.h"
+#include <cstdint>
+
+// Flat 64KB memory bus
+//    Every address is plain RAM with no devices or invalid regions, so reads and writes compile to a
+//    single load or store inside the CPU core. Intended for batch workloads and benchmarks where the
+//    full memory map of Bus is not needed.
+class FlatBus
+{
+public:
+	FlatBus();
+	~FlatBus();
+
+	FlatBus(const FlatBus&) = delete;
+	FlatBus& operator=(const FlatBus&) = delete;
+
+public: // Components
+	MOS6502Core<FlatBus> cpu;
+	uint8_t memory[64 * 1024]; // 0x0000 - 0xFFFF
+
+public: // Read and Write methods
+	void    write(uint16_t addr, uint8_t data) { memory[addr] = data; }
+	uint8_t read(uint16_t addr) { return memory[addr]; }
+	uint8_t Peek(uint16_t addr) const { return memory[addr]; }
+};
@@ -0,0 +1,603 @@
+#include "gdbstub.h"
+#include "bus.h"
+#include "exitcodes.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Registers in the order of the 'g' packet and the register numbers of 'p' and 'P'
+enum Register { REG_A, REG_X, REG_Y, REG_P, REG_SP, REG_PC, REGISTERS };
+
+// Largest packet accepted from the debugger, in bytes
+static constexpr size_t PACKET_SIZE = 0x1000;
+
+// Longest range a watchpoint may cover: the whole address space
+static constexpr uint32_t MAX_WATCH_LENGTH = 0x10000;
+
+static const char TARGET_XML[] =
+	"<?xml version=\"1.0\"?>"
+	"<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+	"<target version=\"1.0\">"
+	"<feature name=\"org.mos6502.core\">"
+	"<reg name=\"a\" bitsize=\"8\" type=\"uint8\" regnum=\"0\"/>"
+	"<reg name=\"x\" bitsize=\"8\" type=\"uint8\"/>"
+	"<reg name=\"y\" bitsize=\"8\" type=\"uint8\"/>"
+	"<reg name=\"p\" bitsize=\"8\" type=\"uint8\"/>"
+	"<reg name=\"sp\" bitsize=\"8\" type=\"uint8\"/>"
+	"<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+	"</feature>"
+	"</target>";
+
+// Hex helpers. Values are written most significant digit first
+static std::string Hex(uint32_t value, int digits) {
+	static const char DIGITS[] = "0123456789abcdef";
+	std::string text(digits, '0');
+	for (int i = digits - 1; i >= 0; i--, value >>= 4)
+		text[i] = DIGITS[value & 0xF];
+	return text;
+}
+
+static int HexDigit(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+// Parse the two hex digits at pos as a byte, or return -1 if either is not a hex digit
+static int HexByte(const std::string& text, size_t pos) {
+	const int high = HexDigit(text[pos]);
+	const int low = HexDigit(text[pos + 1]);
+	return (high < 0 || low < 0) ? -1 : (high << 4) | low;
+}
+
+// Parse hex digits from pos up to the end of the text or the first other character
+static bool ParseHex(const std::string& text, size_t& pos, uint32_t& value) {
+	const size_t start = pos;
+	value = 0;
+	for (int digit; pos < text.size() && (digit = HexDigit(text[pos])) >= 0; pos++)
+		value = (value << 4) | digit;
+	return pos > start;
+}
+
+// Parse "addr,length" and return the position after it
+static bool ParseRange(const std::string& text, size_t& pos, uint32_t& addr, uint32_t& length) {
+	if (!ParseHex(text, pos, addr) || pos >= text.size() || text[pos++] != ',')
+		return false;
+	return ParseHex(text, pos, length);
+}
+
+GdbStub::GdbStub(Bus& system, int input, int output)
+	: system(system), input(input), output(output) {}
+
+int GdbStub::ListenUnix(const std::string& path) {
+	sockaddr_un address{};
+	if (path.empty() || path.size() >= sizeof(address.sun_path))
+		return -1;
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	// Replace a socket left behind by an earlier run, but nothing else
+	struct stat info;
+	if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+		unlink(path.c_str());
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0)
+		return -1;
+	if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0) {
+		close(listener);
+		return -1;
+	}
+
+	int connection;
+	do {
+		connection = accept(listener, nullptr, nullptr);
+	} while (connection < 0 && errno == EINTR);
+
+	close(listener);
+	unlink(path.c_str());
+	return connection;
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      DRIVING                                                                                      DRIVING      */
+/*----------------------------------------------------------------------------------------------------------------*/
+void GdbStub::Poll() {
+	char buffer[4096];
+	while (connected) {
+		pollfd ready = { input, POLLIN, 0 };
+		int events = poll(&ready, 1, 0);
+		if (events < 0 && errno == EINTR)
+			continue;
+		if (events <= 0)
+			return;
+
+		ssize_t length = read(input, buffer, sizeof(buffer));
+		if (length < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (length <= 0) {
+			Disconnect();
+			return;
+		}
+		Receive(buffer, static_cast<size_t>(length));
+	}
+}
+
+// Block until the debugger sends something. Returns false if the connection failed
+bool GdbStub::Wait() {
+	pollfd ready = { input, POLLIN, 0 };
+	int events;
+	do {
+		events = poll(&ready, 1, -1);
+	} while (events < 0 && errno == EINTR);
+	return events > 0;
+}
+
+int GdbStub::Run(int32_t cycles) {
+	Poll();
+	if (halted)
+		return 0;
+
+	int result = system.cpu.Run(cycles);
+	if (connected && system.cpu.status != 0)
+		Report(system.cpu.status);
+	return result;
+}
+
+void GdbStub::Serve(int32_t slice) {
+	while (connected) {
+		if (!halted) {
+			Run(slice);
+		}
+		else if (Wait()) {
+			Poll();
+		}
+		else {
+			Disconnect();
+		}
+	}
+}
+
+// The system carries on by itself once the debugger is gone
+void GdbStub::Disconnect() {
+	connected = false;
+	halted = false;
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      PACKETS                                                                                      PACKETS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+// Packets arrive as $payload#checksum. Outside a packet, 0x03 interrupts the system, and '-' asks
+// for the last packet sent again
+void GdbStub::Receive(const char* data, size_t length) {
+	for (size_t i = 0; i < length && connected; i++) {
+		const char c = data[i];
+		switch (state) {
+		case State::IDLE:
+			if (c == '$') {
+				packet.clear();
+				checksum = 0;
+				state = State::PACKET;
+			}
+			else if (c == 0x03 && !halted) {
+				Stop("S02");
+			}
+			else if (c == '-' && !lastSent.empty()) {
+				Write(lastSent);
+			}
+			break;
+		case State::PACKET:
+			if (c == '#') {
+				state = State::CHECKSUM_HIGH;
+			}
+			else if (packet.size() < PACKET_SIZE) {
+				packet += c;
+				checksum += static_cast<uint8_t>(c);
+			}
+			break;
+		case State::CHECKSUM_HIGH:
+			received = HexDigit(c);
+			if (received >= 0)
+				received <<= 4;
+			state = State::CHECKSUM_LOW;
+			break;
+		case State::CHECKSUM_LOW:
+		{
+			const int digit = HexDigit(c);
+			received = (received < 0 || digit < 0) ? -1 : received | digit;
+			state = State::IDLE;
+			// A checksum that is not hex is rejected even without acknowledgments
+			if (received >= 0 && (received == checksum || !acks)) {
+				if (acks)
+					Write("+");
+				Handle(packet);
+			}
+			else {
+				Write("-");
+			}
+			break;
+		}
+		}
+	}
+}
+
+void GdbStub::Send(const std::string& payload) {
+	std::string framed = "$";
+	uint8_t sum = 0;
+	for (char c : payload) {
+		if (c == '#' || c == '$' || c == '}' || c == '*') {
+			framed += '}';
+			sum += '}';
+			c ^= 0x20;
+		}
+		framed += c;
+		sum += static_cast<uint8_t>(c);
+	}
+	framed += '#';
+	framed += Hex(sum, 2);
+
+	lastSent = framed;
+	Write(framed);
+}
+
+void GdbStub::Write(const std::string& data) {
+	size_t sent = 0;
+	while (sent < data.size() && connected) {
+#ifdef MSG_NOSIGNAL
+		// A debugger going away must not raise SIGPIPE in the host
+		ssize_t length = send(output, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (length < 0 && errno == ENOTSOCK)
+			length = write(output, data.data() + sent, data.size() - sent);
+#else
+		ssize_t length = write(output, data.data() + sent, data.size() - sent);
+#endif
+		if (length < 0 && errno == EINTR)
+			continue;
+		if (length <= 0)
+			Disconnect();
+		else
+			sent += static_cast<size_t>(length);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      COMMANDS                                                                                    COMMANDS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+void GdbStub::Handle(const std::string& command) {
+	if (command.empty()) {
+		Send("");
+		return;
+	}
+
+	size_t pos = 1;
+	uint32_t addr, length, value;
+	switch (command[0]) {
+	case '?':
+		Send(lastStop);
+		break;
+
+	case 'g':
+		Send(ReadRegisters());
+		break;
+
+	case 'G':
+	{
+		// Registers are single bytes in order, with pc little-endian
+		int bytes[REGISTERS + 1];
+		bool valid = command.size() >= 1 + 2 * (REGISTERS + 1);
+		for (int i = 0; valid && i <= REGISTERS; i++)
+			valid = (bytes[i] = HexByte(command, 1 + 2 * i)) >= 0;
+		if (!valid) {
+			Send("E01");
+			break;
+		}
+		for (int reg = REG_A; reg < REG_PC; reg++)
+			WriteRegister(reg, bytes[reg]);
+		WriteRegister(REG_PC, bytes[REG_PC] | (bytes[REG_PC + 1] << 8));
+		Send("OK");
+		break;
+	}
+
+	case 'p':
+		if (!ParseHex(command, pos, addr) || addr >= REGISTERS)
+			Send("E01");
+		else
+			Send(ReadRegisters().substr(2 * addr, addr == REG_PC ? 4 : 2));
+		break;
+
+	case 'P':
+	{
+		// The value is in target byte order
+		if (!ParseHex(command, pos, addr) || pos >= command.size() || command[pos++] != '=') {
+			Send("E01");
+			break;
+		}
+		const size_t start = pos;
+		if (!ParseHex(command, pos, value)) {
+			Send("E01");
+			break;
+		}
+		if (pos - start == 4)
+			value = ((value & 0xFF) << 8) | (value >> 8);
+		Send(WriteRegister(addr, value) ? "OK" : "E01");
+		break;
+	}
+
+	case 'm':
+	{
+		if (!ParseRange(command, pos, addr, length)) {
+			Send("E01");
+			break;
+		}
+		std::string data;
+		length = std::min<uint32_t>(length, PACKET_SIZE / 2);
+		for (uint32_t i = 0; i < length; i++)
+			data += Hex(system.Peek(static_cast<uint16_t>(addr + i)), 2);
+		Send(data);
+		break;
+	}
+
+	case 'M':
+	{
+		if (!ParseRange(command, pos, addr, length) || pos >= command.size() || command[pos++] != ':' ||
+			length > (command.size() - pos) / 2) {
+			Send("E01");
+			break;
+		}
+		// Nothing is written unless the whole payload is hex
+		bool valid = true;
+		for (uint32_t i = 0; valid && i < length; i++)
+			valid = HexByte(command, pos + 2 * i) >= 0;
+		if (!valid) {
+			Send("E01");
+			break;
+		}
+		bool written = true;
+		for (uint32_t i = 0; i < length; i++, pos += 2)
+			written &= system.Poke(static_cast<uint16_t>(addr + i), static_cast<uint8_t>(HexByte(command, pos)));
+		Send(written ? "OK" : "E01");
+		break;
+	}
+
+	case 'c':
+	case 's':
+		Resume(command[0] == 's', command.substr(1));
+		break;
+
+	case 'C':
+	case 'S':
+	{
+		// Signals cannot be delivered to the system, so only the resume address is used
+		const size_t semicolon = command.find(';');
+		Resume(command[0] == 'S', semicolon == std::string::npos ? "" : command.substr(semicolon + 1));
+		break;
+	}
+
+	case 'Z':
+	case 'z':
+		SetPoint(command, command[0] == 'Z');
+		break;
+
+	case 'H':
+	case 'T':
+		// The system is the only thread
+		Send("OK");
+		break;
+
+	case 'D':
+		Send("OK");
+		Disconnect();
+		break;
+
+	case 'k':
+		Disconnect();
+		break;
+
+	case 'q':
+		Query(command);
+		break;
+
+	case 'Q':
+		if (command == "QStartNoAckMode") {
+			Send("OK");
+			acks = false;
+		}
+		else {
+			Send("");
+		}
+		break;
+
+	case 'v':
+		if (command == "vCont?") {
+			Send("vCont;c;C;s;S");
+		}
+		else if (command.rfind("vCont;", 0) == 0 && command.size() > 6) {
+			// The first action applies to the only thread
+			const char action = command[6];
+			if (action == 'c' || action == 'C' || action == 's' || action == 'S')
+				Resume(action == 's' || action == 'S', "");
+			else
+				Send("E01");
+		}
+		else {
+			Send("");
+		}
+		break;
+
+	default:
+		Send("");
+		break;
+	}
+}
+
+void GdbStub::Query(const std::string& command) {
+	static const std::string FEATURES = "qXfer:features:read:target.xml:";
+
+	if (command.rfind("qSupported", 0) == 0) {
+		Send("PacketSize=" + Hex(PACKET_SIZE, 4) + ";qXfer:features:read+;swbreak+;QStartNoAckMode+;vContSupported+");
+	}
+	else if (command.rfind(FEATURES, 0) == 0) {
+		size_t pos = FEATURES.size();
+		uint32_t offset, length;
+		if (!ParseRange(command, pos, offset, length)) {
+			Send("E01");
+			return;
+		}
+		const size_t size = sizeof(TARGET_XML) - 1;
+		if (offset >= size) {
+			Send("l");
+			return;
+		}
+		length = std::min<uint32_t>(length, PACKET_SIZE / 2);
+		const bool last = offset + length >= size;
+		Send((last ? "l" : "m") + std::string(TARGET_XML + offset, std::min<size_t>(length, size - offset)));
+	}
+	else if (command.rfind("qAttached", 0) == 0) {
+		Send("1");
+	}
+	else if (command == "qC") {
+		Send("QC1");
+	}
+	else if (command == "qfThreadInfo") {
+		Send("m1");
+	}
+	else if (command == "qsThreadInfo") {
+		Send("l");
+	}
+	else if (command.rfind("qSymbol", 0) == 0) {
+		Send("OK");
+	}
+	else {
+		Send("");
+	}
+}
+
+// Z0 and Z1 are breakpoints, Z2 write, Z3 read and Z4 access watchpoints over a range of addresses
+void GdbStub::SetPoint(const std::string& command, bool enable) {
+	size_t pos = 1;
+	uint32_t type, addr, length;
+	if (!ParseHex(command, pos, type) || pos >= command.size() || command[pos++] != ',' ||
+		!ParseRange(command, pos, addr, length) || length > MAX_WATCH_LENGTH) {
+		Send("E01");
+		return;
+	}
+
+	switch (type) {
+	case 0:
+	case 1:
+		system.SetBreakpoint(static_cast<uint16_t>(addr), enable);
+		break;
+	case 2:
+	case 3:
+	case 4:
+		for (uint32_t i = 0; i < std::max<uint32_t>(length, 1); i++) {
+			if (type != 3)
+				system.SetWriteWatch(static_cast<uint16_t>(addr + i), enable);
+			if (type != 2)
+				system.SetReadWatch(static_cast<uint16_t>(addr + i), enable);
+		}
+		break;
+	default:
+		Send("");
+		return;
+	}
+	Send("OK");
+}
+
+std::string GdbStub::ReadRegisters() const {
+	const MOS6502& cpu = system.cpu;
+	return Hex(cpu.A, 2) + Hex(cpu.X, 2) + Hex(cpu.Y, 2) + Hex(cpu.P, 2) + Hex(cpu.SP, 2) +
+		Hex(cpu.PC & 0xFF, 2) + Hex(cpu.PC >> 8, 2);
+}
+
+bool GdbStub::WriteRegister(int reg, uint32_t value) {
+	MOS6502& cpu = system.cpu;
+	switch (reg) {
+	case REG_A:  cpu.A = static_cast<uint8_t>(value); return true;
+	case REG_X:  cpu.X = static_cast<uint8_t>(value); return true;
+	case REG_Y:  cpu.Y = static_cast<uint8_t>(value); return true;
+	case REG_P:  cpu.P = static_cast<uint8_t>(value); return true;
+	case REG_SP: cpu.SP = static_cast<uint8_t>(value); return true;
+	case REG_PC: cpu.PC = static_cast<uint16_t>(value); return true;
+	}
+	return false;
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      EXECUTION                                                                                  EXECUTION      */
+/*----------------------------------------------------------------------------------------------------------------*/
+// Step at once, replying with the stop, or leave the system to run from the host's loop
+void GdbStub::Resume(bool step, const std::string& addr) {
+	size_t pos = 0;
+	uint32_t target;
+	if (ParseHex(addr, pos, target))
+		system.cpu.PC = static_cast<uint16_t>(target);
+
+	// Resuming carries on past an error the system stopped on
+	system.cpu.status = 0;
+
+	if (step) {
+		if (!PassBreakpoint())
+			system.cpu.Run(1);
+		Report(system.cpu.status);
+	}
+	else if (PassBreakpoint() && system.cpu.status != 0) {
+		Report(system.cpu.status);
+	}
+	else {
+		halted = false;
+	}
+}
+
+// Execute the instruction at a breakpoint on the current PC without stopping at it
+bool GdbStub::PassBreakpoint() {
+	const uint16_t addr = system.cpu.PC;
+	if (!system.Breakpoint(addr))
+		return false;
+
+	system.SetBreakpoint(addr, false);
+	system.cpu.Run(1);
+	system.SetBreakpoint(addr, true);
+	return true;
+}
+
+// Hand a stop to the debugger. Breakpoints and watchpoints are the debugger's business, so their
+// status is cleared; errors stay for the host to see until the debugger resumes
+void GdbStub::Report(int status) {
+	if (status == E_BREAK || status == E_WATCHR || status == E_WATCHW)
+		system.cpu.status = 0;
+	Stop(StopReply(status));
+}
+
+void GdbStub::Stop(const std::string& reply) {
+	halted = true;
+	lastStop = reply;
+	Send(reply);
+}
+
+std::string GdbStub::StopReply(int status) const {
+	const uint16_t hit = system.LastHit();
+	switch (status) {
+	case E_BREAK:
+		return "T05swbreak:;";
+	case E_WATCHW:
+		return system.ReadWatch(hit) ? "T05awatch:" + Hex(hit, 4) + ";" : "T05watch:" + Hex(hit, 4) + ";";
+	case E_WATCHR:
+		return system.WriteWatch(hit) ? "T05awatch:" + Hex(hit, 4) + ";" : "T05rwatch:" + Hex(hit, 4) + ";";
+	case E_INV:
+		return "S04"; // SIGILL
+	case E_BADR:
+	case E_BADW:
+		return "S0b"; // SIGSEGV
+	case 0:
+		return "S05"; // SIGTRAP, after a step
+	default:
+		return "S06"; // SIGABRT
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class Bus;
+
+// GDB remote serial protocol server for a Bus
+//    The protocol is spoken over a pair of file descriptors: stdin and stdout when gdb starts the
+//    emulator itself with "target remote | command", or a connection accepted on a Unix domain
+//    socket with ListenUnix. The debugger sees the registers a, x, y, p, sp and pc, reads and
+//    writes memory through Peek and Poke, and can step, continue, interrupt, and set breakpoints
+//    and watchpoints, which are the bus's own.
+//
+//    The stub does not take over the host's loop. The host calls Run in place of cpu.Run, which
+//    handles anything the debugger has sent and then runs the system unless the debugger holds it
+//    stopped, so devices, frames and the rest of the host carry on around a debugger. A debugger
+//    finds the system stopped when it connects and resumes it with continue. Serve is a loop for
+//    hosts with nothing else to do.
+//
+//    Only the all-stop mode is implemented, with the system as a single thread. The file
+//    descriptors are not closed by the stub.
+class GdbStub
+{
+public:
+	static constexpr int32_t DEFAULT_SLICE = 10000;
+
+	GdbStub(Bus& system, int input, int output);
+
+	GdbStub(const GdbStub&) = delete;
+	GdbStub& operator=(const GdbStub&) = delete;
+
+	// Listen on a Unix domain socket at the given path and wait for one debugger to connect.
+	// Returns the connection, usable as both input and output, or -1 on failure
+	static int ListenUnix(const std::string& path);
+
+public: // State
+	bool Connected() const { return connected; }
+	bool Halted() const { return halted; } // The debugger holds the system stopped
+
+public: // Driving, from the host's loop
+	// Handle whatever the debugger has sent, without waiting for more
+	void Poll();
+
+	// Poll, then run the system for the given number of cycles unless it is halted, returning what
+	// cpu.Run returned, or 0 if it did not run. Breakpoint and watchpoint stops are reported to the
+	// debugger and cleared from status; other errors are reported and left in place until the
+	// debugger resumes
+	int Run(int32_t cycles);
+
+	// Run in slices of the given number of cycles, waiting on the connection while halted, until the
+	// debugger detaches or the connection closes
+	void Serve(int32_t slice = DEFAULT_SLICE);
+
+private:
+	Bus& system;
+	int  input;
+	int  output;
+
+	bool connected = true;
+	bool halted = true;
+	bool acks = true; // Acknowledge each packet, until the debugger asks for no-ack mode
+	std::string lastStop = "S05";
+
+	// Incoming packet, parsed a byte at a time
+	enum class State { IDLE, PACKET, CHECKSUM_HIGH, CHECKSUM_LOW };
+	State       state = State::IDLE;
+	std::string packet;
+	uint8_t     checksum = 0;
+	int         received = 0; // -1 once a checksum digit is not hex
+	std::string lastSent; // Kept for retransmission when the debugger rejects it
+
+	void Receive(const char* data, size_t length);
+	bool Wait();
+	void Disconnect();
+
+	void Send(const std::string& payload);
+	void Write(const std::string& data);
+
+	void Handle(const std::string& command);
+	void Query(const std::string& command);
+	void SetPoint(const std::string& command, bool enable);
+	std::string ReadRegisters() const;
+	bool WriteRegister(int reg, uint32_t value);
+
+	void Resume(bool step, const std::string& addr);
+	bool PassBreakpoint();
+	void Report(int status);
+	void Stop(const std::string& reply);
+	std::string StopReply(int status) const;
+};
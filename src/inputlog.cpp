@@ -0,0 +1,214 @@
+#include "inputlog.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+static constexpr char MAGIC[4] = { 'M', '6', '5', 'I' };
+
+// Little-endian field helpers
+template<typename T>
+static void Put(std::ostream& out, T value) {
+	uint8_t bytes[sizeof(T)];
+	for (size_t i = 0; i < sizeof(T); i++)
+		bytes[i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+	out.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+template<typename T>
+static bool Get(std::istream& in, T& value) {
+	uint8_t bytes[sizeof(T)];
+	if (!in.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+		return false;
+	uint64_t result = 0;
+	for (size_t i = 0; i < sizeof(T); i++)
+		result |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+	value = static_cast<T>(result);
+	return true;
+}
+
+// Seven bits per byte, low bits first, with the top bit set on every byte but the last
+void InputLog::PutVarint(uint64_t value) {
+	while (value >= 0x80) {
+		data.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	data.push_back(static_cast<uint8_t>(value));
+}
+
+static bool GetVarint(const std::vector<uint8_t>& data, size_t& offset, uint64_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (offset >= data.size())
+			return false;
+		uint8_t byte = data[offset++];
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// Inputs must be appended in cycle order
+void InputLog::Append(const Input& input) {
+	if (count % INDEX_STRIDE == 0)
+		index.push_back(End());
+
+	data.push_back(static_cast<uint8_t>(input.kind));
+	PutVarint(input.cycle - lastCycle);
+	switch (input.kind) {
+	case Kind::READ:
+		data.push_back(static_cast<uint8_t>(input.addr));
+		data.push_back(static_cast<uint8_t>(input.addr >> 8));
+		data.push_back(static_cast<uint8_t>(input.value));
+		break;
+	case Kind::IRQ:
+		PutVarint(input.value);
+		break;
+	case Kind::NMI:
+		data.push_back(input.value ? 1 : 0);
+		break;
+	}
+	lastCycle = input.cycle;
+	count++;
+}
+
+void InputLog::Clear() {
+	data.clear();
+	index.clear();
+	count = 0;
+	lastCycle = 0;
+}
+
+bool InputLog::Reader::Next(Input& input) {
+	const std::vector<uint8_t>& data = log->data;
+	size_t offset = at.offset;
+	if (offset >= data.size())
+		return false;
+
+	uint64_t delta;
+	input.kind = static_cast<Kind>(data[offset++]);
+	if (!GetVarint(data, offset, delta))
+		return false;
+	input.cycle = at.cycle + delta;
+	input.addr = 0;
+
+	switch (input.kind) {
+	case Kind::READ:
+		if (offset + 3 > data.size())
+			return false;
+		input.addr = static_cast<uint16_t>(data[offset] | (data[offset + 1] << 8));
+		input.value = data[offset + 2];
+		offset += 3;
+		break;
+	case Kind::IRQ:
+	{
+		uint64_t lines;
+		if (!GetVarint(data, offset, lines))
+			return false;
+		input.value = static_cast<uint32_t>(lines);
+		break;
+	}
+	case Kind::NMI:
+		if (offset >= data.size())
+			return false;
+		input.value = data[offset++];
+		break;
+	default:
+		return false;
+	}
+
+	at = { offset, input.cycle, at.index + 1 };
+	return true;
+}
+
+// Resume from the indexed position closest to the target, or from where the reader is if that is
+// closer, so seeking costs at most INDEX_STRIDE decodes
+void InputLog::Reader::Seek(uint64_t target) {
+	auto before = [target](const Position& position) { return position.index == 0 || position.cycle < target; };
+	const std::vector<Position>& index = log->index;
+	auto it = std::partition_point(index.begin(), index.end(), before);
+	Position start = (it == index.begin()) ? Position{} : *std::prev(it);
+	if (!before(at) || at.index < start.index)
+		at = start;
+
+	Input input;
+	for (;;) {
+		const Position previous = at;
+		if (!Next(input) || input.cycle >= target) {
+			at = previous;
+			return;
+		}
+	}
+}
+
+// Resume from the indexed position before the input, unless the reader is already closer
+void InputLog::Reader::Skip(size_t inputs) {
+	const std::vector<Position>& index = log->index;
+	if (!index.empty() && (at.index > inputs || inputs - at.index > INDEX_STRIDE))
+		at = index[std::min(inputs / INDEX_STRIDE, index.size() - 1)];
+
+	Input input;
+	while (at.index < inputs)
+		if (!Next(input))
+			return;
+}
+
+bool InputLog::Reader::Next(Input& input, Kind kind) {
+	while (Next(input))
+		if (input.kind == kind)
+			return true;
+	return false;
+}
+
+void InputLog::Write(std::ostream& out) const {
+	out.write(MAGIC, sizeof(MAGIC));
+	Put<uint16_t>(out, VERSION);
+	Put<uint64_t>(out, count);
+	Put<uint64_t>(out, lastCycle);
+	Put<uint64_t>(out, data.size());
+	out.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+// Returns false if the stream is truncated, corrupt or not an input log of this version. The
+// encoded inputs are read a chunk at a time, so a corrupt length cannot allocate more than the
+// stream holds
+bool InputLog::Read(std::istream& in) {
+	char magic[4];
+	uint16_t version;
+	uint64_t inputs, last, length;
+	if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+		return false;
+	if (!Get(in, version) || version != VERSION)
+		return false;
+	if (!Get(in, inputs) || !Get(in, last) || !Get(in, length))
+		return false;
+
+	static constexpr size_t CHUNK = 64 * 1024;
+	std::vector<uint8_t> bytes;
+	while (bytes.size() < length) {
+		const size_t size = bytes.size();
+		const size_t chunk = static_cast<size_t>(std::min<uint64_t>(CHUNK, length - size));
+		bytes.resize(size + chunk);
+		if (!in.read(reinterpret_cast<char*>(bytes.data() + size), chunk))
+			return false;
+	}
+
+	// Decode every input once to check the log and rebuild the seek index
+	InputLog log;
+	log.data = std::move(bytes);
+	Reader reader(log);
+	Input input;
+	while (log.count < inputs) {
+		if (log.count % INDEX_STRIDE == 0)
+			log.index.push_back(reader.Tell());
+		if (!reader.Next(input))
+			return false;
+		log.count++;
+	}
+	if (reader.Tell().offset != log.data.size() || reader.Tell().cycle != last)
+		return false;
+
+	log.lastCycle = last;
+	*this = std::move(log);
+	return true;
+}
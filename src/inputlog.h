@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Append-only log of the values a system takes from outside
+//    Recording a run logs every device read and every change of the interrupt lines, keyed by the
+//    Clock value at which it happened. Replaying the log feeds the same values back at the same
+//    cycles, so the run can be reproduced exactly without the devices or the host that drove it.
+//
+//    Each input is encoded as a kind byte, the cycles since the previous input as a variable
+//    length integer, then its payload:
+//        READ: u16 address, u8 value
+//        IRQ:  varint mask of the sources asserting the line
+//        NMI:  u8 line state
+class InputLog
+{
+public:
+	enum class Kind : uint8_t { READ, IRQ, NMI };
+
+	struct Input {
+		uint64_t cycle = 0;
+		Kind     kind = Kind::READ;
+		uint16_t addr = 0;  // READ only
+		uint32_t value = 0; // Byte read, IRQ source mask or NMI line state
+	};
+
+	// Place in the log: the byte offset of an input, the cycle of the input before it and how many
+	// inputs come before it. Readers can resume from a position without decoding up to it
+	struct Position {
+		size_t   offset = 0;
+		uint64_t cycle = 0;
+		size_t   index = 0;
+	};
+
+	static constexpr uint16_t VERSION = 1;
+
+	// Inputs between the positions kept for seeking
+	static constexpr size_t INDEX_STRIDE = 1024;
+
+public: // Recording
+	void Append(const Input& input);
+	void Clear();
+
+	size_t   Count() const { return count; }
+	size_t   Bytes() const { return data.size(); }
+	uint64_t LastCycle() const { return lastCycle; }
+
+	// Position after the last input, where the next one will be appended
+	Position End() const { return { data.size(), lastCycle, count }; }
+
+public: // Replaying
+	// Decodes the log from the start, one input at a time
+	class Reader {
+	public:
+		Reader() = default;
+		explicit Reader(const InputLog& log) : log(&log) {}
+
+		// Move to the first input made at or after the given cycle
+		void Seek(uint64_t cycle);
+
+		// Move to the input with the given index, the number of inputs before it
+		void Skip(size_t inputs);
+
+		// Move to a position taken from this reader, another reader or End
+		void SeekTo(const Position& position) { at = position; }
+		const Position& Tell() const { return at; }
+
+		// Next input, of any kind or only of the given kind. Returns false at the end of the log
+		bool Next(Input& input);
+		bool Next(Input& input, Kind kind);
+
+	private:
+		const InputLog* log = nullptr;
+		Position at;
+	};
+
+public: // Serialization
+	//    "M65I" magic, u16 version, u64 input count, u64 last cycle, u64 byte length, encoded inputs
+	void Write(std::ostream& out) const;
+	bool Read(std::istream& in);
+
+private:
+	std::vector<uint8_t> data;
+	size_t   count = 0;
+	uint64_t lastCycle = 0;
+
+	// Position of every INDEX_STRIDE'th input, so readers can seek without decoding from the start
+	std::vector<Position> index;
+
+	void PutVarint(uint64_t value);
+};
@@ -223,6 +223,114 @@ static constexpr Byte INS_BRK = 0x00;
 static constexpr Byte INS_NOP = 0xEA;
 static constexpr Byte INS_RTI = 0x40;
 
+// Undocumented NMOS Operations
+    // Read-modify-write combinations
+    // SLO
+static constexpr Byte INS_SLO_ZP = 0x07;
+static constexpr Byte INS_SLO_ZPX = 0x17;
+static constexpr Byte INS_SLO_ABS = 0x0F;
+static constexpr Byte INS_SLO_ABSX = 0x1F;
+static constexpr Byte INS_SLO_ABSY = 0x1B;
+static constexpr Byte INS_SLO_INDX = 0x03;
+static constexpr Byte INS_SLO_INDY = 0x13;
+
+    // RLA
+static constexpr Byte INS_RLA_ZP = 0x27;
+static constexpr Byte INS_RLA_ZPX = 0x37;
+static constexpr Byte INS_RLA_ABS = 0x2F;
+static constexpr Byte INS_RLA_ABSX = 0x3F;
+static constexpr Byte INS_RLA_ABSY = 0x3B;
+static constexpr Byte INS_RLA_INDX = 0x23;
+static constexpr Byte INS_RLA_INDY = 0x33;
+
+    // SRE
+static constexpr Byte INS_SRE_ZP = 0x47;
+static constexpr Byte INS_SRE_ZPX = 0x57;
+static constexpr Byte INS_SRE_ABS = 0x4F;
+static constexpr Byte INS_SRE_ABSX = 0x5F;
+static constexpr Byte INS_SRE_ABSY = 0x5B;
+static constexpr Byte INS_SRE_INDX = 0x43;
+static constexpr Byte INS_SRE_INDY = 0x53;
+
+    // RRA
+static constexpr Byte INS_RRA_ZP = 0x67;
+static constexpr Byte INS_RRA_ZPX = 0x77;
+static constexpr Byte INS_RRA_ABS = 0x6F;
+static constexpr Byte INS_RRA_ABSX = 0x7F;
+static constexpr Byte INS_RRA_ABSY = 0x7B;
+static constexpr Byte INS_RRA_INDX = 0x63;
+static constexpr Byte INS_RRA_INDY = 0x73;
+
+    // DCP
+static constexpr Byte INS_DCP_ZP = 0xC7;
+static constexpr Byte INS_DCP_ZPX = 0xD7;
+static constexpr Byte INS_DCP_ABS = 0xCF;
+static constexpr Byte INS_DCP_ABSX = 0xDF;
+static constexpr Byte INS_DCP_ABSY = 0xDB;
+static constexpr Byte INS_DCP_INDX = 0xC3;
+static constexpr Byte INS_DCP_INDY = 0xD3;
+
+    // ISC
+static constexpr Byte INS_ISC_ZP = 0xE7;
+static constexpr Byte INS_ISC_ZPX = 0xF7;
+static constexpr Byte INS_ISC_ABS = 0xEF;
+static constexpr Byte INS_ISC_ABSX = 0xFF;
+static constexpr Byte INS_ISC_ABSY = 0xFB;
+static constexpr Byte INS_ISC_INDX = 0xE3;
+static constexpr Byte INS_ISC_INDY = 0xF3;
+
+    // Combined loads and stores
+    // LAX
+static constexpr Byte INS_LAX_ZP = 0xA7;
+static constexpr Byte INS_LAX_ZPY = 0xB7;
+static constexpr Byte INS_LAX_ABS = 0xAF;
+static constexpr Byte INS_LAX_ABSY = 0xBF;
+static constexpr Byte INS_LAX_INDX = 0xA3;
+static constexpr Byte INS_LAX_INDY = 0xB3;
+
+    // SAX
+static constexpr Byte INS_SAX_ZP = 0x87;
+static constexpr Byte INS_SAX_ZPY = 0x97;
+static constexpr Byte INS_SAX_ABS = 0x8F;
+static constexpr Byte INS_SAX_INDX = 0x83;
+
+    // Immediate combinations
+static constexpr Byte INS_ANC_IM_0B = 0x0B;
+static constexpr Byte INS_ANC_IM_2B = 0x2B;
+static constexpr Byte INS_ALR_IM = 0x4B;
+static constexpr Byte INS_ARR_IM = 0x6B;
+static constexpr Byte INS_SBX_IM = 0xCB;
+static constexpr Byte INS_SBC_IM_EB = 0xEB;
+
+    // NOPs
+static constexpr Byte INS_NOP_1A = 0x1A;
+static constexpr Byte INS_NOP_3A = 0x3A;
+static constexpr Byte INS_NOP_5A = 0x5A;
+static constexpr Byte INS_NOP_7A = 0x7A;
+static constexpr Byte INS_NOP_DA = 0xDA;
+static constexpr Byte INS_NOP_FA = 0xFA;
+static constexpr Byte INS_NOP_IM_80 = 0x80;
+static constexpr Byte INS_NOP_IM_82 = 0x82;
+static constexpr Byte INS_NOP_IM_89 = 0x89;
+static constexpr Byte INS_NOP_IM_C2 = 0xC2;
+static constexpr Byte INS_NOP_IM_E2 = 0xE2;
+static constexpr Byte INS_NOP_ZP_04 = 0x04;
+static constexpr Byte INS_NOP_ZP_44 = 0x44;
+static constexpr Byte INS_NOP_ZP_64 = 0x64;
+static constexpr Byte INS_NOP_ZPX_14 = 0x14;
+static constexpr Byte INS_NOP_ZPX_34 = 0x34;
+static constexpr Byte INS_NOP_ZPX_54 = 0x54;
+static constexpr Byte INS_NOP_ZPX_74 = 0x74;
+static constexpr Byte INS_NOP_ZPX_D4 = 0xD4;
+static constexpr Byte INS_NOP_ZPX_F4 = 0xF4;
+static constexpr Byte INS_NOP_ABS_0C = 0x0C;
+static constexpr Byte INS_NOP_ABSX_1C = 0x1C;
+static constexpr Byte INS_NOP_ABSX_3C = 0x3C;
+static constexpr Byte INS_NOP_ABSX_5C = 0x5C;
+static constexpr Byte INS_NOP_ABSX_7C = 0x7C;
+static constexpr Byte INS_NOP_ABSX_DC = 0xDC;
+static constexpr Byte INS_NOP_ABSX_FC = 0xFC;
+
 // Instructions
 static const unordered_set<string> valid_instructions =
 { "LDA", "LDX", "LDY", "STA", "STX", "STY", "TAX", "TAY", "TXA", "TYA", "TSX", "TXS", "PHA", "PHP",
@@ -235,6 +343,8 @@ enum class Instruction {
 	PLA, PLP, AND, EOR, ORA, BIT, ADC, SBC, CMP, CPX, CPY, INC, INX, INY,
 	DEC, DEX, DEY, ASL, LSR, ROL, ROR, JMP, JSR, RTS, BCC, BCS, BEQ, BMI,
 	BNE, BPL, BVC, BVS, CLC, CLD, CLI, CLV, SEC, SED, SEI, BRK, NOP, RTI,
+	// Undocumented NMOS instructions
+	SLO, RLA, SRE, RRA, DCP, ISC, LAX, SAX, ANC, ALR, ARR, SBX,
     INVALID
 };
 
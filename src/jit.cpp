@@ -0,0 +1,831 @@
+#include "jit.h"
+#include "decode.h"
+#include <cstring>
+#include <map>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+enum Reg : uint8_t { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Registers the block state lives in. All are callee saved, so they survive the handler calls
+constexpr Reg CPU    = RBX;
+constexpr Reg PAGES  = RBP; // Read page table
+constexpr Reg REG_A  = R12;
+constexpr Reg REG_X  = R13;
+constexpr Reg REG_Y  = R14;
+constexpr Reg CYCLES = R15;
+
+// Condition codes
+enum Cond : uint8_t { CC_O = 0x0, CC_C = 0x2, CC_NC = 0x3, CC_Z = 0x4, CC_NZ = 0x5, CC_GE = 0xD };
+
+// Arithmetic group operations, by their ModRM extension
+enum Alu : uint8_t { ALU_ADD = 0, ALU_OR = 1, ALU_ADC = 2, ALU_SBB = 3, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7 };
+
+// Shift group operations, by their ModRM extension
+enum Shift : uint8_t { SHIFT_RCL = 2, SHIFT_RCR = 3, SHIFT_SHL = 4, SHIFT_SHR = 5 };
+
+// Little helper for appending x86-64 machine code
+//    Registers are 32 bits wide unless the name says otherwise, and memory operands always take a
+//    32-bit displacement.
+struct Emitter {
+	std::vector<uint8_t> bytes;
+
+	size_t Position() const { return bytes.size(); }
+
+	void Byte(uint8_t b) { bytes.push_back(b); }
+	void Bytes(std::initializer_list<uint8_t> bs) { bytes.insert(bytes.end(), bs); }
+	void Int16(uint16_t value) {
+		Byte(static_cast<uint8_t>(value));
+		Byte(static_cast<uint8_t>(value >> 8));
+	}
+	void Int32(int32_t value) {
+		for (int i = 0; i < 4; i++)
+			Byte(static_cast<uint8_t>(value >> (8 * i)));
+	}
+	void Int64(uint64_t value) {
+		for (int i = 0; i < 8; i++)
+			Byte(static_cast<uint8_t>(value >> (8 * i)));
+	}
+
+	// REX prefix, if one is needed. Byte operations on SPL-DIL need one even with no bits set
+	void Rex(bool wide, int reg, int index, int base, bool byteRegs = false) {
+		const uint8_t rex = 0x40 | (wide << 3) | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3);
+		if (rex != 0x40 || byteRegs)
+			Byte(rex);
+	}
+	static bool ByteRex(int reg, int rm = 0) { return reg >= RSP || rm >= RSP; }
+
+	// ModRM for a register operand, for [base + disp32] and for [base + index * scale + disp32]
+	void Direct(int reg, int rm) { Byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+	void Mem(int reg, int base, int32_t disp) {
+		Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+		if ((base & 7) == RSP)
+			Byte(0x24);
+		Int32(disp);
+	}
+	void MemIndex(int reg, int base, int index, int scale, int32_t disp) {
+		Byte(0x84 | ((reg & 7) << 3));
+		Byte((scale << 6) | ((index & 7) << 3) | (base & 7));
+		Int32(disp);
+	}
+
+	// movzx r32, byte [base + disp] and [base + index + disp]
+	void LoadByte(Reg dst, Reg base, int32_t disp) { Rex(false, dst, 0, base); Bytes({ 0x0F, 0xB6 }); Mem(dst, base, disp); }
+	void LoadByte(Reg dst, Reg base, Reg index, int32_t disp) { Rex(false, dst, index, base); Bytes({ 0x0F, 0xB6 }); MemIndex(dst, base, index, 0, disp); }
+	// mov byte [base + disp], r8 and [base + index + disp]
+	void StoreByte(Reg base, int32_t disp, Reg src) { Rex(false, src, 0, base, ByteRex(src)); Byte(0x88); Mem(src, base, disp); }
+	void StoreByte(Reg base, Reg index, int32_t disp, Reg src) { Rex(false, src, index, base, ByteRex(src)); Byte(0x88); MemIndex(src, base, index, 0, disp); }
+	// mov byte [base + index + disp], imm8
+	void StoreByteImm(Reg base, Reg index, int32_t disp, uint8_t imm) { Rex(false, 0, index, base); Byte(0xC6); MemIndex(0, base, index, 0, disp); Byte(imm); }
+	// mov r32, [base + disp] and mov [base + disp], r32
+	void Load32(Reg dst, Reg base, int32_t disp) { Rex(false, dst, 0, base); Byte(0x8B); Mem(dst, base, disp); }
+	void Store32(Reg base, int32_t disp, Reg src) { Rex(false, src, 0, base); Byte(0x89); Mem(src, base, disp); }
+	// mov word [base + disp], r16 and imm16
+	void Store16(Reg base, int32_t disp, Reg src) { Byte(0x66); Rex(false, src, 0, base); Byte(0x89); Mem(src, base, disp); }
+	void Store16Imm(Reg base, int32_t disp, uint16_t imm) { Byte(0x66); Rex(false, 0, 0, base); Byte(0xC7); Mem(0, base, disp); Int16(imm); }
+	// mov r64, [base + disp] and [base + index * 8 + disp]
+	void LoadPointer(Reg dst, Reg base, int32_t disp) { Rex(true, dst, 0, base); Byte(0x8B); Mem(dst, base, disp); }
+	void LoadPointer(Reg dst, Reg base, Reg index, int32_t disp) { Rex(true, dst, index, base); Byte(0x8B); MemIndex(dst, base, index, 3, disp); }
+	// test r64, r64
+	void TestPointer(Reg r) { Rex(true, r, 0, r); Byte(0x85); Direct(r, r); }
+	// mov r64, r64 and mov r64, imm64
+	void Mov64(Reg dst, Reg src) { Rex(true, src, 0, dst); Byte(0x89); Direct(src, dst); }
+	void Mov64Imm(Reg dst, uint64_t imm) { Rex(true, 0, 0, dst); Byte(0xB8 + (dst & 7)); Int64(imm); }
+	// mov r32, r32 and mov r32, imm32
+	void Mov32(Reg dst, Reg src) { Rex(false, src, 0, dst); Byte(0x89); Direct(src, dst); }
+	void Mov32Imm(Reg dst, uint32_t imm) { Rex(false, 0, 0, dst); Byte(0xB8 + (dst & 7)); Int32(static_cast<int32_t>(imm)); }
+	// movzx r32, r8 and movzx r32, r16
+	void ZeroExtend8(Reg dst, Reg src) { Rex(false, dst, 0, src, ByteRex(src)); Bytes({ 0x0F, 0xB6 }); Direct(dst, src); }
+	void ZeroExtend16(Reg dst, Reg src) { Rex(false, dst, 0, src); Bytes({ 0x0F, 0xB7 }); Direct(dst, src); }
+	// lea r32, [base + disp]
+	void Lea32(Reg dst, Reg base, int32_t disp) { Rex(false, dst, 0, base); Byte(0x8D); Mem(dst, base, disp); }
+
+	// op r32, r32 / op r8, r8 / op r32, imm / op byte [base + disp], imm8 / op byte [base + disp], r8
+	void Alu32(Alu op, Reg dst, Reg src) { Rex(false, src, 0, dst); Byte((op << 3) | 1); Direct(src, dst); }
+	void Alu8(Alu op, Reg dst, Reg src) { Rex(false, src, 0, dst, ByteRex(src, dst)); Byte(op << 3); Direct(src, dst); }
+	void Alu32Imm(Alu op, Reg dst, int32_t imm) {
+		Rex(false, 0, 0, dst);
+		if (imm >= -128 && imm <= 127) {
+			Byte(0x83);
+			Direct(op, dst);
+			Byte(static_cast<uint8_t>(imm));
+		}
+		else {
+			Byte(0x81);
+			Direct(op, dst);
+			Int32(imm);
+		}
+	}
+	void AluByteImm(Alu op, Reg base, int32_t disp, uint8_t imm) { Rex(false, 0, 0, base); Byte(0x80); Mem(op, base, disp); Byte(imm); }
+	void AluByte(Alu op, Reg base, int32_t disp, Reg src) { Rex(false, src, 0, base, ByteRex(src)); Byte(op << 3); Mem(src, base, disp); }
+	// cmp r32, [base + disp] and cmp dword [base + disp], imm8
+	void Cmp32(Reg r, Reg base, int32_t disp) { Rex(false, r, 0, base); Byte(0x3B); Mem(r, base, disp); }
+	void Cmp32Imm(Reg base, int32_t disp, int8_t imm) { Rex(false, 0, 0, base); Byte(0x83); Mem(ALU_CMP, base, disp); Byte(static_cast<uint8_t>(imm)); }
+	// test byte [base + disp], imm8
+	void TestByte(Reg base, int32_t disp, uint8_t imm) { Rex(false, 0, 0, base); Byte(0xF6); Mem(0, base, disp); Byte(imm); }
+
+	// shift r32, imm8 / shift r8, 1 / shift r8, imm8
+	void Shift32(Shift op, Reg r, uint8_t count) { Rex(false, 0, 0, r); Byte(0xC1); Direct(op, r); Byte(count); }
+	void Shift8(Shift op, Reg r) { Rex(false, 0, 0, r, ByteRex(r)); Byte(0xD0); Direct(op, r); }
+	void Shift8(Shift op, Reg r, uint8_t count) { Rex(false, 0, 0, r, ByteRex(r)); Byte(0xC0); Direct(op, r); Byte(count); }
+	// inc r8 and dec r8
+	void Inc8(Reg r) { Rex(false, 0, 0, r, ByteRex(r)); Byte(0xFE); Direct(0, r); }
+	void Dec8(Reg r) { Rex(false, 0, 0, r, ByteRex(r)); Byte(0xFE); Direct(1, r); }
+	// setcc r8
+	void Set(Cond cc, Reg r) { Rex(false, 0, 0, r, ByteRex(r)); Bytes({ 0x0F, static_cast<uint8_t>(0x90 | cc) }); Direct(0, r); }
+	// cmc
+	void Cmc() { Byte(0xF5); }
+
+	void Push(Reg r) { Rex(false, 0, 0, r); Byte(0x50 + (r & 7)); }
+	void Pop(Reg r) { Rex(false, 0, 0, r); Byte(0x58 + (r & 7)); }
+	void CallRax() { Bytes({ 0xFF, 0xD0 }); }
+	void Ret() { Byte(0xC3); }
+
+	// Emit a rel32 jump, returning the position of its displacement
+	size_t Jump() {
+		Byte(0xE9);
+		Int32(0);
+		return Position() - 4;
+	}
+	size_t Jump(Cond cc) {
+		Bytes({ 0x0F, static_cast<uint8_t>(0x80 | cc) });
+		Int32(0);
+		return Position() - 4;
+	}
+
+	void Patch(size_t position, size_t target) {
+		int32_t rel = static_cast<int32_t>(target - (position + 4));
+		std::memcpy(&bytes[position], &rel, 4);
+	}
+};
+
+// Effective address of a memory operand: known when the block is compiled, or computed into ecx
+// on the zero page or anywhere in memory
+struct Address {
+	enum Kind { FIXED, ZERO_PAGE_INDEXED, INDEXED };
+	Kind     kind;
+	uint16_t addr; // The address if fixed, otherwise the base it is indexed from
+	Reg      index;
+};
+
+// Translates one block
+//    The code for each instruction jumps out to a slow path when it cannot finish inline, for
+//    example when its page is trapped or decimal mode is set. The slow path runs the instruction's
+//    handler from the start instead, so nothing may change the CPU state before the last jump to
+//    it. Slow paths and exits are placed after the block, out of the way of the inline code.
+class BlockCompiler
+{
+public:
+	BlockCompiler(const JitCompiler::Layout& layout, const JitCompiler::Step* steps, int count)
+		: layout(layout), steps(steps), count(count), labels(count) {
+		const intptr_t tables = reinterpret_cast<intptr_t>(layout.writePages) - reinterpret_cast<intptr_t>(layout.readPages);
+		memory = layout.readPages && layout.writePages && tables > INT32_MIN / 2 && tables < INT32_MAX / 2;
+		writeTable = memory ? static_cast<int32_t>(tables) : 0;
+	}
+
+	std::vector<uint8_t> Compile();
+
+private:
+	// What follows the code of an instruction: carrying on at the next address, leaving with the
+	// program counter already stored, or nothing as the instruction has placed its own exits
+	enum class Flow { NEXT, LEAVE, DONE };
+
+	struct SlowPath {
+		std::vector<size_t> jumps;
+		int    step;
+		size_t resume;
+	};
+
+	const JitCompiler::Layout& layout;
+	const JitCompiler::Step*   steps;
+	int     count;
+	bool    memory;
+	int32_t writeTable; // Offset of the write page table from the read page table
+
+	Emitter e;
+	std::vector<size_t> labels;                    // Start of the code of each instruction
+	std::vector<size_t> misses;                    // Jumps to the slow path of the current instruction
+	std::vector<SlowPath> slowPaths;
+	std::map<uint16_t, std::vector<size_t>> exits; // Jumps leaving with the program counter at an address
+	std::vector<size_t> leaves;                    // Jumps leaving with the program counter already stored
+
+	static int32_t Offset(ptrdiff_t field) { return static_cast<int32_t>(field); }
+
+	uint16_t NextAddress(int i) const;
+	void Continue(int i, uint16_t pc);
+	void Goto(uint16_t pc);
+	void Miss(Cond cc) { misses.push_back(e.Jump(cc)); }
+
+	void Prologue();
+	void Epilogue();
+	void SaveRegisters(int32_t extraCycles);
+	void LoadRegisters();
+	void CallHandler(int i);
+	Flow Fallback(int i);
+
+	void AddCycles(int cycles) { e.Alu32Imm(ALU_ADD, CYCLES, cycles); }
+	void UpdateZN(Reg r);
+	void UpdateCarry(Reg r);
+
+	bool Readable(AddressMode mode) const;
+	Address Locate(AddressMode mode, uint16_t operand);
+	void LoadPage(Reg dst, const Address& address, int32_t table);
+	void Fetch(int i, int& cycles);
+	void LoadAt(Reg dst, Reg page, const Address& address);
+	void StoreAt(Reg page, const Address& address, Reg src);
+
+	Flow Emit(int i);
+	Flow Load(int i, Reg r);
+	Flow Store(int i, Reg r);
+	Flow Logic(int i, Alu op);
+	Flow Add(int i, bool subtract);
+	Flow Compare(int i, Reg r);
+	Flow Bit(int i);
+	Flow Modify(int i);
+	Flow Branch(int i);
+	Flow Stack(int i);
+};
+
+std::vector<uint8_t> BlockCompiler::Compile() {
+	Prologue();
+	for (int i = 0; i < count; i++) {
+		labels[i] = e.Position();
+		misses.clear();
+		const Flow flow = Emit(i);
+		if (!misses.empty())
+			slowPaths.push_back({ misses, i, e.Position() });
+		if (flow == Flow::NEXT)
+			Continue(i, NextAddress(i));
+		else if (flow == Flow::LEAVE)
+			leaves.push_back(e.Jump());
+	}
+
+	// Slow paths run the handler, then rejoin the inline code after the instruction
+	for (const SlowPath& path : slowPaths) {
+		for (size_t jump : path.jumps)
+			e.Patch(jump, e.Position());
+		CallHandler(path.step);
+		e.Patch(e.Jump(), path.resume);
+	}
+
+	for (const auto& [pc, jumps] : exits) {
+		for (size_t jump : jumps)
+			e.Patch(jump, e.Position());
+		e.Store16Imm(CPU, Offset(layout.pc), pc);
+		leaves.push_back(e.Jump());
+	}
+
+	for (size_t jump : leaves)
+		e.Patch(jump, e.Position());
+	Epilogue();
+	return std::move(e.bytes);
+}
+
+// Address execution continues at after an instruction that does not branch
+uint16_t BlockCompiler::NextAddress(int i) const {
+	const JitCompiler::Step& step = steps[i];
+	const Instruction instruction = step.operation.instruction;
+	if ((instruction == Instruction::JMP || instruction == Instruction::JSR) && step.operation.mode == ABSOLUTE)
+		return step.operand;
+	return step.pc + operation_length(step.operation.mode);
+}
+
+// Carry on at an address after an instruction, stopping first if the cycle limit is reached. The
+// limit lives in the CPU since handlers may pull it in, for example by raising an interrupt
+void BlockCompiler::Continue(int i, uint16_t pc) {
+	if (i == count - 1) {
+		Goto(pc);
+		return;
+	}
+	e.Cmp32(CYCLES, CPU, Offset(layout.limit));
+	exits[pc].push_back(e.Jump(CC_GE));
+}
+
+// Leave for an address, or loop back if it is one of the instructions of this block
+void BlockCompiler::Goto(uint16_t pc) {
+	for (int j = 0; j < count; j++) {
+		if (steps[j].pc != pc)
+			continue;
+		e.Cmp32(CYCLES, CPU, Offset(layout.limit));
+		exits[pc].push_back(e.Jump(CC_GE));
+		e.Patch(e.Jump(), labels[j]);
+		return;
+	}
+	exits[pc].push_back(e.Jump());
+}
+
+// Save the callee saved registers, with one more push to keep the stack aligned for calls, and
+// load the CPU state into them
+void BlockCompiler::Prologue() {
+	for (Reg r : { RBX, RBP, R12, R13, R14, R15, RDI })
+		e.Push(r);
+	e.Mov64(CPU, RDI);
+	if (memory)
+		e.Mov64Imm(PAGES, reinterpret_cast<uint64_t>(layout.readPages));
+	LoadRegisters();
+}
+
+void BlockCompiler::Epilogue() {
+	SaveRegisters(0);
+	for (Reg r : { RDI, R15, R14, R13, R12, RBP, RBX })
+		e.Pop(r);
+	e.Ret();
+}
+
+void BlockCompiler::SaveRegisters(int32_t extraCycles) {
+	e.StoreByte(CPU, Offset(layout.a), REG_A);
+	e.StoreByte(CPU, Offset(layout.x), REG_X);
+	e.StoreByte(CPU, Offset(layout.y), REG_Y);
+	e.Lea32(RAX, CYCLES, extraCycles);
+	e.Store32(CPU, Offset(layout.cycles), RAX);
+}
+
+void BlockCompiler::LoadRegisters() {
+	e.LoadByte(REG_A, CPU, Offset(layout.a));
+	e.LoadByte(REG_X, CPU, Offset(layout.x));
+	e.LoadByte(REG_Y, CPU, Offset(layout.y));
+	e.Load32(CYCLES, CPU, Offset(layout.cycles));
+}
+
+// Run an instruction through its predecoded handler, as the interpreter would after the opcode
+// fetch, leaving on error
+void BlockCompiler::CallHandler(int i) {
+	const JitCompiler::Step& step = steps[i];
+	SaveRegisters(1);
+	e.Store16Imm(CPU, Offset(layout.pc), static_cast<uint16_t>(step.pc + 1));
+	e.Store16Imm(CPU, Offset(layout.operand), step.operand);
+	e.Mov64(RDI, CPU);
+	e.Mov64Imm(RAX, reinterpret_cast<uint64_t>(step.handler));
+	e.CallRax();
+	LoadRegisters();
+	e.Cmp32Imm(CPU, Offset(layout.status), 0);
+	leaves.push_back(e.Jump(CC_NZ));
+}
+
+// Instructions without inline code. The handler leaves the program counter wherever the
+// instruction went
+BlockCompiler::Flow BlockCompiler::Fallback(int i) {
+	CallHandler(i);
+	const Operation& operation = steps[i].operation;
+	const bool jumps = (operation.instruction == Instruction::JMP || operation.instruction == Instruction::JSR) &&
+		operation.mode == ABSOLUTE;
+	return ends_block(operation.instruction) && !jumps ? Flow::LEAVE : Flow::NEXT;
+}
+
+void BlockCompiler::UpdateZN(Reg r) {
+	e.StoreByte(CPU, Offset(layout.lazyZ), r);
+	e.StoreByte(CPU, Offset(layout.lazyN), r);
+}
+
+// Copy C from a register holding 0 or 1
+void BlockCompiler::UpdateCarry(Reg r) {
+	e.AluByteImm(ALU_AND, CPU, Offset(layout.p), static_cast<uint8_t>(~0x01));
+	e.AluByte(ALU_OR, CPU, Offset(layout.p), r);
+}
+
+bool BlockCompiler::Readable(AddressMode mode) const {
+	switch (mode) {
+	case IMMEDIATE:
+		return true;
+	case ZERO_PAGE: case ABSOLUTE: case X_ZERO_PAGE: case Y_ZERO_PAGE: case X_ABSOLUTE: case Y_ABSOLUTE:
+		return memory;
+	default:
+		return false;
+	}
+}
+
+// Work out the effective address of an operand, into ecx if it is indexed
+Address BlockCompiler::Locate(AddressMode mode, uint16_t operand) {
+	switch (mode) {
+	case ZERO_PAGE:
+		return { Address::FIXED, static_cast<uint16_t>(operand & 0xFF), RAX };
+	case X_ZERO_PAGE:
+	case Y_ZERO_PAGE:
+	{
+		const Reg index = (mode == X_ZERO_PAGE) ? REG_X : REG_Y;
+		e.Lea32(RCX, index, operand & 0xFF);
+		e.ZeroExtend8(RCX, RCX);
+		return { Address::ZERO_PAGE_INDEXED, static_cast<uint16_t>(operand & 0xFF), index };
+	}
+	case X_ABSOLUTE:
+	case Y_ABSOLUTE:
+	{
+		const Reg index = (mode == X_ABSOLUTE) ? REG_X : REG_Y;
+		e.Lea32(RCX, index, operand);
+		e.ZeroExtend16(RCX, RCX);
+		e.Mov32(RAX, RCX);
+		e.Shift32(SHIFT_SHR, RAX, 8);
+		e.ZeroExtend8(RCX, RCX);
+		return { Address::INDEXED, operand, index };
+	}
+	default:
+		return { Address::FIXED, operand, RAX };
+	}
+}
+
+// Load the page table entry for an address, missing if the page is not mapped directly. Indexed
+// addresses have their page in eax and their offset in ecx
+void BlockCompiler::LoadPage(Reg dst, const Address& address, int32_t table) {
+	if (address.kind == Address::INDEXED)
+		e.LoadPointer(dst, PAGES, RAX, table);
+	else if (address.kind == Address::ZERO_PAGE_INDEXED)
+		e.LoadPointer(dst, PAGES, table);
+	else
+		e.LoadPointer(dst, PAGES, (address.addr >> 8) * 8 + table);
+	e.TestPointer(dst);
+	Miss(CC_Z);
+}
+
+void BlockCompiler::LoadAt(Reg dst, Reg page, const Address& address) {
+	if (address.kind == Address::FIXED)
+		e.LoadByte(dst, page, address.addr & 0xFF);
+	else
+		e.LoadByte(dst, page, RCX, 0);
+}
+
+void BlockCompiler::StoreAt(Reg page, const Address& address, Reg src) {
+	if (address.kind == Address::FIXED)
+		e.StoreByte(page, address.addr & 0xFF, src);
+	else
+		e.StoreByte(page, RCX, 0, src);
+}
+
+// Read the operand of an instruction into eax, counting the cycles it takes along with the
+// opcode fetch. An indexed read crossing a page adds its cycle at once
+void BlockCompiler::Fetch(int i, int& cycles) {
+	const JitCompiler::Step& step = steps[i];
+	const AddressMode mode = step.operation.mode;
+	if (mode == IMMEDIATE) {
+		e.Mov32Imm(RAX, step.operand & 0xFF);
+		cycles = 2;
+		return;
+	}
+
+	const Address address = Locate(mode, step.operand);
+	LoadPage(RDX, address, 0);
+	if (address.kind == Address::INDEXED) {
+		e.Lea32(RDI, address.index, address.addr & 0xFF);
+		e.Shift32(SHIFT_SHR, RDI, 8);
+		e.Alu32(ALU_ADD, CYCLES, RDI);
+	}
+	LoadAt(RAX, RDX, address);
+	cycles = (mode == ZERO_PAGE) ? 3 : 4;
+}
+
+BlockCompiler::Flow BlockCompiler::Emit(int i) {
+	const JitCompiler::Step& step = steps[i];
+	const Operation& operation = step.operation;
+	switch (operation.instruction) {
+	case Instruction::LDA: return Load(i, REG_A);
+	case Instruction::LDX: return Load(i, REG_X);
+	case Instruction::LDY: return Load(i, REG_Y);
+	case Instruction::STA: return Store(i, REG_A);
+	case Instruction::STX: return Store(i, REG_X);
+	case Instruction::STY: return Store(i, REG_Y);
+	case Instruction::AND: return Logic(i, ALU_AND);
+	case Instruction::EOR: return Logic(i, ALU_XOR);
+	case Instruction::ORA: return Logic(i, ALU_OR);
+	case Instruction::ADC: return Add(i, false);
+	case Instruction::SBC: return Add(i, true);
+	case Instruction::CMP: return Compare(i, REG_A);
+	case Instruction::CPX: return Compare(i, REG_X);
+	case Instruction::CPY: return Compare(i, REG_Y);
+	case Instruction::BIT: return Bit(i);
+	case Instruction::INC: case Instruction::DEC: case Instruction::ASL: case Instruction::LSR:
+	case Instruction::ROL: case Instruction::ROR:
+		return Modify(i);
+	case Instruction::BCC: case Instruction::BCS: case Instruction::BEQ: case Instruction::BMI:
+	case Instruction::BNE: case Instruction::BPL: case Instruction::BVC: case Instruction::BVS:
+		return Branch(i);
+	case Instruction::PHA: case Instruction::PLA: case Instruction::JSR: case Instruction::RTS:
+		return Stack(i);
+	case Instruction::JMP:
+		if (operation.mode != ABSOLUTE)
+			return Fallback(i);
+		AddCycles(3);
+		return Flow::NEXT;
+	default:
+		break;
+	}
+
+	// Implied register and flag instructions
+	if (operation.mode != IMPLIED)
+		return Fallback(i);
+	switch (operation.instruction) {
+	case Instruction::TAX: e.Mov32(REG_X, REG_A); UpdateZN(REG_X); break;
+	case Instruction::TAY: e.Mov32(REG_Y, REG_A); UpdateZN(REG_Y); break;
+	case Instruction::TXA: e.Mov32(REG_A, REG_X); UpdateZN(REG_A); break;
+	case Instruction::TYA: e.Mov32(REG_A, REG_Y); UpdateZN(REG_A); break;
+	case Instruction::TSX: e.LoadByte(REG_X, CPU, Offset(layout.sp)); UpdateZN(REG_X); break;
+	case Instruction::TXS: e.StoreByte(CPU, Offset(layout.sp), REG_X); break;
+	case Instruction::INX: e.Inc8(REG_X); UpdateZN(REG_X); break;
+	case Instruction::INY: e.Inc8(REG_Y); UpdateZN(REG_Y); break;
+	case Instruction::DEX: e.Dec8(REG_X); UpdateZN(REG_X); break;
+	case Instruction::DEY: e.Dec8(REG_Y); UpdateZN(REG_Y); break;
+	case Instruction::CLC: e.AluByteImm(ALU_AND, CPU, Offset(layout.p), static_cast<uint8_t>(~0x01)); break;
+	case Instruction::SEC: e.AluByteImm(ALU_OR, CPU, Offset(layout.p), 0x01); break;
+	case Instruction::CLD: e.AluByteImm(ALU_AND, CPU, Offset(layout.p), static_cast<uint8_t>(~0x08)); break;
+	case Instruction::SED: e.AluByteImm(ALU_OR, CPU, Offset(layout.p), 0x08); break;
+	case Instruction::CLV: e.AluByteImm(ALU_AND, CPU, Offset(layout.p), static_cast<uint8_t>(~0x40)); break;
+	case Instruction::NOP: break;
+	default:
+		return Fallback(i);
+	}
+	AddCycles(2);
+	return Flow::NEXT;
+}
+
+// LDA, LDX and LDY
+BlockCompiler::Flow BlockCompiler::Load(int i, Reg r) {
+	if (!Readable(steps[i].operation.mode))
+		return Fallback(i);
+	int cycles;
+	Fetch(i, cycles);
+	e.Mov32(r, RAX);
+	UpdateZN(r);
+	AddCycles(cycles);
+	return Flow::NEXT;
+}
+
+// STA, STX and STY
+BlockCompiler::Flow BlockCompiler::Store(int i, Reg r) {
+	const AddressMode mode = steps[i].operation.mode;
+	if (mode == IMMEDIATE || !Readable(mode))
+		return Fallback(i);
+	const Address address = Locate(mode, steps[i].operand);
+	LoadPage(RSI, address, writeTable);
+	StoreAt(RSI, address, r);
+	AddCycles((mode == ZERO_PAGE) ? 3 : (mode == X_ABSOLUTE || mode == Y_ABSOLUTE) ? 5 : 4);
+	return Flow::NEXT;
+}
+
+// AND, EOR and ORA
+BlockCompiler::Flow BlockCompiler::Logic(int i, Alu op) {
+	if (!Readable(steps[i].operation.mode))
+		return Fallback(i);
+	int cycles;
+	Fetch(i, cycles);
+	e.Alu8(op, REG_A, RAX);
+	UpdateZN(REG_A);
+	AddCycles(cycles);
+	return Flow::NEXT;
+}
+
+// ADC and SBC in binary mode, which map onto adc and sbb. The 6502 carry is the inverted x86 borrow
+// on the way in and out of a subtraction. x86 sets the overflow flag just as the 6502 sets V
+BlockCompiler::Flow BlockCompiler::Add(int i, bool subtract) {
+	if (!Readable(steps[i].operation.mode))
+		return Fallback(i);
+	e.TestByte(CPU, Offset(layout.p), 0x08);
+	Miss(CC_NZ);
+	int cycles;
+	Fetch(i, cycles);
+	e.LoadByte(RCX, CPU, Offset(layout.p));
+	e.Shift32(SHIFT_SHR, RCX, 1);
+	if (subtract)
+		e.Cmc();
+	e.Alu8(subtract ? ALU_SBB : ALU_ADC, REG_A, RAX);
+	e.Set(subtract ? CC_NC : CC_C, RCX);
+	e.Set(CC_O, RDX);
+	e.Shift8(SHIFT_SHL, RDX, 6);
+	e.Alu8(ALU_OR, RCX, RDX);
+	e.AluByteImm(ALU_AND, CPU, Offset(layout.p), static_cast<uint8_t>(~0x41));
+	e.AluByte(ALU_OR, CPU, Offset(layout.p), RCX);
+	UpdateZN(REG_A);
+	AddCycles(cycles);
+	return Flow::NEXT;
+}
+
+// CMP, CPX and CPY
+BlockCompiler::Flow BlockCompiler::Compare(int i, Reg r) {
+	if (!Readable(steps[i].operation.mode))
+		return Fallback(i);
+	int cycles;
+	Fetch(i, cycles);
+	e.Mov32(RCX, r);
+	e.Alu8(ALU_SUB, RCX, RAX);
+	e.Set(CC_NC, RDX);
+	UpdateZN(RCX);
+	UpdateCarry(RDX);
+	AddCycles(cycles);
+	return Flow::NEXT;
+}
+
+BlockCompiler::Flow BlockCompiler::Bit(int i) {
+	if (!Readable(steps[i].operation.mode))
+		return Fallback(i);
+	int cycles;
+	Fetch(i, cycles);
+	e.Mov32(RCX, REG_A);
+	e.Alu32(ALU_AND, RCX, RAX);
+	e.StoreByte(CPU, Offset(layout.lazyZ), RCX);
+	e.StoreByte(CPU, Offset(layout.lazyN), RAX);
+	e.Alu32Imm(ALU_AND, RAX, 0x40);
+	e.AluByteImm(ALU_AND, CPU, Offset(layout.p), static_cast<uint8_t>(~0x40));
+	e.AluByte(ALU_OR, CPU, Offset(layout.p), RAX);
+	AddCycles(cycles);
+	return Flow::NEXT;
+}
+
+// INC, DEC and the shifts and rotates, on the accumulator or in memory
+BlockCompiler::Flow BlockCompiler::Modify(int i) {
+	const JitCompiler::Step& step = steps[i];
+	const Instruction instruction = step.operation.instruction;
+	const AddressMode mode = step.operation.mode;
+	const bool accumulator = (mode == ACCUMULATOR);
+	if (!accumulator && (mode == IMMEDIATE || mode == Y_ZERO_PAGE || mode == Y_ABSOLUTE || !Readable(mode)))
+		return Fallback(i);
+
+	Address address{};
+	Reg value = REG_A;
+	if (!accumulator) {
+		address = Locate(mode, step.operand);
+		LoadPage(RDX, address, 0);
+		LoadPage(RSI, address, writeTable);
+		LoadAt(RAX, RDX, address);
+		value = RAX;
+	}
+
+	const bool shifts = (instruction != Instruction::INC && instruction != Instruction::DEC);
+	switch (instruction) {
+	case Instruction::INC: e.Inc8(value); break;
+	case Instruction::DEC: e.Dec8(value); break;
+	case Instruction::ASL: e.Shift8(SHIFT_SHL, value); break;
+	case Instruction::LSR: e.Shift8(SHIFT_SHR, value); break;
+	case Instruction::ROL:
+	case Instruction::ROR:
+		// Rotate through the 6502 carry
+		e.LoadByte(RDI, CPU, Offset(layout.p));
+		e.Shift32(SHIFT_SHR, RDI, 1);
+		e.Shift8((instruction == Instruction::ROL) ? SHIFT_RCL : SHIFT_RCR, value);
+		break;
+	default:
+		break;
+	}
+	if (shifts)
+		e.Set(CC_C, RDI);
+	if (!accumulator)
+		StoreAt(RSI, address, RAX);
+	if (shifts)
+		UpdateCarry(RDI);
+	UpdateZN(value);
+
+	switch (mode) {
+	case ACCUMULATOR: AddCycles(2); break;
+	case ZERO_PAGE:   AddCycles(5); break;
+	case X_ABSOLUTE:  AddCycles(7); break;
+	default:          AddCycles(6); break;
+	}
+	return Flow::NEXT;
+}
+
+// Relative branches end their block, and take one more cycle when taken and another when the
+// target is on a different page than the next instruction
+BlockCompiler::Flow BlockCompiler::Branch(int i) {
+	const JitCompiler::Step& step = steps[i];
+	AddCycles(2);
+	Cond taken = CC_NZ;
+	switch (step.operation.instruction) {
+	case Instruction::BCC: e.TestByte(CPU, Offset(layout.p), 0x01); taken = CC_Z; break;
+	case Instruction::BCS: e.TestByte(CPU, Offset(layout.p), 0x01); taken = CC_NZ; break;
+	case Instruction::BVC: e.TestByte(CPU, Offset(layout.p), 0x40); taken = CC_Z; break;
+	case Instruction::BVS: e.TestByte(CPU, Offset(layout.p), 0x40); taken = CC_NZ; break;
+	case Instruction::BEQ: e.TestByte(CPU, Offset(layout.lazyZ), 0xFF); taken = CC_Z; break;
+	case Instruction::BNE: e.TestByte(CPU, Offset(layout.lazyZ), 0xFF); taken = CC_NZ; break;
+	case Instruction::BMI: e.TestByte(CPU, Offset(layout.lazyN), 0x80); taken = CC_NZ; break;
+	case Instruction::BPL: e.TestByte(CPU, Offset(layout.lazyN), 0x80); taken = CC_Z; break;
+	default: break;
+	}
+	const size_t jump = e.Jump(taken);
+
+	const uint16_t next = step.pc + 2;
+	const uint16_t target = next + static_cast<int8_t>(step.operand);
+	Goto(next);
+	e.Patch(jump, e.Position());
+	AddCycles(((target >> 8) != (next >> 8)) ? 2 : 1);
+	Goto(target);
+	return Flow::DONE;
+}
+
+// PHA, PLA, JSR and RTS, through the stack page
+BlockCompiler::Flow BlockCompiler::Stack(int i) {
+	const JitCompiler::Step& step = steps[i];
+	const Instruction instruction = step.operation.instruction;
+	if (!memory || (instruction == Instruction::JSR && step.operation.mode != ABSOLUTE))
+		return Fallback(i);
+
+	const bool pushes = (instruction == Instruction::PHA || instruction == Instruction::JSR);
+	const Reg page = pushes ? RSI : RDX;
+	e.LoadPointer(page, PAGES, 0x01 * 8 + (pushes ? writeTable : 0));
+	e.TestPointer(page);
+	Miss(CC_Z);
+	e.LoadByte(RAX, CPU, Offset(layout.sp));
+
+	switch (instruction) {
+	case Instruction::PHA:
+		e.StoreByte(page, RAX, 0, REG_A);
+		e.Dec8(RAX);
+		e.StoreByte(CPU, Offset(layout.sp), RAX);
+		AddCycles(3);
+		return Flow::NEXT;
+	case Instruction::PLA:
+		e.Inc8(RAX);
+		e.LoadByte(REG_A, page, RAX, 0);
+		e.StoreByte(CPU, Offset(layout.sp), RAX);
+		UpdateZN(REG_A);
+		AddCycles(4);
+		return Flow::NEXT;
+	case Instruction::JSR:
+	{
+		// Push the address of the last byte of the instruction
+		const uint16_t last = step.pc + 2;
+		e.StoreByteImm(page, RAX, 0, static_cast<uint8_t>(last >> 8));
+		e.Dec8(RAX);
+		e.StoreByteImm(page, RAX, 0, static_cast<uint8_t>(last));
+		e.Dec8(RAX);
+		e.StoreByte(CPU, Offset(layout.sp), RAX);
+		AddCycles(6);
+		return Flow::NEXT;
+	}
+	default:
+		// RTS
+		e.Inc8(RAX);
+		e.LoadByte(RCX, page, RAX, 0);
+		e.Inc8(RAX);
+		e.LoadByte(RDI, page, RAX, 0);
+		e.StoreByte(CPU, Offset(layout.sp), RAX);
+		e.Shift32(SHIFT_SHL, RDI, 8);
+		e.Alu32(ALU_OR, RCX, RDI);
+		e.Alu32Imm(ALU_ADD, RCX, 1);
+		e.Store16(CPU, Offset(layout.pc), RCX);
+		AddCycles(6);
+		return Flow::LEAVE;
+	}
+}
+
+}
+
+JitCompiler::JitCompiler() {
+#ifdef JIT_X86_64
+	void* memory = mmap(nullptr, CODE_SIZE, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory != MAP_FAILED)
+		code = static_cast<uint8_t*>(memory);
+	const long size = sysconf(_SC_PAGESIZE);
+	if (size > 0)
+		pageSize = static_cast<size_t>(size);
+#endif
+}
+
+JitCompiler::~JitCompiler() {
+#ifdef JIT_X86_64
+	if (code)
+		munmap(code, CODE_SIZE);
+#endif
+}
+
+bool JitCompiler::Supported() {
+#ifdef JIT_X86_64
+	return true;
+#else
+	return false;
+#endif
+}
+
+void JitCompiler::Reset() {
+	used = 0;
+}
+
+JitCompiler::NativeBlock JitCompiler::Compile(const Layout& layout, const Step* steps, int count) {
+#ifdef JIT_X86_64
+	if (!code || count == 0)
+		return nullptr;
+
+	const std::vector<uint8_t> bytes = BlockCompiler(layout, steps, count).Compile();
+	if (used + bytes.size() > CODE_SIZE)
+		return nullptr;
+
+	// Keep the buffer W^X, making only the pages the new block lands on writable while it is
+	// copied in
+	uint8_t* entry = code + used;
+	uint8_t* first = code + (used & ~(pageSize - 1));
+	uint8_t* last = code + ((used + bytes.size() + pageSize - 1) & ~(pageSize - 1));
+	if (mprotect(first, last - first, PROT_READ | PROT_WRITE) != 0)
+		return nullptr;
+	std::memcpy(entry, bytes.data(), bytes.size());
+	used += bytes.size();
+	if (mprotect(first, last - first, PROT_READ | PROT_EXEC) != 0)
+		return nullptr;
+
+	return reinterpret_cast<NativeBlock>(entry);
+#else
+	(void) layout; (void) steps; (void) count;
+	return nullptr;
+#endif
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "instructions.h"
+#include <cstddef>
+#include <cstdint>
+
+// Native code generator for hot predecoded blocks
+//    Translates a block of predecoded instructions into x86-64 machine code. A, X, Y and the cycle
+//    count are held in registers for the whole block and the program counter is only written when
+//    the block is left, since the address of every instruction is known when it is compiled.
+//    Register transfers, loads and stores, arithmetic and logic, shifts, increments, flag changes,
+//    stack pushes and pulls, branches, JMP, JSR and RTS are generated inline. Memory is accessed
+//    through the bus page tables, and any access to a page without a direct mapping calls the
+//    instruction's predecoded handler instead, as does every other instruction. Branches and jumps
+//    back into the block loop without leaving native code.
+//    The generated code is only available on x86-64 System V platforms; elsewhere Supported()
+//    returns false and the CPU keeps interpreting.
+class JitCompiler
+{
+public:
+	using NativeBlock = void (*)(void* cpu);
+
+	// Where generated code finds the CPU and bus state
+	struct Layout {
+		// Byte offsets of the CPU fields
+		ptrdiff_t a;
+		ptrdiff_t x;
+		ptrdiff_t y;
+		ptrdiff_t sp;
+		ptrdiff_t p;
+		ptrdiff_t lazyZ;
+		ptrdiff_t lazyN;
+		ptrdiff_t cycles;
+		ptrdiff_t pc;
+		ptrdiff_t status;
+		ptrdiff_t limit;   // Cycle count at which to stop, re-read after every instruction
+		ptrdiff_t operand; // Predecoded operand the handlers take
+
+		// Bus page tables, one pointer per page or null to take the slow path. Without them
+		// every memory access goes through the handlers
+		const uint8_t* const* readPages;
+		uint8_t* const*       writePages;
+	};
+
+	// One instruction of the block
+	struct Step {
+		void*     handler; // Predecoded handler, called for whatever is not generated inline
+		Operation operation;
+		uint16_t  pc;      // Address of the opcode
+		uint16_t  operand;
+	};
+
+	JitCompiler();
+	~JitCompiler();
+
+	JitCompiler(const JitCompiler&) = delete;
+	JitCompiler& operator=(const JitCompiler&) = delete;
+
+	static bool Supported();
+
+	// Compile a block. Returns nullptr if the code buffer is full; call Reset and try again
+	NativeBlock Compile(const Layout& layout, const Step* steps, int count);
+
+	// Discard every compiled block
+	void Reset();
+
+private:
+	static constexpr size_t CODE_SIZE = 1024 * 1024;
+
+	uint8_t* code = nullptr;
+	size_t   used = 0;
+	size_t   pageSize = 4096;
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include "MOS6502.h"
+#include <cstddef>
+#include <cstdint>
+
+// Flat 64KB memory bus that logs every access in order
+//    Meant for checking the bus activity of single instructions, as the single-step conformance
+//    tests do. The log has a fixed capacity so logging never allocates; accesses past it are
+//    counted but not kept.
+class LogBus
+{
+public:
+	struct Access {
+		uint16_t addr;
+		uint8_t  data;
+		bool     write;
+	};
+
+	static constexpr size_t CAPACITY = 64;
+
+	LogBus() { cpu.ConnectBus(this); }
+
+	LogBus(const LogBus&) = delete;
+	LogBus& operator=(const LogBus&) = delete;
+
+public: // Components
+	MOS6502Core<LogBus> cpu;
+	uint8_t memory[64 * 1024] = {}; // 0x0000 - 0xFFFF
+
+public: // Access log
+	Access log[CAPACITY];
+	size_t logged = 0; // Accesses since the last ClearLog, including any past the capacity
+
+	void ClearLog() { logged = 0; }
+
+public: // Read and Write methods
+	void write(uint16_t addr, uint8_t data) {
+		Log(addr, data, true);
+		memory[addr] = data;
+	}
+	uint8_t read(uint16_t addr) {
+		Log(addr, memory[addr], false);
+		return memory[addr];
+	}
+	uint8_t Peek(uint16_t addr) const { return memory[addr]; }
+
+private:
+	void Log(uint16_t addr, uint8_t data, bool write) {
+		if (logged < CAPACITY)
+			log[logged] = { addr, data, write };
+		logged++;
+	}
+};
@@ -0,0 +1,129 @@
+#include "profiler.h"
+#include "decode.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <ostream>
+#include <string>
+
+namespace {
+	// Mnemonics in Instruction order
+	const char* const mnemonics[] = {
+		"LDA", "LDX", "LDY", "STA", "STX", "STY", "TAX", "TAY", "TXA", "TYA", "TSX", "TXS", "PHA", "PHP",
+		"PLA", "PLP", "AND", "EOR", "ORA", "BIT", "ADC", "SBC", "CMP", "CPX", "CPY", "INC", "INX", "INY",
+		"DEC", "DEX", "DEY", "ASL", "LSR", "ROL", "ROR", "JMP", "JSR", "RTS", "BCC", "BCS", "BEQ", "BMI",
+		"BNE", "BPL", "BVC", "BVS", "CLC", "CLD", "CLI", "CLV", "SEC", "SED", "SEI", "BRK", "NOP", "RTI",
+		"SLO", "RLA", "SRE", "RRA", "DCP", "ISC", "LAX", "SAX", "ANC", "ALR", "ARR", "SBX",
+		"???"
+	};
+	static_assert(std::size(mnemonics) == static_cast<size_t>(Instruction::INVALID) + 1);
+
+	std::string Hex(unsigned value, int digits) {
+		char text[8];
+		std::snprintf(text, sizeof(text), "$%0*X", digits, value);
+		return text;
+	}
+}
+
+Profiler::Profiler() : addresses(new Counter[0x10000]) {
+	frames.push_back({ 0, 0, 0 });
+}
+
+// Enter a subroutine or interrupt handler at the given address
+void Profiler::Call(uint16_t target) {
+	if (depth == MAX_DEPTH) {
+		untracked++;
+		return;
+	}
+
+	auto [it, added] = children.try_emplace({ frame, target }, static_cast<uint32_t>(frames.size()));
+	if (added)
+		frames.push_back({ frame, target, 0 });
+	frame = it->second;
+	depth++;
+}
+
+// Enter an interrupt handler, charging the cycles spent taking the interrupt to it
+void Profiler::Interrupt(uint16_t target, uint32_t cycles) {
+	Call(target);
+	frames[frame].cycles += cycles;
+}
+
+// Leave the current subroutine. Returns with no matching call, as when a program pushes its own
+// return address, leave the profile at the outermost frame
+void Profiler::Return() {
+	if (untracked > 0) {
+		untracked--;
+		return;
+	}
+	if (depth == 0)
+		return;
+
+	frame = frames[frame].parent;
+	depth--;
+}
+
+uint64_t Profiler::TotalCycles() const {
+	uint64_t total = 0;
+	for (const Counter& counter : opcodes)
+		total += counter.cycles;
+	return total;
+}
+
+void Profiler::WriteReport(std::ostream& out, size_t rows) const {
+	const uint64_t total = TotalCycles();
+	auto percent = [total](uint64_t cycles) { return total ? 100.0 * cycles / total : 0.0; };
+	auto line = [&out, &percent](const std::string& name, const Counter& counter) {
+		char text[96];
+		std::snprintf(text, sizeof(text), "  %-10s %14llu %14llu %6.2f%%\n", name.c_str(),
+			static_cast<unsigned long long>(counter.executions),
+			static_cast<unsigned long long>(counter.cycles), percent(counter.cycles));
+		out << text;
+	};
+
+	out << "Total cycles: " << total << "\n\n";
+
+	std::vector<int> ops;
+	for (int op = 0; op < 256; op++)
+		if (opcodes[op].executions)
+			ops.push_back(op);
+	std::stable_sort(ops.begin(), ops.end(), [this](int a, int b) { return opcodes[a].cycles > opcodes[b].cycles; });
+
+	out << "  Opcode         Executions         Cycles\n";
+	for (size_t i = 0; i < ops.size() && i < rows; i++) {
+		const Operation& operation = nmos_decode_table[ops[i]];
+		line(Hex(ops[i], 2) + " " + mnemonics[static_cast<size_t>(operation.instruction)], opcodes[ops[i]]);
+	}
+
+	std::vector<uint16_t> pcs;
+	for (uint32_t pc = 0; pc < 0x10000; pc++)
+		if (addresses[pc].executions)
+			pcs.push_back(static_cast<uint16_t>(pc));
+	std::stable_sort(pcs.begin(), pcs.end(), [this](uint16_t a, uint16_t b) { return addresses[a].cycles > addresses[b].cycles; });
+
+	out << "\n  Address        Executions         Cycles\n";
+	for (size_t i = 0; i < pcs.size() && i < rows; i++)
+		line(Hex(pcs[i], 4), addresses[pcs[i]]);
+}
+
+void Profiler::WriteCollapsed(std::ostream& out) const {
+	// Frames are only ever appended after their parent, so each name can be built from the parent's
+	std::vector<std::string> names(frames.size());
+	names[0] = "root";
+	for (size_t i = 1; i < frames.size(); i++)
+		names[i] = names[frames[i].parent] + ";" + Hex(frames[i].target, 4);
+
+	for (size_t i = 0; i < frames.size(); i++)
+		if (frames[i].cycles)
+			out << names[i] << ' ' << frames[i].cycles << '\n';
+}
+
+void Profiler::Clear() {
+	std::fill(std::begin(opcodes), std::end(opcodes), Counter{});
+	std::fill(addresses.get(), addresses.get() + 0x10000, Counter{});
+	frames.assign(1, { 0, 0, 0 });
+	children.clear();
+	frame = 0;
+	depth = 0;
+	untracked = 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Execution profile of an emulated program
+//    Counts executions and cycles per opcode and per instruction address in flat arrays, and
+//    attributes cycles to call stacks by following JSR/RTS, BRK/RTI and interrupts. The core only
+//    feeds a profiler when it is built with MOS6502_PROFILE; otherwise the hooks compile out.
+class Profiler
+{
+public:
+	Profiler();
+
+	struct Counter {
+		uint64_t executions = 0;
+		uint64_t cycles = 0;
+	};
+
+	// Calls nested deeper than this are charged to the deepest frame that is tracked
+	static constexpr size_t MAX_DEPTH = 64;
+
+public: // Recording, driven by the core
+	void Record(uint16_t pc, uint8_t opcode, uint32_t cycles) {
+		opcodes[opcode].executions++;
+		opcodes[opcode].cycles += cycles;
+		addresses[pc].executions++;
+		addresses[pc].cycles += cycles;
+		frames[frame].cycles += cycles;
+	}
+
+	void Call(uint16_t target);
+	void Interrupt(uint16_t target, uint32_t cycles);
+	void Return();
+
+public: // Results
+	const Counter& Opcode(uint8_t opcode) const { return opcodes[opcode]; }
+	const Counter& Address(uint16_t pc) const { return addresses[pc]; }
+	uint64_t TotalCycles() const;
+	size_t   Depth() const { return depth; }
+
+	// Opcodes and addresses sorted by the cycles spent in them, most expensive first
+	void WriteReport(std::ostream& out, size_t rows = 20) const;
+
+	// One line per call stack, "root;$C000;$C123 1234", as read by flamegraph.pl and speedscope
+	void WriteCollapsed(std::ostream& out) const;
+
+	void Clear();
+
+private:
+	// Call stacks are interned as a tree of frames, so the running stack is a single index
+	struct Frame {
+		uint32_t parent;
+		uint16_t target;
+		uint64_t cycles;
+	};
+
+	Counter opcodes[256];
+	std::unique_ptr<Counter[]> addresses; // 64K entries
+	std::vector<Frame> frames;
+	std::map<std::pair<uint32_t, uint16_t>, uint32_t> children;
+	uint32_t frame = 0;
+	size_t   depth = 0;
+	size_t   untracked = 0; // Calls made past MAX_DEPTH that have not returned yet
+};
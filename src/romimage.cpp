@@ -0,0 +1,74 @@
+#include "romimage.h"
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ROM_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+RomImage::~RomImage() {
+	Close();
+}
+
+void RomImage::Close() {
+#ifdef ROM_MMAP
+	if (mapping)
+		munmap(mapping, mappingSize);
+#endif
+	mapping = nullptr;
+	mappingSize = 0;
+	buffer.clear();
+	data = nullptr;
+	size = 0;
+}
+
+bool RomImage::Open(const std::string& path, bool allowMap) {
+	Close();
+
+#ifdef ROM_MMAP
+	if (allowMap) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void* memory = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (memory != MAP_FAILED) {
+				mapping = memory;
+				mappingSize = info.st_size;
+				data = static_cast<const uint8_t*>(memory);
+				size = info.st_size;
+			}
+		}
+		close(fd);
+
+		// Files that cannot be mapped (pipes, special files) are read instead
+		if (mapping)
+			return true;
+	}
+#endif
+
+	// Buffered fallback
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (file.bad() || contents.empty())
+		return false;
+	Assign(contents.data(), contents.size());
+	return true;
+}
+
+void RomImage::Assign(const uint8_t* bytes, size_t length) {
+	Close();
+	buffer.assign((length + 0xFF) & ~static_cast<size_t>(0xFF), 0x00);
+	if (length)
+		std::memcpy(buffer.data(), bytes, length);
+	data = buffer.data();
+	size = length;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only program image that can be mapped straight into a Bus's ROM pages
+//    Files are memory mapped where the platform allows it and read into a buffer otherwise. The
+//    data is always readable in whole 256-byte pages: a mapped file is zero-filled by the OS past
+//    its end, and a buffered image is zero-padded. The image must outlive every Bus it is mapped into.
+class RomImage
+{
+public:
+	RomImage() = default;
+	~RomImage();
+
+	RomImage(const RomImage&) = delete;
+	RomImage& operator=(const RomImage&) = delete;
+
+public:
+	// Load an image file, replacing any previous contents. Returns false if it cannot be read
+	bool Open(const std::string& path, bool allowMap = true);
+
+	// Take a copy of an in-memory image
+	void Assign(const uint8_t* data, size_t size);
+
+	const uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+	size_t Pages() const { return (size + 0xFF) >> 8; }
+	bool   Mapped() const { return mapping != nullptr; }
+
+private:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+	void*  mapping = nullptr; // Start of the file mapping, if mapped
+	size_t mappingSize = 0;
+	std::vector<uint8_t> buffer; // Backing storage when not mapped
+
+	void Close();
+};
@@ -0,0 +1,192 @@
+#include "savestate.h"
+#include <cstring>
+#include <memory>
+
+static constexpr char MAGIC[4] = { 'M', '6', '5', 'S' };
+
+// Little-endian field helpers
+template<typename T>
+static void Put(std::ostream& out, T value) {
+	uint8_t bytes[sizeof(T)];
+	for (size_t i = 0; i < sizeof(T); i++)
+		bytes[i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+	out.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+template<typename T>
+static bool Get(std::istream& in, T& value) {
+	uint8_t bytes[sizeof(T)];
+	if (!in.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+		return false;
+	uint64_t result = 0;
+	for (size_t i = 0; i < sizeof(T); i++)
+		result |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+	value = static_cast<T>(result);
+	return true;
+}
+
+// FNV-1a over every page of the snapshot
+uint64_t SaveState::Hash(const Snapshot& state) {
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (const auto& page : state.pages) {
+		for (uint8_t byte : *page) {
+			hash ^= byte;
+			hash *= 0x100000001B3ull;
+		}
+	}
+	return hash;
+}
+
+// PackBits: a control byte n < 128 is followed by n + 1 literal bytes, a control byte n >= 128 is
+// followed by one byte repeated n - 126 times
+size_t SaveState::Pack(const uint8_t* page, uint8_t* out) {
+	size_t length = 0;
+	size_t i = 0;
+	while (i < 256) {
+		size_t run = 1;
+		while (i + run < 256 && run < 129 && page[i + run] == page[i])
+			run++;
+
+		if (run >= 2) {
+			out[length++] = static_cast<uint8_t>(run + 126);
+			out[length++] = page[i];
+			i += run;
+			continue;
+		}
+
+		// Gather literals until the next run of at least three bytes
+		size_t start = i;
+		while (i < 256 && i - start < 128) {
+			if (i + 2 < 256 && page[i] == page[i + 1] && page[i] == page[i + 2])
+				break;
+			i++;
+		}
+		out[length++] = static_cast<uint8_t>(i - start - 1);
+		std::memcpy(&out[length], &page[start], i - start);
+		length += i - start;
+	}
+	return length;
+}
+
+bool SaveState::Unpack(const uint8_t* in, size_t length, uint8_t* page) {
+	size_t pos = 0;
+	size_t filled = 0;
+	while (pos < length) {
+		uint8_t control = in[pos++];
+		if (control < 128) {
+			size_t count = control + 1;
+			if (pos + count > length || filled + count > 256)
+				return false;
+			std::memcpy(&page[filled], &in[pos], count);
+			pos += count;
+			filled += count;
+		}
+		else {
+			size_t count = control - 126;
+			if (pos >= length || filled + count > 256)
+				return false;
+			std::memset(&page[filled], in[pos++], count);
+			filled += count;
+		}
+	}
+	return filled == 256;
+}
+
+void SaveState::Write(std::ostream& out, const Snapshot& state, const Snapshot* base) {
+	out.write(MAGIC, sizeof(MAGIC));
+	Put<uint16_t>(out, VERSION);
+	Put<uint16_t>(out, base ? FLAG_DELTA : 0);
+	if (base)
+		Put<uint64_t>(out, Hash(*base));
+
+	Put<uint16_t>(out, state.PC);
+	Put<uint8_t>(out, state.SP);
+	Put<uint8_t>(out, state.A);
+	Put<uint8_t>(out, state.X);
+	Put<uint8_t>(out, state.Y);
+	Put<uint8_t>(out, state.P);
+	Put<int32_t>(out, state.Cycles);
+	Put<int32_t>(out, state.status);
+	Put<uint64_t>(out, state.clock);
+	Put<uint32_t>(out, state.irqLines);
+	Put<uint8_t>(out, (state.nmiLine ? 1 : 0) | (state.nmiPending ? 2 : 0));
+	out.write(reinterpret_cast<const char*>(state.vectors.data()), state.vectors.size());
+
+	// Pages shared with the base are unchanged by construction, the rest are compared
+	auto changed = [&](int i) {
+		return !base || (state.pages[i] != base->pages[i] && *state.pages[i] != *base->pages[i]);
+	};
+
+	uint16_t count = 0;
+	for (int i = 0; i < Snapshot::PAGES; i++)
+		count += changed(i);
+	Put<uint16_t>(out, count);
+
+	uint8_t packed[258];
+	for (int i = 0; i < Snapshot::PAGES; i++) {
+		if (!changed(i))
+			continue;
+		size_t length = Pack(state.pages[i]->data(), packed);
+		Put<uint8_t>(out, static_cast<uint8_t>(i));
+		Put<uint16_t>(out, static_cast<uint16_t>(length));
+		out.write(reinterpret_cast<const char*>(packed), length);
+	}
+}
+
+bool SaveState::Read(std::istream& in, Snapshot& state, const Snapshot* base) {
+	char magic[sizeof(MAGIC)];
+	uint16_t version, flags;
+	if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+		return false;
+	if (!Get(in, version) || version != VERSION || !Get(in, flags))
+		return false;
+
+	bool delta = flags & FLAG_DELTA;
+	if (delta) {
+		uint64_t hash;
+		if (!base || !Get(in, hash) || hash != Hash(*base))
+			return false;
+	}
+
+	Snapshot result;
+	if (!Get(in, result.PC) || !Get(in, result.SP) || !Get(in, result.A) || !Get(in, result.X) ||
+	    !Get(in, result.Y) || !Get(in, result.P) || !Get(in, result.Cycles) || !Get(in, result.status))
+		return false;
+	uint8_t nmi;
+	if (!Get(in, result.clock) || !Get(in, result.irqLines) || !Get(in, nmi))
+		return false;
+	result.nmiLine = nmi & 1;
+	result.nmiPending = nmi & 2;
+	if (!in.read(reinterpret_cast<char*>(result.vectors.data()), result.vectors.size()))
+		return false;
+
+	if (delta)
+		result.pages = base->pages;
+
+	uint16_t count;
+	if (!Get(in, count))
+		return false;
+
+	uint8_t packed[258];
+	for (int n = 0; n < count; n++) {
+		uint8_t index;
+		uint16_t length;
+		if (!Get(in, index) || !Get(in, length) || index >= Snapshot::PAGES || length > sizeof(packed))
+			return false;
+		if (!in.read(reinterpret_cast<char*>(packed), length))
+			return false;
+
+		auto page = std::make_shared<Snapshot::Page>();
+		if (!Unpack(packed, length, page->data()))
+			return false;
+		result.pages[index] = std::move(page);
+	}
+
+	// A full save state must describe every page
+	for (const auto& page : result.pages)
+		if (!page)
+			return false;
+
+	state = std::move(result);
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "snapshot.h"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+// Binary save states
+//    A save state is a versioned, little-endian encoding of a Snapshot. Each memory page is
+//    compressed on its own with a PackBits style run-length coder as it is streamed out, so a
+//    writer never holds more than one page of output.
+//
+//    A delta save state only holds the pages that differ from a base snapshot, plus a hash of that
+//    base so it cannot be applied to the wrong one. Loading a delta shares the unchanged pages with
+//    the base instead of copying them.
+//
+//    Layout:
+//        "M65S" magic, u16 version, u16 flags (bit 0: delta)
+//        u64 base hash (delta only)
+//        u16 PC, u8 SP, A, X, Y, P, i32 Cycles, i32 status
+//        u64 clock, u32 IRQ lines, u8 NMI state (bit 0: line, bit 1: pending)
+//        u8 vectors[6]
+//        u16 page count, then per page: u8 page index, u16 packed length, packed bytes
+class SaveState
+{
+public:
+	static constexpr uint16_t VERSION = 1;
+	static constexpr uint16_t FLAG_DELTA = (1 << 0);
+
+public:
+	// Write a full save state, or when base is given only the pages that differ from it
+	static void Write(std::ostream& out, const Snapshot& state, const Snapshot* base = nullptr);
+
+	// Read a save state. A delta save state needs the snapshot it was written against. Returns
+	// false if the stream is truncated, corrupt, of an unknown version or made against another base
+	static bool Read(std::istream& in, Snapshot& state, const Snapshot* base = nullptr);
+
+	// Hash of a snapshot's memory, used to identify the base of a delta
+	static uint64_t Hash(const Snapshot& state);
+
+public:
+	// Run-length coding of a single page. Pack returns the packed length, at most 258 bytes
+	static size_t Pack(const uint8_t* page, uint8_t* out);
+	static bool   Unpack(const uint8_t* in, size_t length, uint8_t* page);
+};
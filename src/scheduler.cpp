@@ -0,0 +1,46 @@
+#include "scheduler.h"
+#include <algorithm>
+
+Scheduler::EventId Scheduler::Add(uint64_t when, Callback callback) {
+	EventId id = nextId++;
+	callbacks.emplace(id, std::move(callback));
+	heap.push_back({ when, id });
+	std::push_heap(heap.begin(), heap.end(), Later);
+	return id;
+}
+
+// Returns false if the event already ran or was cancelled
+bool Scheduler::Cancel(EventId id) {
+	if (!callbacks.erase(id))
+		return false;
+	Prune();
+	return true;
+}
+
+// Drop every pending event
+void Scheduler::Clear() {
+	heap.clear();
+	callbacks.clear();
+}
+
+void Scheduler::RunDue(uint64_t now) {
+	while (!heap.empty() && heap.front().when <= now) {
+		EventId id = heap.front().id;
+		std::pop_heap(heap.begin(), heap.end(), Later);
+		heap.pop_back();
+
+		auto it = callbacks.find(id);
+		Callback callback = std::move(it->second);
+		callbacks.erase(it);
+		callback();
+		Prune();
+	}
+}
+
+// Drop cancelled events from the top of the heap so Next is always a live event
+void Scheduler::Prune() {
+	while (!heap.empty() && !callbacks.count(heap.front().id)) {
+		std::pop_heap(heap.begin(), heap.end(), Later);
+		heap.pop_back();
+	}
+}
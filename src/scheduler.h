@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Queue of callbacks to run at future cycle counts
+//    Events are kept in a binary min-heap ordered by due time, with events due at the same cycle
+//    run in the order they were scheduled. Cancelled events stay in the heap until they reach the
+//    top, so cancelling is cheap.
+class Scheduler
+{
+public:
+	using EventId = uint64_t;
+	using Callback = std::function<void()>;
+
+	static constexpr uint64_t NEVER = UINT64_MAX;
+
+public:
+	EventId Add(uint64_t when, Callback callback);
+	bool    Cancel(EventId id);
+	void    Clear();
+
+	// Due time of the earliest pending event, or NEVER
+	uint64_t Next() const { return heap.empty() ? NEVER : heap.front().when; }
+	bool     Empty() const { return heap.empty(); }
+	size_t   Pending() const { return callbacks.size(); }
+
+	// Run every event due at or before the given time, including those scheduled by the callbacks
+	void RunDue(uint64_t now);
+
+private:
+	struct Event {
+		uint64_t when;
+		EventId  id;
+	};
+
+	std::vector<Event> heap;
+	std::unordered_map<EventId, Callback> callbacks;
+	EventId nextId = 1;
+
+	static bool Later(const Event& a, const Event& b) { return a.when != b.when ? a.when > b.when : a.id > b.id; }
+	void Prune();
+};
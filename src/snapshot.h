@@ -0,0 +1,47 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+
+// Captured state of a Bus and its CPU
+//    Memory is held as immutable 256-byte pages behind shared pointers. A snapshot taken from a
+//    system shares every page that has not changed since that system's previous snapshot or
+//    restore, so a family of snapshots forked from one state only stores the pages each one
+//    changed. Device state is not part of a snapshot.
+class Snapshot
+{
+public:
+	static constexpr int RAM_PAGES = 128; // 0x0000 - 0x7FFF
+	static constexpr int ROM_PAGES = 64;  // 0x8000 - 0xBFFF
+	static constexpr int PAGES = RAM_PAGES + ROM_PAGES;
+
+	using Page = std::array<uint8_t, 256>;
+
+	// Registers
+	uint16_t PC = 0;
+	uint8_t  SP = 0;
+	uint8_t  A = 0;
+	uint8_t  X = 0;
+	uint8_t  Y = 0;
+	uint8_t  P = 0;
+	int32_t  Cycles = 0;
+	int      status = 0;
+
+	// Timing and interrupt lines
+	uint64_t clock = 0;      // CPU Clock value
+	uint32_t irqLines = 0;   // IRQ sources asserting the line
+	bool     nmiLine = false;
+	bool     nmiPending = false;
+
+	// Memory, RAM pages first followed by ROM pages
+	std::array<std::shared_ptr<const Page>, PAGES> pages;
+	std::array<uint8_t, 6> vectors{};
+
+	// Number of pages whose storage is shared with another snapshot
+	int SharedPages(const Snapshot& other) const {
+		int shared = 0;
+		for (int i = 0; i < PAGES; i++)
+			shared += (pages[i] == other.pages[i]);
+		return shared;
+	}
+};
@@ -0,0 +1,178 @@
+#include "timetravel.h"
+#include "bus.h"
+#include <algorithm>
+#include <climits>
+
+TimeTravel::TimeTravel(Bus& system, uint64_t interval, size_t maxCheckpoints)
+	: system(system), interval(std::max<uint64_t>(interval, 1)), maxCheckpoints(std::max<size_t>(maxCheckpoints, 2)) {
+	system.cpu.RecordInputs(&log);
+	checkpoints.push_back({ system.TakeSnapshot(), log.End() });
+	ScheduleCheckpoint();
+}
+
+TimeTravel::~TimeTravel() {
+	system.cpu.CancelEvent(checkpointEvent);
+	system.cpu.CancelEvent(presentEvent);
+	if (past)
+		system.cpu.ReplayInputs(nullptr);
+	else
+		system.cpu.RecordInputs(nullptr);
+}
+
+uint64_t TimeTravel::Present() const {
+	return past ? present : system.cpu.Clock();
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      CHECKPOINTS                                                                              CHECKPOINTS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+void TimeTravel::ScheduleCheckpoint() {
+	uint64_t when = std::max(checkpoints.back().state.clock + interval, system.cpu.Clock());
+	checkpointEvent = system.cpu.ScheduleAt(when, [this] { TakeCheckpoint(); });
+}
+
+// Runs as a scheduled event. History that is being replayed already has its checkpoints
+void TimeTravel::TakeCheckpoint() {
+	if (!past && system.cpu.Clock() >= checkpoints.back().state.clock + interval) {
+		checkpoints.push_back({ system.TakeSnapshot(), log.End() });
+		if (checkpoints.size() > maxCheckpoints)
+			Thin();
+	}
+	ScheduleCheckpoint();
+}
+
+// Drop every other checkpoint, keeping the first, and double the interval to match
+void TimeTravel::Thin() {
+	size_t kept = 0;
+	for (size_t i = 0; i < checkpoints.size(); i += 2)
+		checkpoints[kept++] = std::move(checkpoints[i]);
+	checkpoints.resize(kept);
+	interval *= 2;
+}
+
+const TimeTravel::Checkpoint& TimeTravel::Before(uint64_t cycle) const {
+	auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(), cycle,
+		[](uint64_t value, const Checkpoint& checkpoint) { return value < checkpoint.state.clock; });
+	return *std::prev(it);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      NAVIGATION                                                                                NAVIGATION      */
+/*----------------------------------------------------------------------------------------------------------------*/
+// Return to a checkpoint and start replaying the inputs logged after it
+void TimeTravel::Restore(const Checkpoint& checkpoint) {
+	if (!past) {
+		present = system.cpu.Clock();
+		past = true;
+		system.cpu.RecordInputs(nullptr);
+	}
+	system.cpu.CancelEvent(presentEvent);
+	presentEvent = 0;
+
+	system.cpu.ReplayInputs(nullptr);
+	system.Restore(checkpoint.state);
+	system.cpu.ReplayInputs(&log, checkpoint.inputs);
+}
+
+void TimeTravel::RunTo(uint64_t cycle) {
+	while (system.cpu.Clock() < cycle && system.cpu.status == 0)
+		system.cpu.Run(static_cast<int32_t>(std::min<uint64_t>(cycle - system.cpu.Clock(), INT32_MAX)));
+}
+
+// Execute one instruction, or take one interrupt
+void TimeTravel::Step() {
+	system.cpu.Run(1);
+}
+
+// Go back to recording once the system reaches the present, straight away if it is there already
+void TimeTravel::Arrive() {
+	auto resume = [this] {
+		presentEvent = 0;
+		past = false;
+		system.cpu.ReplayInputs(nullptr);
+		system.cpu.RecordInputs(&log);
+	};
+
+	if (system.cpu.Clock() >= present)
+		resume();
+	else
+		presentEvent = system.cpu.ScheduleAt(present, resume);
+}
+
+bool TimeTravel::Seek(uint64_t cycle) {
+	if (cycle < Start() || cycle > Present())
+		return false;
+
+	// Carry on from where the system is when no checkpoint lies between it and the target
+	const uint64_t now = system.cpu.Clock();
+	if (cycle == now)
+		return true;
+	if (!past || cycle < now || Before(cycle).state.clock > now)
+		Restore(Before(cycle));
+
+	RunTo(cycle);
+	Arrive();
+	return true;
+}
+
+bool TimeTravel::ReverseStep() {
+	const uint64_t now = system.cpu.Clock();
+	if (now <= Start())
+		return false;
+
+	// Find the boundary before this one, then go back to it
+	Restore(Before(now - 1));
+	uint64_t previous = system.cpu.Clock();
+	while (system.cpu.status == 0) {
+		uint64_t boundary = system.cpu.Clock();
+		Step();
+		if (system.cpu.Clock() >= now) {
+			previous = boundary;
+			break;
+		}
+	}
+
+	Restore(Before(previous));
+	RunTo(previous);
+	Arrive();
+	return true;
+}
+
+bool TimeTravel::ReverseContinue(const std::function<bool()>& condition) {
+	const uint64_t now = system.cpu.Clock();
+	if (now <= Start())
+		return false;
+
+	// Search the span up to now from its last checkpoint, then each earlier span in turn
+	size_t index = &Before(now - 1) - checkpoints.data();
+	uint64_t limit = now;
+	for (;;) {
+		Restore(checkpoints[index]);
+
+		bool found = false;
+		uint64_t match = 0;
+		while (system.cpu.Clock() < limit && system.cpu.status == 0) {
+			if (condition()) {
+				found = true;
+				match = system.cpu.Clock();
+			}
+			Step();
+		}
+
+		if (found) {
+			Restore(Before(match));
+			RunTo(match);
+			Arrive();
+			return true;
+		}
+		if (index == 0)
+			break;
+		limit = checkpoints[index].state.clock;
+		index--;
+	}
+
+	Restore(Before(now));
+	RunTo(now);
+	Arrive();
+	return false;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "inputlog.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class Bus;
+
+// Reverse execution for a Bus
+//    While attached, a checkpoint snapshot is taken every interval cycles of Run and every external
+//    input is recorded. Moving to an earlier cycle restores the nearest checkpoint at or before it
+//    and runs forward, replaying the recorded inputs, until it is reached.
+//
+//    Positions are instruction boundaries. Seeking to a cycle inside an instruction stops at the
+//    end of it. While the system is behind the present it replays; running it up to the present
+//    switches it back to recording, so a session can go back, inspect and carry on.
+//
+//    To keep memory bounded on long runs, whenever the checkpoint limit is reached every other
+//    checkpoint is dropped and the interval doubles, so the cost of a seek grows with the
+//    length of the run rather than memory. Checkpoints share unchanged pages with each other.
+//
+//    Only inputs through devices and the interrupt lines are replayed. Scheduled callbacks that
+//    change memory or registers directly make history diverge, and a replayed device read that
+//    no longer matches stops Run with E_DESYNC.
+class TimeTravel
+{
+public:
+	static constexpr uint64_t DEFAULT_INTERVAL = 100000;
+	static constexpr size_t   DEFAULT_CHECKPOINTS = 256;
+
+	// Attach to a system, starting the history at its current state
+	explicit TimeTravel(Bus& system, uint64_t interval = DEFAULT_INTERVAL, size_t maxCheckpoints = DEFAULT_CHECKPOINTS);
+	~TimeTravel();
+
+	TimeTravel(const TimeTravel&) = delete;
+	TimeTravel& operator=(const TimeTravel&) = delete;
+
+public: // History
+	uint64_t Start() const { return checkpoints.front().state.clock; }
+	uint64_t Present() const;
+	bool     InPast() const { return past; }
+
+	size_t   Checkpoints() const { return checkpoints.size(); }
+	uint64_t Interval() const { return interval; }
+	const InputLog& Inputs() const { return log; }
+
+public: // Navigation, between runs
+	// Move to the first instruction boundary at or after the given cycle. Returns false if the cycle
+	// is outside the history
+	bool Seek(uint64_t cycle);
+
+	// Move back to the start of the instruction before the current one
+	bool ReverseStep();
+
+	// Move back to the latest earlier instruction boundary at which the condition holds. Returns
+	// false, leaving the system where it was, if it never held
+	bool ReverseContinue(const std::function<bool()>& condition);
+
+private:
+	struct Checkpoint {
+		Snapshot state;
+		InputLog::Position inputs; // End of the log when the snapshot was taken
+	};
+
+	Bus&     system;
+	uint64_t interval;
+	size_t   maxCheckpoints;
+
+	std::vector<Checkpoint> checkpoints;
+	InputLog log;
+
+	bool     past = false;
+	uint64_t present = 0;  // Clock value at which recording stopped, while in the past
+
+	Scheduler::EventId checkpointEvent = 0;
+	Scheduler::EventId presentEvent = 0;
+
+	void TakeCheckpoint();
+	void ScheduleCheckpoint();
+	void Thin();
+
+	const Checkpoint& Before(uint64_t cycle) const; // Latest checkpoint at or before the cycle
+	void Restore(const Checkpoint& checkpoint);
+	void RunTo(uint64_t cycle);
+	void Step();
+	void Arrive();
+};
@@ -0,0 +1,105 @@
+#include "trace.h"
+#include <algorithm>
+#include <bit>
+#include <ostream>
+
+Trace::Trace(size_t capacity) {
+	capacity = std::bit_ceil(std::max(capacity, 2 * CHUNK_ENTRIES));
+	buffer.reset(new Entry[capacity]);
+	mask = capacity - 1;
+}
+
+Trace::~Trace() {
+	StopStreaming();
+}
+
+std::vector<Trace::Entry> Trace::Entries() const {
+	std::vector<Entry> entries;
+	entries.reserve(Size());
+	for (uint64_t i = head - Size(); i < head; i++)
+		entries.push_back(buffer[i & mask]);
+	return entries;
+}
+
+void Trace::Dump(std::ostream& out) const {
+	std::vector<Entry> entries = Entries();
+	out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+}
+
+// Forget every entry. Not valid while streaming
+void Trace::Clear() {
+	head = 0;
+	published = 0;
+	written = 0;
+}
+
+bool Trace::StreamTo(const std::string& path) {
+	StopStreaming();
+
+	file = std::fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+
+	published = head;
+	written = head;
+	stopping = false;
+	writer = std::thread(&Trace::WriteLoop, this);
+	return true;
+}
+
+// Write out everything recorded so far and close the file
+void Trace::StopStreaming() {
+	if (!writer.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		published = head;
+		stopping = true;
+	}
+	changed.notify_all();
+	writer.join();
+
+	std::fclose(file);
+	file = nullptr;
+}
+
+// Hand the entries recorded so far to the writer, and wait for it if the chunk about to be filled
+// still holds entries it has not written
+void Trace::Publish() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		published = head;
+	}
+	changed.notify_all();
+
+	if (head + CHUNK_ENTRIES - written > Capacity()) {
+		std::unique_lock<std::mutex> guard(lock);
+		changed.wait(guard, [this] { return head + CHUNK_ENTRIES - written <= Capacity(); });
+	}
+}
+
+void Trace::WriteLoop() {
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;) {
+		changed.wait(guard, [this] { return stopping || published > written; });
+		const uint64_t from = written;
+		const uint64_t to = published;
+		if (from == to)
+			break;
+
+		// The range may wrap around the end of the buffer, in which case it is written in two parts
+		guard.unlock();
+		for (uint64_t i = from; i < to;) {
+			const size_t offset = static_cast<size_t>(i & mask);
+			const size_t count = static_cast<size_t>(std::min<uint64_t>(to - i, Capacity() - offset));
+			std::fwrite(&buffer[offset], sizeof(Entry), count, file);
+			i += count;
+		}
+		guard.lock();
+
+		written = to;
+		changed.notify_all();
+	}
+	std::fflush(file);
+}
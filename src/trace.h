@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Execution trace kept in a fixed-size ring buffer
+//    The core appends one packed entry per instruction, before executing it, so the buffer always
+//    holds the most recent instructions and can be dumped after a failure. Optionally a background
+//    thread streams the buffer to a file a chunk at a time as it fills, giving a complete trace.
+class Trace
+{
+public:
+	// State of the CPU as it starts an instruction
+	struct Entry {
+		uint32_t cycleLow;    // Clock, low 32 bits
+		uint16_t cycleHigh;   // Clock, bits 32 - 47
+		uint16_t pc;
+		uint8_t  opcode;
+		uint8_t  operands[2]; // The two bytes following the opcode, whether or not it uses them
+		uint8_t  A;
+		uint8_t  X;
+		uint8_t  Y;
+		uint8_t  SP;
+		uint8_t  P;
+
+		uint64_t Cycle() const { return (static_cast<uint64_t>(cycleHigh) << 32) | cycleLow; }
+	};
+	static_assert(sizeof(Entry) == 16);
+
+	// Entries in one streamed chunk, and the smallest buffer accepted
+	static constexpr size_t CHUNK_ENTRIES = 4096;
+
+	// The capacity is rounded up to a power of two of at least two chunks
+	explicit Trace(size_t capacity);
+	~Trace();
+
+	Trace(const Trace&) = delete;
+	Trace& operator=(const Trace&) = delete;
+
+public: // Recording, driven by the core
+	Entry& Next() {
+		if ((head & (CHUNK_ENTRIES - 1)) == 0 && writer.joinable())
+			Publish();
+		return buffer[head++ & mask];
+	}
+
+public: // Results
+	size_t   Capacity() const { return mask + 1; }
+	uint64_t Recorded() const { return head; }
+	size_t   Size() const { return head < Capacity() ? static_cast<size_t>(head) : Capacity(); }
+
+	// Retained entries, oldest first
+	std::vector<Entry> Entries() const;
+
+	// Write the retained entries as raw Entry records, oldest first
+	void Dump(std::ostream& out) const;
+
+	void Clear();
+
+public: // Streaming
+	//    Every entry recorded while streaming is written to the file in order. If the writer falls a
+	//    whole buffer behind, recording waits for it rather than losing entries. Returns false if the
+	//    file cannot be created.
+	bool StreamTo(const std::string& path);
+	void StopStreaming();
+
+private:
+	std::unique_ptr<Entry[]> buffer;
+	size_t   mask;
+	uint64_t head = 0; // Entries recorded
+
+	std::thread             writer;
+	std::FILE*              file = nullptr;
+	std::mutex              lock;
+	std::condition_variable changed;
+	std::atomic<uint64_t>   published{ 0 }; // Entries handed to the writer
+	std::atomic<uint64_t>   written{ 0 };   // Entries the writer is done with
+	bool                    stopping = false;
+
+	void Publish();   // Called before starting a chunk, once the previous one is complete
+	void WriteLoop();
+};
@@ -2,6 +2,7 @@
 #include "MOS6502.h"
 #include "bus.h"
 #include "instructions.h"
+#include <utility>
 
 /*----------------------------------------------------------------------------------------------------------------*/
 /*      ADC                                                                                              ADC      */
@@ -507,7 +508,7 @@ TEST(SBC_TEST, Immediate) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -530,7 +531,7 @@ TEST(SBC_TEST, ZeroPage) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -554,7 +555,7 @@ TEST(SBC_TEST, ZeroPageX) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -578,7 +579,7 @@ TEST(SBC_TEST, ZeroPageX_WithWrapAround) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -602,7 +603,7 @@ TEST(SBC_TEST, Absolute) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8003);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -627,7 +628,7 @@ TEST(SBC_TEST, AbsoluteX) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8003);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -652,7 +653,7 @@ TEST(SBC_TEST, AbsoluteX_WithPageCross) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8003);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -677,7 +678,7 @@ TEST(SBC_TEST, AbsoluteY) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8003);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -702,7 +703,7 @@ TEST(SBC_TEST, AbsoluteY_WithPageCross) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8003);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -728,7 +729,7 @@ TEST(SBC_TEST, IndirectX) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -754,7 +755,7 @@ TEST(SBC_TEST, IndirectX_WithWrapAround) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -780,7 +781,7 @@ TEST(SBC_TEST, IndirectY) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -806,7 +807,7 @@ TEST(SBC_TEST, IndirectY_WithPageCross) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -828,7 +829,7 @@ TEST(SBC_TEST, SetsZeroFlag) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, system.cpu.Z);
+	EXPECT_EQ(system.cpu.P, system.cpu.C | system.cpu.Z);
 	EXPECT_EQ(system.cpu.A, 0);
 }
 
@@ -851,7 +852,7 @@ TEST(SBC_TEST, ClearsZeroFlag) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x23);
 }
 
@@ -873,7 +874,7 @@ TEST(SBC_TEST, SetsNegativeFlag) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, system.cpu.N);
+	EXPECT_EQ(system.cpu.P, system.cpu.C | system.cpu.N);
 	EXPECT_EQ(system.cpu.A, 0x81);
 }
 
@@ -896,7 +897,7 @@ TEST(SBC_TEST, ClearsNegativeFlag) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x10);
 }
 
@@ -905,7 +906,7 @@ TEST(SBC_TEST, SetsCarryFlag) {
 
 	// Initialize system
 	Bus system;
-	system.cpu.A = 0x20;
+	system.cpu.A = 0x40;
 	system.cpu.P |= system.cpu.C;
 
 	// Initialize memory
@@ -918,8 +919,8 @@ TEST(SBC_TEST, SetsCarryFlag) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, system.cpu.C | system.cpu.N);
-	EXPECT_EQ(system.cpu.A, 0xF0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
+	EXPECT_EQ(system.cpu.A, 0x10);
 }
 
 TEST(SBC_TEST, ClearsCarryFlag) {
@@ -927,7 +928,7 @@ TEST(SBC_TEST, ClearsCarryFlag) {
 
 	// Initialize system
 	Bus system;
-	system.cpu.A = 0x40;
+	system.cpu.A = 0x20;
 	system.cpu.P |= system.cpu.C;
 
 	// Initialize memory
@@ -940,8 +941,8 @@ TEST(SBC_TEST, ClearsCarryFlag) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
-	EXPECT_EQ(system.cpu.A, 0x10);
+	EXPECT_EQ(system.cpu.P, system.cpu.N);
+	EXPECT_EQ(system.cpu.A, 0xF0);
 }
 
 TEST(SBC_TEST, SetsOverflowFlag) {
@@ -962,7 +963,7 @@ TEST(SBC_TEST, SetsOverflowFlag) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, system.cpu.V);
+	EXPECT_EQ(system.cpu.P, system.cpu.C | system.cpu.V);
 	EXPECT_EQ(system.cpu.A, 0x71);
 }
 
@@ -985,10 +986,150 @@ TEST(SBC_TEST, ClearsOverflowFlag) {
 	// Check test correctness
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8002);
-	EXPECT_EQ(system.cpu.P, 0);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
 	EXPECT_EQ(system.cpu.A, 0x10);
 }
 
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      DECIMAL                                                                                      DECIMAL      */
+/*----------------------------------------------------------------------------------------------------------------*/
+// Straightforward NMOS decimal ADC, returning the accumulator and the N, V, Z and C flags
+static std::pair<uint8_t, uint8_t> ReferenceDecimalAdc(uint8_t a, uint8_t m, bool carry) {
+	int low = (a & 0x0F) + (m & 0x0F) + carry;
+	if (low >= 0x0A)
+		low = ((low + 0x06) & 0x0F) + 0x10;
+	int sum = (a & 0xF0) + (m & 0xF0) + low;
+	int signedSum = static_cast<int8_t>(a & 0xF0) + static_cast<int8_t>(m & 0xF0) + low;
+
+	uint8_t flags = 0;
+	if (sum & 0x80)
+		flags |= MOS6502::N;
+	if (signedSum < -128 || signedSum > 127)
+		flags |= MOS6502::V;
+	if (((a + m + carry) & 0xFF) == 0)
+		flags |= MOS6502::Z;
+	if (sum >= 0xA0)
+		sum += 0x60;
+	if (sum >= 0x100)
+		flags |= MOS6502::C;
+	return { static_cast<uint8_t>(sum), flags };
+}
+
+// Straightforward NMOS decimal SBC result and flags. The flags are those of the binary subtraction,
+//    with C set when there is no borrow
+static std::pair<uint8_t, uint8_t> ReferenceDecimalSbc(uint8_t a, uint8_t m, bool carry) {
+	int low = (a & 0x0F) - (m & 0x0F) + carry - 1;
+	if (low < 0)
+		low = ((low - 0x06) & 0x0F) - 0x10;
+	int difference = (a & 0xF0) - (m & 0xF0) + low;
+	if (difference < 0)
+		difference -= 0x60;
+
+	int binary = a - m - !carry;
+	uint8_t flags = 0;
+	if (binary & 0x80)
+		flags |= MOS6502::N;
+	if ((a ^ m) & (a ^ binary) & 0x80)
+		flags |= MOS6502::V;
+	if ((binary & 0xFF) == 0)
+		flags |= MOS6502::Z;
+	if (binary >= 0)
+		flags |= MOS6502::C;
+	return { static_cast<uint8_t>(difference), flags };
+}
+
+TEST(ADC_TEST, DecimalImmediate) {
+	// 2 Bytes, 2 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.A = 0x58;
+	system.cpu.P = system.cpu.D | system.cpu.C;
+
+	// Initialize memory
+	system.rom[0] = INS_ADC_IM;
+	system.rom[1] = 0x46;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(2);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	EXPECT_EQ(system.cpu.P, system.cpu.D | system.cpu.C | system.cpu.N | system.cpu.V); // N and V from the unadjusted 0xA5
+	EXPECT_EQ(system.cpu.A, 0x05);
+}
+
+TEST(SBC_TEST, DecimalImmediate) {
+	// 2 Bytes, 2 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.A = 0x46;
+	system.cpu.P = system.cpu.D | system.cpu.C;
+
+	// Initialize memory
+	system.rom[0] = INS_SBC_IM;
+	system.rom[1] = 0x12;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(2);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	EXPECT_EQ(system.cpu.P, system.cpu.D | system.cpu.C);
+	EXPECT_EQ(system.cpu.A, 0x34);
+}
+
+TEST(ADC_TEST, DecimalMatchesReferenceForAllOperands) {
+	// Initialize system
+	Bus system;
+
+	// Initialize memory
+	system.rom[0] = INS_ADC_ZP;
+	system.rom[1] = 0x10;
+
+	// Check test correctness
+	for (int carry = 0; carry < 2; carry++)
+		for (int a = 0; a < 256; a++)
+			for (int m = 0; m < 256; m++) {
+				system.cpu.PC = 0x8000;
+				system.cpu.A = static_cast<uint8_t>(a);
+				system.cpu.P = system.cpu.D | (carry ? system.cpu.C : 0);
+				system.ram[0x10] = static_cast<uint8_t>(m);
+				system.cpu.Run(3);
+
+				auto [result, flags] = ReferenceDecimalAdc(a, m, carry);
+				ASSERT_EQ(system.cpu.A, result) << a << " + " << m << " + " << carry;
+				ASSERT_EQ(system.cpu.P, system.cpu.D | flags) << a << " + " << m << " + " << carry;
+			}
+}
+
+TEST(SBC_TEST, DecimalMatchesReferenceForAllOperands) {
+	// Initialize system
+	Bus system;
+
+	// Initialize memory
+	system.rom[0] = INS_SBC_ZP;
+	system.rom[1] = 0x10;
+
+	// Check test correctness
+	for (int carry = 0; carry < 2; carry++)
+		for (int a = 0; a < 256; a++)
+			for (int m = 0; m < 256; m++) {
+				system.cpu.PC = 0x8000;
+				system.cpu.A = static_cast<uint8_t>(a);
+				system.cpu.P = system.cpu.D | (carry ? system.cpu.C : 0);
+				system.ram[0x10] = static_cast<uint8_t>(m);
+				system.cpu.Run(3);
+
+				auto [result, flags] = ReferenceDecimalSbc(a, m, carry);
+				ASSERT_EQ(system.cpu.A, result) << a << " - " << m << " - " << !carry;
+				ASSERT_EQ(system.cpu.P, system.cpu.D | flags) << a << " - " << m << " - " << !carry;
+			}
+}
+
 /*----------------------------------------------------------------------------------------------------------------*/
 /*      CMP                                                                                              CMP      */
 /*----------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+#include "batch.h"
+#include "flatbus.h"
+#include "instructions.h"
+#include "exitcodes.h"
+#include <algorithm>
+#include <vector>
+
+// Run a program on a lone FlatBus instance and compare it against one lane of a batch
+static void ExpectLaneMatchesScalar(CpuBatch& batch, int lane, const std::vector<uint8_t>& program,
+                                    uint8_t a, uint8_t p, uint8_t data, int32_t cycles) {
+	FlatBus system;
+	std::copy(program.begin(), program.end(), system.memory + 0x8000);
+	system.memory[0x10] = data;
+	system.cpu.A = a;
+	system.cpu.P = p;
+	system.cpu.Run(cycles);
+
+	EXPECT_EQ(batch.PC[lane], system.cpu.PC) << "lane " << lane;
+	EXPECT_EQ(batch.A[lane], system.cpu.A) << "lane " << lane;
+	EXPECT_EQ(batch.X[lane], system.cpu.X) << "lane " << lane;
+	EXPECT_EQ(batch.Y[lane], system.cpu.Y) << "lane " << lane;
+	EXPECT_EQ(batch.SP[lane], system.cpu.SP) << "lane " << lane;
+	EXPECT_EQ(batch.P[lane], system.cpu.P) << "lane " << lane;
+	EXPECT_EQ(batch.Cycles[lane], system.cpu.Cycles) << "lane " << lane;
+	EXPECT_EQ(batch.Ram(lane)[0x11], system.memory[0x11]) << "lane " << lane;
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      BATCH                                                                                          BATCH      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(BATCH_TEST, ArithmeticKernelsMatchScalarCore) {
+	// Initialize program
+	const std::vector<uint8_t> program = {
+		INS_ADC_IM, 0x37,
+		INS_TAX,
+		INS_SBC_IM, 0x80,
+		INS_CMP_IM, 0x10,
+		INS_EOR_IM, 0x5A,
+		INS_CPX_IM, 0x40,
+		INS_DEX,
+		INS_INY,
+		INS_TXA,
+		INS_ORA_IM, 0x01,
+		INS_AND_IM, 0xF3,
+	};
+
+	// Initialize system
+	CpuBatch batch(256);
+	std::copy(program.begin(), program.end(), batch.rom);
+	for (int lane = 0; lane < batch.Size(); lane++) {
+		batch.A[lane] = static_cast<uint8_t>(lane);
+		batch.P[lane] = static_cast<uint8_t>(lane) & 0b11000011;
+	}
+
+	// Run the expected number of cycles
+	batch.Run(22);
+
+	// Check test correctness
+	EXPECT_GT(batch.vectorSteps, 0u);
+	EXPECT_EQ(batch.scalarSteps, 0u);
+	for (int lane = 0; lane < batch.Size(); lane++)
+		ExpectLaneMatchesScalar(batch, lane, program, static_cast<uint8_t>(lane), static_cast<uint8_t>(lane) & 0b11000011, 0xFF, 22);
+}
+
+TEST(BATCH_TEST, DivergentLanesMatchScalarCore) {
+	// Initialize program
+	const std::vector<uint8_t> program = {
+		INS_LDA_ZP, 0x10,         // 8000: LDA $10
+		INS_CLC,                  // 8002: CLC
+		INS_ADC_IM, 0x05,         // 8003: ADC #$05
+		INS_TAX,                  // 8005: TAX
+		INS_BMI, 0x02,            // 8006: BMI $800A
+		INS_INX,                  // 8008: INX
+		INS_INX,                  // 8009: INX
+		INS_STX_ZP, 0x11,         // 800A: STX $11
+		INS_LDY_IM, 0x03,         // 800C: LDY #$03
+		INS_DEY,                  // 800E: DEY
+		INS_BNE, 0xFD,            // 800F: BNE $800E
+		INS_JMP_ABS, 0x00, 0x80,  // 8011: JMP $8000
+	};
+
+	// Initialize system
+	CpuBatch batch(40);
+	std::copy(program.begin(), program.end(), batch.rom);
+	for (int lane = 0; lane < batch.Size(); lane++)
+		batch.Ram(lane)[0x10] = static_cast<uint8_t>(lane * 7);
+
+	// Run the expected number of cycles
+	batch.Run(200);
+
+	// Check test correctness
+	EXPECT_GT(batch.vectorSteps, 0u);
+	EXPECT_EQ(batch.scalarSteps, 0u);
+	for (int lane = 0; lane < batch.Size(); lane++) {
+		EXPECT_EQ(batch.status[lane], 0);
+		ExpectLaneMatchesScalar(batch, lane, program, 0, 0, static_cast<uint8_t>(lane * 7), 200);
+	}
+}
+
+TEST(BATCH_TEST, MemoryKernelsMatchScalarCore) {
+	// Initialize program
+	const std::vector<uint8_t> program = {
+		INS_LDX_ZP, 0x10,         // 8000: LDX $10
+		INS_LDA_ZPX, 0x20,        // 8002: LDA $20,X
+		INS_STA_ABSX, 0xF0, 0x02, // 8004: STA $02F0,X
+		INS_LDY_ABSX, 0xF0, 0x02, // 8007: LDY $02F0,X
+		INS_INC_ZP, 0x11,         // 800A: INC $11
+		INS_ROR_ZPX, 0x20,        // 800C: ROR $20,X
+		INS_ASL_ACC,              // 800E: ASL A
+		INS_PHA,                  // 800F: PHA
+		INS_JSR_ABS, 0x30, 0x80,  // 8010: JSR $8030
+		INS_PLA,                  // 8013: PLA
+		INS_BIT_ABS, 0x11, 0x00,  // 8014: BIT $0011
+		INS_STY_ZP, 0x11,         // 8017: STY $11
+		INS_JMP_ABS, 0x00, 0x80,  // 8019: JMP $8000
+	};
+	std::vector<uint8_t> subroutine = {
+		INS_LSR_ABS, 0x11, 0x00,  // 8030: LSR $0011
+		INS_TSX,                  // 8033: TSX
+		INS_ADC_ABSY, 0xF0, 0x01, // 8034: ADC $01F0,Y
+		INS_RTS,                  // 8037: RTS
+	};
+	std::vector<uint8_t> image(0x38, INS_NOP);
+	std::copy(program.begin(), program.end(), image.begin());
+	std::copy(subroutine.begin(), subroutine.end(), image.begin() + 0x30);
+
+	// Initialize system
+	CpuBatch batch(48);
+	std::copy(image.begin(), image.end(), batch.rom);
+	for (int lane = 0; lane < batch.Size(); lane++) {
+		for (int addr = 0; addr < 0x400; addr++)
+			batch.Ram(lane)[addr] = static_cast<uint8_t>(addr * 13 + lane * 5);
+		batch.Ram(lane)[0x10] = static_cast<uint8_t>(lane * 11);
+	}
+
+	// Run the expected number of cycles
+	batch.Run(500);
+
+	// Check test correctness
+	EXPECT_GT(batch.vectorSteps, 0u);
+	EXPECT_EQ(batch.scalarSteps, 0u);
+	for (int lane = 0; lane < batch.Size(); lane++) {
+		FlatBus system;
+		std::copy(image.begin(), image.end(), system.memory + 0x8000);
+		for (int addr = 0; addr < 0x400; addr++)
+			system.memory[addr] = static_cast<uint8_t>(addr * 13 + lane * 5);
+		system.memory[0x10] = static_cast<uint8_t>(lane * 11);
+		system.cpu.Run(500);
+
+		EXPECT_EQ(batch.status[lane], 0) << "lane " << lane;
+		EXPECT_EQ(batch.PC[lane], system.cpu.PC) << "lane " << lane;
+		EXPECT_EQ(batch.A[lane], system.cpu.A) << "lane " << lane;
+		EXPECT_EQ(batch.X[lane], system.cpu.X) << "lane " << lane;
+		EXPECT_EQ(batch.Y[lane], system.cpu.Y) << "lane " << lane;
+		EXPECT_EQ(batch.SP[lane], system.cpu.SP) << "lane " << lane;
+		EXPECT_EQ(batch.P[lane], system.cpu.P) << "lane " << lane;
+		EXPECT_EQ(batch.Cycles[lane], system.cpu.Cycles) << "lane " << lane;
+		EXPECT_TRUE(std::equal(system.memory, system.memory + 0x400, batch.Ram(lane))) << "lane " << lane;
+	}
+}
+
+TEST(BATCH_TEST, StepsOnlyDecimalLanesThroughScalarCore) {
+	// Initialize system
+	CpuBatch batch(32);
+	batch.rom[0] = INS_ADC_IM;
+	batch.rom[1] = 0x19;
+	batch.rom[2] = INS_NOP;
+	for (int lane = 0; lane < batch.Size(); lane++) {
+		batch.A[lane] = 0x28;
+		batch.P[lane] = (lane % 8 == 0) ? 0b00001000 : 0;
+	}
+
+	// Run the expected number of cycles
+	batch.Run(2);
+
+	// Check test correctness
+	EXPECT_EQ(batch.vectorSteps, 1u);
+	EXPECT_EQ(batch.scalarSteps, 4u);
+	for (int lane = 0; lane < batch.Size(); lane++) {
+		EXPECT_EQ(batch.PC[lane], 0x8002) << "lane " << lane;
+		EXPECT_EQ(batch.A[lane], (lane % 8 == 0) ? 0x47 : 0x41) << "lane " << lane;
+		EXPECT_EQ(batch.Cycles[lane], 2) << "lane " << lane;
+	}
+}
+
+// Each lane loads its own number with LDA or LDX, so lanes at the same address disagree on the
+// opcode, then branches over a different number of NOPs
+static std::vector<uint8_t> LaneCode(int lane) {
+	return {
+		static_cast<uint8_t>((lane % 2) ? INS_LDA_IM : INS_LDX_IM), static_cast<uint8_t>(lane), // 0200: LDA/LDX #lane
+		INS_STA_ABS, 0x00, 0x03,                                                                // 0202: STA $0300
+		INS_BNE, static_cast<uint8_t>(lane % 3),                                                // 0205: BNE *+lane%3
+		INS_NOP, INS_NOP,                                                                       // 0207: NOP NOP
+		INS_INY,                                                                                // 0209: INY
+		INS_JMP_ABS, 0x00, 0x02,                                                                // 020A: JMP $0200
+	};
+}
+
+TEST(BATCH_TEST, GroupsLanesRunningDifferentCodeInRam) {
+	// Initialize system
+	CpuBatch batch(20);
+	for (int lane = 0; lane < batch.Size(); lane++) {
+		const std::vector<uint8_t> code = LaneCode(lane);
+		std::copy(code.begin(), code.end(), batch.Ram(lane) + 0x0200);
+		batch.PC[lane] = 0x0200;
+	}
+
+	// Run the expected number of cycles
+	batch.Run(100);
+
+	// Check test correctness
+	EXPECT_GT(batch.vectorSteps, 0u);
+	EXPECT_EQ(batch.scalarSteps, 0u);
+	for (int lane = 0; lane < batch.Size(); lane++) {
+		FlatBus system;
+		const std::vector<uint8_t> code = LaneCode(lane);
+		std::copy(code.begin(), code.end(), system.memory + 0x0200);
+		system.memory[0x0300] = 0xFF;
+		system.cpu.PC = 0x0200;
+		system.cpu.Run(100);
+
+		EXPECT_EQ(batch.status[lane], 0) << "lane " << lane;
+		EXPECT_EQ(batch.PC[lane], system.cpu.PC) << "lane " << lane;
+		EXPECT_EQ(batch.A[lane], system.cpu.A) << "lane " << lane;
+		EXPECT_EQ(batch.X[lane], system.cpu.X) << "lane " << lane;
+		EXPECT_EQ(batch.Y[lane], system.cpu.Y) << "lane " << lane;
+		EXPECT_EQ(batch.P[lane], system.cpu.P) << "lane " << lane;
+		EXPECT_EQ(batch.Cycles[lane], system.cpu.Cycles) << "lane " << lane;
+		EXPECT_EQ(batch.Ram(lane)[0x0300], system.memory[0x0300]) << "lane " << lane;
+	}
+}
@@ -0,0 +1,363 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "MOS6502.h"
+#include "instructions.h"
+#include "exitcodes.h"
+#include "decode.h"
+#include <cstring>
+#include <vector>
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      BLOCK CACHE                                                                              BLOCK CACHE      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(BLOCK_CACHE_TEST, RunsLoopFromRom) {
+	// Loop: 2 + 8 * (2 + 2 + 3) - 1 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+
+	// Initialize memory
+	system.rom[0] = INS_LDX_IM;
+	system.rom[1] = 0x08;
+	system.rom[2] = INS_INY;
+	system.rom[3] = INS_DEX;
+	system.rom[4] = INS_BNE;
+	system.rom[5] = 0xFC;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(57);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8006);
+	EXPECT_EQ(system.cpu.X, 0x00);
+	EXPECT_EQ(system.cpu.Y, 0x08);
+	EXPECT_EQ(system.cpu.P, system.cpu.Z);
+}
+
+TEST(BLOCK_CACHE_TEST, StopsMidBlockWhenCyclesRunOut) {
+	// 1 + 1 Bytes, 2 + 2 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+
+	// Initialize memory
+	system.rom[0] = INS_INX;
+	system.rom[1] = INS_INX;
+	system.rom[2] = INS_INX;
+	system.rom[3] = INS_INX;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(4);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	EXPECT_EQ(system.cpu.X, 0x02);
+}
+
+TEST(BLOCK_CACHE_TEST, SeesCodeModifiedByStore) {
+	// 2 + 3 + 1 Bytes, 2 + 4 + 2 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+	system.cpu.PC = 0x0200;
+
+	// Initialize memory
+	system.ram[0x0200] = INS_LDA_IM;
+	system.ram[0x0201] = INS_INX;
+	system.ram[0x0202] = INS_STA_ABS;
+	system.ram[0x0203] = 0x05;
+	system.ram[0x0204] = 0x02;
+	system.ram[0x0205] = INS_NOP;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(8);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x0206);
+	EXPECT_EQ(system.cpu.X, 0x01);
+	EXPECT_EQ(system.ram[0x0205], INS_INX);
+}
+
+TEST(BLOCK_CACHE_TEST, SeesCodeModifiedBetweenRuns) {
+	// 1 + 3 Bytes, 2 + 3 Cycles per pass
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+	system.cpu.PC = 0x0300;
+
+	// Initialize memory
+	system.ram[0x0300] = INS_INX;
+	system.ram[0x0301] = INS_JMP_ABS;
+	system.ram[0x0302] = 0x00;
+	system.ram[0x0303] = 0x03;
+	system.rom[0] = INS_LDA_IM;
+	system.rom[1] = INS_DEY;
+	system.rom[2] = INS_STA_ABS;
+	system.rom[3] = 0x00;
+	system.rom[4] = 0x03;
+	system.rom[5] = INS_JMP_ABS;
+	system.rom[6] = 0x00;
+	system.rom[7] = 0x03;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(5);
+	EXPECT_EQ(system.cpu.X, 0x01);
+	system.cpu.PC = 0x8000;
+	status = system.cpu.Run(14);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x0300);
+	EXPECT_EQ(system.cpu.X, 0x01);
+	EXPECT_EQ(system.cpu.Y, 0xFF);
+}
+
+TEST(BLOCK_CACHE_TEST, SeesOperandModifiedInLoop) {
+	// Loop: 3 * (2 + 6 + 2 + 3) - 1 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+	system.cpu.PC = 0x0200;
+	system.cpu.X = 0x03;
+
+	// Initialize memory
+	system.ram[0x0200] = INS_LDA_IM;
+	system.ram[0x0201] = 0x00;
+	system.ram[0x0202] = INS_INC_ABS;
+	system.ram[0x0203] = 0x01;
+	system.ram[0x0204] = 0x02;
+	system.ram[0x0205] = INS_DEX;
+	system.ram[0x0206] = INS_BNE;
+	system.ram[0x0207] = 0xF8;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(38);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x0208);
+	EXPECT_EQ(system.cpu.A, 0x02);
+	EXPECT_EQ(system.ram[0x0201], 0x03);
+}
+
+TEST(BLOCK_CACHE_TEST, KeepsCodeNextToWrittenData) {
+	// Loop: 16 * (6 + 2 + 3) - 1 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+	system.cpu.PC = 0x0400;
+	system.cpu.X = 0x10;
+
+	// Initialize memory
+	system.ram[0x0400] = INS_INC_ABS;
+	system.ram[0x0401] = 0x80;
+	system.ram[0x0402] = 0x04;
+	system.ram[0x0403] = INS_DEX;
+	system.ram[0x0404] = INS_BNE;
+	system.ram[0x0405] = 0xFA;
+	system.ram[0x0480] = 0x00;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(175);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x0406);
+	EXPECT_EQ(system.ram[0x0480], 0x10);
+}
+
+TEST(BLOCK_CACHE_TEST, SeesCodeModifiedAtJumpTarget) {
+	// 3 + 1 + 1 Bytes, 6 + 2 + 6 Cycles per call
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+
+	// Initialize memory
+	system.ram[0x0300] = INS_JSR_ABS;
+	system.ram[0x0301] = 0x10;
+	system.ram[0x0302] = 0x03;
+	system.ram[0x0310] = INS_INY;
+	system.ram[0x0311] = INS_RTS;
+
+	// Run the expected number of cycles
+	system.cpu.PC = 0x0300;
+	int status = system.cpu.Run(14);
+	EXPECT_EQ(system.cpu.Y, 0x01);
+	system.write(0x0310, INS_DEY);
+	system.cpu.PC = 0x0300;
+	status = system.cpu.Run(14);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x0303);
+	EXPECT_EQ(system.cpu.Y, 0x00);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      JIT                                                                                              JIT      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(JIT_TEST, RunsHotLoop) {
+	// Loop: 2 + 200 * (2 + 2 + 3) - 1 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableJit(true, 2);
+
+	// Initialize memory
+	system.rom[0] = INS_LDX_IM;
+	system.rom[1] = 200;
+	system.rom[2] = INS_INY;
+	system.rom[3] = INS_DEX;
+	system.rom[4] = INS_BNE;
+	system.rom[5] = 0xFC;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(1401);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8006);
+	EXPECT_EQ(system.cpu.X, 0x00);
+	EXPECT_EQ(system.cpu.Y, 200);
+	EXPECT_EQ(system.cpu.P, system.cpu.Z);
+}
+
+TEST(JIT_TEST, ReportsExcessCyclesFromCompiledBlock) {
+	// 3 Bytes, 4 Cycles each
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableJit(true, 0);
+	system.cpu.A = 0x42;
+
+	// Initialize memory
+	system.rom[0] = INS_STA_ABS;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0x02;
+	system.rom[3] = INS_STA_ABS;
+	system.rom[4] = 0x01;
+	system.rom[5] = 0x02;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(5);
+
+	// Check test correctness
+	EXPECT_EQ(status, 3);
+	EXPECT_EQ(system.cpu.PC, 0x8006);
+	EXPECT_EQ(system.ram[0x0200], 0x42);
+	EXPECT_EQ(system.ram[0x0201], 0x42);
+}
+
+TEST(JIT_TEST, StopsOnErrorInCompiledBlock) {
+	// 3 Bytes, 4 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableJit(true, 0);
+
+	// Initialize memory
+	system.rom[0] = INS_STA_ABS;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0x90;
+	system.rom[3] = INS_INX;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(6);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_BADW);
+	EXPECT_EQ(system.cpu.PC, 0x8003);
+	EXPECT_EQ(system.cpu.X, 0x00);
+}
+
+TEST(JIT_TEST, MatchesInterpreterOnRandomPrograms) {
+	// Programs of random legal instructions in RAM, with operands kept to the first pages, run in
+	// short slices through the interpreter and through compiled blocks until either stops
+
+	// Initialize system
+	const OperationTable& operations = decode_table;
+	std::vector<uint8_t> opcodes;
+	for (int opcode = 0; opcode < 256; opcode++) {
+		const Instruction instruction = operations[opcode].instruction;
+		if (instruction != Instruction::INVALID && instruction != Instruction::BRK && instruction != Instruction::RTI &&
+			operations[opcode].mode != ABS_INDIRECT)
+			opcodes.push_back(static_cast<uint8_t>(opcode));
+	}
+
+	uint32_t seed = 2024;
+	auto random = [&seed] {
+		seed = seed * 1103515245 + 12345;
+		return static_cast<uint8_t>(seed >> 16);
+	};
+
+	for (int program = 0; program < 1000; program++) {
+		Bus plain, compiled;
+		plain.cpu.EnableJit(false);
+		compiled.cpu.EnableJit(true, 0);
+
+		// Initialize memory
+		//    Jumps, and the return addresses and zero page pointers read from memory, all stay on
+		//    the first pages, and the program loops back to its start at the end
+		uint16_t addr = 0x0300;
+		while (addr < 0x0500) {
+			const uint8_t opcode = opcodes[random() % opcodes.size()];
+			const Operation& operation = operations[opcode];
+			const int length = operation_length(operation.mode);
+			const bool jumps = operation.instruction == Instruction::JMP || operation.instruction == Instruction::JSR;
+			plain.ram[addr++] = opcode;
+			if (length > 1)
+				plain.ram[addr++] = random();
+			if (length > 2)
+				plain.ram[addr++] = jumps ? 3 + random() % 2 : random() % 4;
+		}
+		plain.ram[addr++] = INS_JMP_ABS;
+		plain.ram[addr++] = 0x00;
+		plain.ram[addr++] = 0x03;
+		for (uint16_t i = 0x0000; i < 0x0100; i++)
+			plain.ram[i] = random() % 5;
+		for (uint16_t i = 0x0100; i < 0x0200; i++)
+			plain.ram[i] = 3 + random() % 2;
+		for (uint16_t i = 0x0200; i < 0x0300; i++)
+			plain.ram[i] = random();
+		for (uint8_t& byte : plain.rom)
+			byte = random();
+		std::memcpy(compiled.ram, plain.ram, sizeof(plain.ram));
+		std::memcpy(compiled.rom, plain.rom, sizeof(plain.rom));
+		for (MOS6502Core<Bus>* cpu : { &plain.cpu, &compiled.cpu }) {
+			cpu->PC = 0x0300;
+			cpu->A = 0x5A;
+			cpu->SetStatus(program & 0xFF);
+		}
+
+		// Run the expected number of cycles
+		int plainStatus = 0, compiledStatus = 0;
+		uint64_t plainCycles = 0, compiledCycles = 0;
+		for (int slice = 0; slice < 40 && plainStatus >= 0 && compiledStatus >= 0; slice++) {
+			plainStatus = plain.cpu.Run(37);
+			compiledStatus = compiled.cpu.Run(37);
+			plainCycles += plain.cpu.Cycles;
+			compiledCycles += compiled.cpu.Cycles;
+		}
+
+		// Check test correctness
+		ASSERT_EQ(compiledStatus, plainStatus) << "program " << program;
+		ASSERT_EQ(compiledCycles, plainCycles) << "program " << program;
+		ASSERT_EQ(compiled.cpu.PC, plain.cpu.PC) << "program " << program;
+		ASSERT_EQ(compiled.cpu.A, plain.cpu.A) << "program " << program;
+		ASSERT_EQ(compiled.cpu.X, plain.cpu.X) << "program " << program;
+		ASSERT_EQ(compiled.cpu.Y, plain.cpu.Y) << "program " << program;
+		ASSERT_EQ(compiled.cpu.SP, plain.cpu.SP) << "program " << program;
+		ASSERT_EQ(compiled.cpu.GetStatus(), plain.cpu.GetStatus()) << "program " << program;
+		ASSERT_EQ(std::memcmp(compiled.ram, plain.ram, sizeof(plain.ram)), 0) << "program " << program;
+	}
+}
@@ -0,0 +1,417 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "flatbus.h"
+#include "MOS6502.h"
+#include "instructions.h"
+#include "exitcodes.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Device that records the last access and answers reads with a fixed value
+class TestDevice : public Device
+{
+public:
+	uint16_t lastAddr = 0;
+	uint8_t  lastData = 0;
+	int      reads = 0;
+	int      writes = 0;
+
+	uint8_t read(uint16_t addr) override {
+		lastAddr = addr;
+		reads++;
+		return 0x5A;
+	}
+
+	void write(uint16_t addr, uint8_t data) override {
+		lastAddr = addr;
+		lastData = data;
+		writes++;
+	}
+};
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      MEMORY MAP                                                                                MEMORY MAP      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(BUS_TEST, RamWriteDoesNotSetError) {
+	// Initialize system
+	Bus system;
+
+	// Access memory
+	system.write(0x1234, 0x42);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.status, 0);
+	EXPECT_EQ(system.ram[0x1234], 0x42);
+	EXPECT_EQ(system.read(0x1234), 0x42);
+}
+
+TEST(BUS_TEST, ReadsRomThroughEndOfRegion) {
+	// Initialize system
+	Bus system;
+
+	// Initialize memory
+	system.rom[0x0000] = 0x11;
+	system.rom[0x3FFF] = 0x22;
+
+	// Check test correctness
+	EXPECT_EQ(system.read(0x8000), 0x11);
+	EXPECT_EQ(system.read(0xBFFF), 0x22);
+	EXPECT_EQ(system.cpu.status, 0);
+}
+
+TEST(BUS_TEST, ReadsVectors) {
+	// Initialize system
+	Bus system;
+
+	// Check test correctness
+	EXPECT_EQ(system.read(0xFFFC), 0x00);
+	EXPECT_EQ(system.read(0xFFFD), 0x80);
+	EXPECT_EQ(system.cpu.status, 0);
+}
+
+TEST(BUS_TEST, RomWriteSetsError) {
+	// Initialize system
+	Bus system;
+	system.rom[0x10] = 0x33;
+
+	// Access memory
+	system.write(0x8010, 0x42);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.status, E_BADW);
+	EXPECT_EQ(system.rom[0x10], 0x33);
+}
+
+TEST(BUS_TEST, UnmappedReadSetsError) {
+	// Initialize system
+	Bus system;
+
+	// Access memory
+	system.read(0xC000);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.status, E_BADR);
+}
+
+TEST(BUS_TEST, StoreToRomStopsExecution) {
+	// 3 Bytes, 4 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.A = 0x42;
+
+	// Initialize memory
+	system.rom[0] = INS_STA_ABS;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0x90;
+	system.rom[3] = INS_NOP;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(6);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_BADW);
+	EXPECT_EQ(system.cpu.PC, 0x8003);
+}
+
+TEST(BUS_TEST, PokePatchesMemoryWithoutSideEffects) {
+	// Initialize system
+	Bus system;
+	TestDevice device;
+	system.MapDevice(0xD0, 0xD0, &device);
+	system.SetWriteWatch(0x0200);
+
+	// Access memory
+	bool ram = system.Poke(0x0200, 0x11);
+	bool rom = system.Poke(0x8010, 0x22);
+	bool vector = system.Poke(0xFFFC, 0x33);
+	bool io = system.Poke(0xD000, 0x44);
+	bool unmapped = system.Poke(0xC000, 0x55);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.status, 0);
+	EXPECT_TRUE(ram);
+	EXPECT_TRUE(rom);
+	EXPECT_TRUE(vector);
+	EXPECT_FALSE(io);
+	EXPECT_FALSE(unmapped);
+	EXPECT_EQ(system.ram[0x0200], 0x11);
+	EXPECT_EQ(system.rom[0x0010], 0x22);
+	EXPECT_EQ(system.vectors[2], 0x33);
+	EXPECT_EQ(device.writes, 0);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      DEVICES                                                                                      DEVICES      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(DEVICE_TEST, ForwardsReadsAndWrites) {
+	// Initialize system
+	Bus system;
+	TestDevice device;
+	system.MapDevice(0xD0, 0xD0, &device);
+
+	// Access memory
+	system.write(0xD012, 0x99);
+	uint8_t data = system.read(0xD034);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.status, 0);
+	EXPECT_EQ(device.writes, 1);
+	EXPECT_EQ(device.lastData, 0x99);
+	EXPECT_EQ(device.reads, 1);
+	EXPECT_EQ(device.lastAddr, 0xD034);
+	EXPECT_EQ(data, 0x5A);
+}
+
+TEST(DEVICE_TEST, CpuAccessesDevice) {
+	// 3 Bytes, 4 Cycles
+
+	// Initialize system
+	Bus system;
+	TestDevice device;
+	system.MapDevice(0x40, 0x40, &device);
+
+	// Initialize memory
+	system.rom[0] = INS_LDA_ABS;
+	system.rom[1] = 0x07;
+	system.rom[2] = 0x40;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(4);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.A, 0x5A);
+	EXPECT_EQ(device.lastAddr, 0x4007);
+}
+
+TEST(DEVICE_TEST, UnmapRestoresRam) {
+	// Initialize system
+	Bus system;
+	TestDevice device;
+	system.MapDevice(0x40, 0x41, &device);
+	system.UnmapDevice(0x40, 0x41);
+
+	// Access memory
+	system.write(0x4100, 0x77);
+
+	// Check test correctness
+	EXPECT_EQ(device.writes, 0);
+	EXPECT_EQ(system.ram[0x4100], 0x77);
+	EXPECT_EQ(system.read(0x4100), 0x77);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      DIRTY PAGES                                                                              DIRTY PAGES      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(DIRTY_TEST, DisabledReportsEveryPage) {
+	// Initialize system
+	Bus system;
+
+	// Check test correctness
+	EXPECT_FALSE(system.DirtyTracking());
+	EXPECT_TRUE(system.PageDirty(0x00));
+	EXPECT_TRUE(system.PageDirty(0x7F));
+}
+
+TEST(DIRTY_TEST, RunMarksWrittenPages) {
+	// Initialize system
+	Bus system;
+	system.EnableDirtyTracking(true);
+
+	// Initialize memory
+	system.rom[0x0000] = INS_STA_ZP;
+	system.rom[0x0001] = 0x10;
+	system.rom[0x0002] = INS_STA_ABS;
+	system.rom[0x0003] = 0x34;
+	system.rom[0x0004] = 0x12;
+	system.rom[0x0005] = INS_PHA;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(10);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.ram[0x1234], 0x00);
+	std::bitset<256> expected;
+	expected[0x00] = expected[0x01] = expected[0x12] = true;
+	EXPECT_EQ(system.DirtyPages(), expected);
+}
+
+TEST(DIRTY_TEST, ClearStartsANewInterval) {
+	// Initialize system
+	Bus system;
+	system.EnableDirtyTracking(true);
+
+	// Access memory
+	system.write(0x2000, 0x01);
+	system.write(0x2001, 0x02);
+	system.ClearDirtyPages();
+	system.write(0x3000, 0x03);
+
+	// Check test correctness
+	EXPECT_FALSE(system.PageDirty(0x20));
+	EXPECT_TRUE(system.PageDirty(0x30));
+	EXPECT_EQ(system.DirtyPages().count(), 1u);
+	EXPECT_EQ(system.ram[0x2001], 0x02);
+	EXPECT_EQ(system.ram[0x3000], 0x03);
+}
+
+TEST(DIRTY_TEST, SnapshotsSkipCleanPages) {
+	// Initialize system
+	Bus system;
+	system.EnableDirtyTracking(true);
+	Snapshot base = system.TakeSnapshot();
+
+	// Access memory
+	system.write(0x0400, 0x01);
+	Snapshot fork = system.TakeSnapshot();
+	system.write(0x0500, 0x02);
+	system.Restore(base);
+
+	// Check test correctness
+	EXPECT_EQ(fork.SharedPages(base), Snapshot::PAGES - 1);
+	EXPECT_EQ(system.ram[0x0400], 0xFF);
+	EXPECT_EQ(system.ram[0x0500], 0xFF);
+	EXPECT_TRUE(system.PageDirty(0x04));
+	EXPECT_TRUE(system.PageDirty(0x05));
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      ROM IMAGE                                                                                  ROM IMAGE      */
+/*----------------------------------------------------------------------------------------------------------------*/
+// Write a ROM image to a temporary file and return its path
+static std::string WriteImageFile(const std::string& name, const std::vector<uint8_t>& bytes) {
+	std::string path = (std::filesystem::temp_directory_path() / name).string();
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	return path;
+}
+
+TEST(ROMIMAGE_TEST, MappedImageRunsWithoutCopying) {
+	// Initialize memory
+	std::vector<uint8_t> bytes(0x300, INS_NOP);
+	bytes[0x000] = INS_JMP_ABS;
+	bytes[0x001] = 0x00;
+	bytes[0x002] = 0x82;
+	bytes[0x200] = INS_LDA_IM;
+	bytes[0x201] = 0x5A;
+	std::string path = WriteImageFile("mos6502_rom_mapped.bin", bytes);
+	RomImage image;
+	ASSERT_TRUE(image.Open(path));
+
+	// Initialize system
+	Bus system;
+	system.rom[0x1000] = 0xEE;
+	system.MapRom(image);
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(5);
+
+	// Check test correctness
+	EXPECT_TRUE(image.Mapped());
+	EXPECT_EQ(image.Pages(), 3u);
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.A, 0x5A);
+	EXPECT_EQ(system.DirectPage(0x80), image.Data());
+	EXPECT_EQ(system.read(0x9000), 0xEE); // Past the end of the image
+	std::filesystem::remove(path);
+}
+
+TEST(ROMIMAGE_TEST, BufferedImagePadsLastPage) {
+	// Initialize memory
+	std::vector<uint8_t> bytes = { INS_LDX_IM, 0x33, INS_INX };
+	std::string path = WriteImageFile("mos6502_rom_buffered.bin", bytes);
+	RomImage image;
+	ASSERT_TRUE(image.Open(path, false));
+
+	// Initialize system
+	Bus system;
+	system.MapRom(image);
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(4);
+
+	// Check test correctness
+	EXPECT_FALSE(image.Mapped());
+	EXPECT_EQ(image.Size(), 3u);
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.X, 0x34);
+	EXPECT_EQ(system.read(0x80FF), 0x00);
+	std::filesystem::remove(path);
+}
+
+TEST(ROMIMAGE_TEST, MissingFileFails) {
+	// Initialize system
+	RomImage image;
+
+	// Check test correctness
+	EXPECT_FALSE(image.Open("/nonexistent/mos6502.bin"));
+	EXPECT_EQ(image.Data(), nullptr);
+}
+
+TEST(ROMIMAGE_TEST, UnmapAndRestoreReturnToRomArray) {
+	// Initialize memory
+	std::vector<uint8_t> bytes(0x100, 0x11);
+	RomImage image;
+	image.Assign(bytes.data(), bytes.size());
+
+	// Initialize system
+	Bus system;
+	system.rom[0x0000] = 0x22;
+	Snapshot unmapped = system.TakeSnapshot();
+	system.MapRom(image);
+	Snapshot mapped = system.TakeSnapshot();
+
+	// Check test correctness
+	EXPECT_EQ(system.read(0x8000), 0x11);
+	EXPECT_EQ((*mapped.pages[0x80])[0x00], 0x11);
+	system.Restore(unmapped);
+	EXPECT_EQ(system.read(0x8000), 0x22);
+	system.MapRom(image);
+	system.UnmapRom();
+	EXPECT_EQ(system.read(0x8000), 0x22);
+	system.Restore(mapped);
+	EXPECT_EQ(system.read(0x8000), 0x11);
+	EXPECT_EQ(system.rom[0x0000], 0x11);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      FLAT BUS                                                                                    FLAT BUS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(FLATBUS_TEST, ResetsToStartOfRom) {
+	// Initialize system
+	FlatBus system;
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0x8000);
+	EXPECT_EQ(system.cpu.SP, 0xFF);
+}
+
+TEST(FLATBUS_TEST, RunsProgramAcrossFullAddressSpace) {
+	// 2 + 3 + 3 Bytes, 2 + 4 + 4 Cycles
+
+	// Initialize system
+	FlatBus system;
+
+	// Initialize memory
+	system.memory[0x8000] = INS_LDA_IM;
+	system.memory[0x8001] = 0x42;
+	system.memory[0x8002] = INS_STA_ABS;
+	system.memory[0x8003] = 0x00;
+	system.memory[0x8004] = 0xC0;
+	system.memory[0x8005] = INS_LDX_ABS;
+	system.memory[0x8006] = 0x00;
+	system.memory[0x8007] = 0xC0;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(10);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8008);
+	EXPECT_EQ(system.memory[0xC000], 0x42);
+	EXPECT_EQ(system.cpu.X, 0x42);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "singlestep.h"
+#include "decode.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Single-step conformance corpus
+//    The directory holds one file of cases per opcode, named after it in hex (a9.json). The files
+//    are shared out between one worker per core, each reusing one LogBus for all its cases. Only
+//    opcodes the core implements with the undocumented opcodes enabled are run.
+#ifndef MOS6502_SINGLESTEP_DIR
+#error "MOS6502_SINGLESTEP_DIR must name the directory holding the single-step JSON files"
+#endif
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      CORPUS                                                                                        CORPUS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+struct SingleStepResult {
+	std::filesystem::path path;
+	uint8_t     opcode = 0;
+	uint64_t    cases = 0;
+	uint64_t    failures = 0;
+	bool        malformed = false;
+	std::string firstFailure;
+};
+
+static void RunFile(LogBus& system, SingleStepCase& test, SingleStepResult& result) {
+	SingleStepReader reader(result.path);
+	while (reader.Next(test)) {
+		result.cases++;
+		std::string failure = RunCase(system, test);
+		if (failure.empty())
+			continue;
+		if (result.failures++ == 0)
+			result.firstFailure = std::string(test.name) + ": " + failure;
+	}
+	result.malformed = reader.Failed();
+}
+
+TEST(CONFORMANCE_TEST, SingleStepCorpus) {
+	// Collect the opcode files the core can run
+	std::vector<SingleStepResult> results;
+	uint64_t skipped = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(MOS6502_SINGLESTEP_DIR)) {
+		const std::string stem = entry.path().stem().string();
+		if (entry.path().extension() != ".json" || stem.size() != 2 || !std::isxdigit(static_cast<unsigned char>(stem[0])) ||
+			!std::isxdigit(static_cast<unsigned char>(stem[1])))
+			continue;
+		const uint8_t opcode = static_cast<uint8_t>(std::stoi(stem, nullptr, 16));
+		if (nmos_decode_table[opcode].instruction == Instruction::INVALID) {
+			skipped++;
+			continue;
+		}
+		results.push_back({ entry.path(), opcode });
+	}
+	std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) { return a.opcode < b.opcode; });
+	ASSERT_FALSE(results.empty()) << "No opcode files in " << MOS6502_SINGLESTEP_DIR;
+
+	// Run the files across one worker per core
+	const auto start = std::chrono::steady_clock::now();
+	std::atomic<size_t> nextFile{ 0 };
+	std::vector<std::thread> workers;
+	const unsigned threads = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(), results.size()));
+	for (unsigned i = 0; i < threads; i++) {
+		workers.emplace_back([&] {
+			auto system = std::make_unique<LogBus>();
+			auto test = std::make_unique<SingleStepCase>();
+			system->cpu.EnableUndocumented(true);
+			for (size_t file; (file = nextFile++) < results.size();)
+				RunFile(*system, *test, results[file]);
+		});
+	}
+	for (std::thread& worker : workers)
+		worker.join();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Check test correctness
+	uint64_t cases = 0, failures = 0;
+	for (const SingleStepResult& result : results) {
+		cases += result.cases;
+		failures += result.failures;
+		EXPECT_FALSE(result.malformed) << result.path.string() << " is malformed after " << result.cases << " cases";
+		EXPECT_EQ(result.failures, 0u) << "Opcode $" << std::hex << std::uppercase << int(result.opcode) << std::dec
+			<< " failed " << result.failures << " of " << result.cases << " cases, first " << result.firstFailure;
+	}
+	std::printf("%llu cases from %zu opcodes (%llu skipped) in %.2fs on %u threads, %.0f cases/s, %llu failed\n",
+		static_cast<unsigned long long>(cases), results.size(), static_cast<unsigned long long>(skipped), seconds,
+		threads, cases / std::max(seconds, 1e-9), static_cast<unsigned long long>(failures));
+}
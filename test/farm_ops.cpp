@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include "farm.h"
+#include "instructions.h"
+#include "exitcodes.h"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+// Count X down from a per-job start value, adding 3 to A each iteration, then store A to $10
+static FarmJob CountdownJob(uint8_t start) {
+	FarmJob job;
+	job.rom = {
+		INS_LDX_IM, start,      // 8000: LDX #start
+		INS_CLC,                // 8002: CLC
+		INS_ADC_IM, 0x03,       // 8003: ADC #$03
+		INS_DEX,                // 8005: DEX
+		INS_BNE, 0xFA,          // 8006: BNE $8002
+		INS_STA_ZP, 0x10,       // 8008: STA $10
+		0x02,                   // 800A: invalid, ends the job
+	};
+	job.cycles = 10000;
+	job.captureRam = true;
+	return job;
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      FARM                                                                                            FARM      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(FARM_TEST, FuturesReturnFinalState) {
+	// Initialize system
+	SystemFarm farm(4);
+	std::vector<std::future<FarmResult>> results;
+	for (int i = 1; i <= 64; i++)
+		results.push_back(farm.Submit(CountdownJob(static_cast<uint8_t>(i))));
+
+	// Check test correctness
+	for (int i = 1; i <= 64; i++) {
+		FarmResult result = results[i - 1].get();
+		EXPECT_EQ(result.exitCode, E_INV);
+		EXPECT_EQ(result.A, static_cast<uint8_t>(i * 3));
+		EXPECT_EQ(result.X, 0);
+		EXPECT_EQ(result.PC, 0x800B);
+		ASSERT_EQ(result.ram.size(), 32u * 1024);
+		EXPECT_EQ(result.ram[0x10], static_cast<uint8_t>(i * 3));
+		EXPECT_EQ(result.ram[0x11], 0xFF);
+	}
+}
+
+TEST(FARM_TEST, CallbacksRunForEveryJob) {
+	// Initialize system
+	SystemFarm farm(3);
+	std::atomic<int> completed{ 0 };
+	std::atomic<int> total{ 0 };
+	for (int i = 1; i <= 100; i++) {
+		farm.Submit(CountdownJob(static_cast<uint8_t>(i)), [&](const FarmResult& result) {
+			completed++;
+			total += result.A;
+		});
+	}
+	farm.Wait();
+
+	// Check test correctness
+	int expected = 0;
+	for (int i = 1; i <= 100; i++)
+		expected += static_cast<uint8_t>(i * 3);
+	EXPECT_EQ(completed, 100);
+	EXPECT_EQ(total, expected);
+}
+
+TEST(FARM_TEST, JobsStartFromTheirOwnState) {
+	// Initialize system
+	SystemFarm farm(1);
+	FarmJob first;
+	first.rom = { INS_STA_ZP, 0x20, 0x02 };
+	first.A = 0x42;
+	first.cycles = 100;
+	FarmJob second;
+	second.rom = { INS_INX, 0x02 };
+	second.X = 0x10;
+	second.ram = { 0x01, 0x02 };
+	second.cycles = 100;
+	second.captureRam = true;
+
+	// Run the expected number of cycles
+	FarmResult a = farm.Submit(first).get();
+	FarmResult b = farm.Submit(second).get();
+
+	// Check test correctness
+	EXPECT_EQ(a.exitCode, E_INV);
+	EXPECT_TRUE(a.ram.empty());
+	EXPECT_EQ(b.exitCode, E_INV);
+	EXPECT_EQ(b.X, 0x11);
+	EXPECT_EQ(b.A, 0x00);
+	EXPECT_EQ(b.ram[0x00], 0x01);
+	EXPECT_EQ(b.ram[0x01], 0x02);
+	EXPECT_EQ(b.ram[0x20], 0xFF); // Left behind by the first job on the same worker
+}
+
+TEST(FARM_TEST, PlainJobsDoNotInheritSnapshotState) {
+	// Initialize memory
+	Bus source;
+	for (int i = 0; i < 16; i++)
+		source.rom[i] = INS_NOP;
+	source.vectors[4] = 0x00;
+	source.vectors[5] = 0x90;
+	source.cpu.P = MOS6502::I;
+	source.cpu.SetIRQ(true);
+	source.cpu.Run(20);
+	auto snapshot = std::make_shared<Snapshot>(source.TakeSnapshot());
+
+	// Initialize system
+	SystemFarm farm(1);
+	FarmJob first;
+	first.snapshot = snapshot;
+	first.cycles = 2;
+	FarmJob second;
+	second.rom = { INS_INX, 0x02 };
+	second.cycles = 100;
+
+	// Run the expected number of cycles
+	FarmResult a = farm.Submit(first).get();
+	FarmResult b = farm.Submit(second).get();
+
+	// Check test correctness
+	EXPECT_EQ(a.exitCode, 0);
+	EXPECT_EQ(a.PC, 0x800B);
+	EXPECT_EQ(b.exitCode, E_INV); // No IRQ left asserted by the snapshot, so INX runs
+	EXPECT_EQ(b.X, 0x01);
+	EXPECT_EQ(b.SP, 0xFF);
+	EXPECT_EQ(b.PC, 0x8002);
+}
+
+TEST(FARM_TEST, CallbackExceptionsReachTheFuture) {
+	// Initialize system
+	SystemFarm farm(1);
+	std::future<void> failed = farm.Submit(CountdownJob(1), [](const FarmResult&) {
+		throw std::runtime_error("callback failed");
+	});
+	std::future<void> passed = farm.Submit(CountdownJob(2), [](const FarmResult&) {});
+
+	// Check test correctness
+	EXPECT_THROW(failed.get(), std::runtime_error);
+	EXPECT_NO_THROW(passed.get());
+	FarmResult result = farm.Submit(CountdownJob(3)).get();
+	EXPECT_EQ(result.A, 9);
+}
+
+TEST(FARM_TEST, CallbacksCanSubmitMoreJobs) {
+	// Initialize system
+	SystemFarm farm(2);
+	std::atomic<int> completed{ 0 };
+	for (int i = 1; i <= 8; i++) {
+		farm.Submit(CountdownJob(static_cast<uint8_t>(i)), [&farm, &completed, i](const FarmResult&) {
+			completed++;
+			farm.Submit(CountdownJob(static_cast<uint8_t>(i + 8)), [&completed](const FarmResult&) {
+				completed++;
+			});
+		});
+	}
+	farm.Wait();
+
+	// Check test correctness
+	EXPECT_EQ(completed, 16);
+}
+
+TEST(FARM_TEST, JobsShareAMappedImage) {
+	// Initialize memory
+	const std::vector<uint8_t> program = CountdownJob(10).rom;
+	auto image = std::make_shared<RomImage>();
+	image->Assign(program.data(), program.size());
+
+	// Initialize system
+	SystemFarm farm(2);
+	std::vector<std::future<FarmResult>> results;
+	for (int i = 0; i < 16; i++) {
+		FarmJob job;
+		job.image = image;
+		job.A = static_cast<uint8_t>(i);
+		job.cycles = 1000;
+		results.push_back(farm.Submit(job));
+	}
+
+	// Check test correctness
+	for (int i = 0; i < 16; i++) {
+		FarmResult result = results[i].get();
+		EXPECT_EQ(result.exitCode, E_INV);
+		EXPECT_EQ(result.A, static_cast<uint8_t>(i + 30));
+	}
+}
@@ -0,0 +1,455 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "gdbstub.h"
+#include "instructions.h"
+#include "exitcodes.h"
+#include <cstdio>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Debugger end of a socket pair, with the stub on the other end
+class GdbClient
+{
+public:
+	GdbClient() { socketpair(AF_UNIX, SOCK_STREAM, 0, fds); }
+	~GdbClient() {
+		close(fds[0]);
+		if (fds[1] >= 0)
+			close(fds[1]);
+	}
+
+	int Stub() const { return fds[0]; }
+
+	void Send(const std::string& payload) {
+		uint8_t sum = 0;
+		for (char c : payload)
+			sum += static_cast<uint8_t>(c);
+		char checksum[3];
+		std::snprintf(checksum, sizeof(checksum), "%02x", sum);
+		Write("$" + payload + "#" + checksum);
+	}
+
+	void Write(const std::string& data) { write(fds[1], data.data(), data.size()); }
+
+	void Close() {
+		close(fds[1]);
+		fds[1] = -1;
+	}
+
+	// Everything the stub has sent since the last call
+	std::string Raw() {
+		std::string data = pending;
+		pending.clear();
+		char buffer[4096];
+		pollfd ready = { fds[1], POLLIN, 0 };
+		while (poll(&ready, 1, 0) > 0) {
+			ssize_t length = read(fds[1], buffer, sizeof(buffer));
+			if (length <= 0)
+				break;
+			data.append(buffer, length);
+		}
+		return data;
+	}
+
+	// Payload of the next packet the stub sent, skipping acknowledgements, or "" if there is none
+	std::string Receive() {
+		pending = Raw();
+		size_t start = pending.find('$');
+		size_t end = pending.find('#', start);
+		if (start == std::string::npos || end == std::string::npos)
+			return "";
+		std::string payload = pending.substr(start + 1, end - start - 1);
+		pending.erase(0, end + 3);
+		return payload;
+	}
+
+private:
+	int fds[2] = { -1, -1 };
+	std::string pending;
+};
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      REGISTERS AND MEMORY                                                            REGISTERS AND MEMORY      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(GDBSTUB_TEST, StartsHalted) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Run the expected number of cycles
+	gdb.Send("?");
+	int status = stub.Run(100);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(gdb.Receive(), "S05");
+	EXPECT_TRUE(stub.Connected());
+	EXPECT_TRUE(stub.Halted());
+	EXPECT_EQ(system.cpu.Clock(), 0u);
+}
+
+TEST(GDBSTUB_TEST, ReadsAndWritesRegisters) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+	system.cpu.A = 0x12;
+	system.cpu.X = 0x34;
+	system.cpu.Y = 0x56;
+	system.cpu.P = 0x24;
+	system.cpu.SP = 0xFD;
+	system.cpu.PC = 0x8000;
+
+	// Talk to the stub
+	gdb.Send("g");
+	stub.Poll();
+	std::string registers = gdb.Receive();
+	gdb.Send("p5");
+	stub.Poll();
+	std::string pc = gdb.Receive();
+	gdb.Send("P5=3412");
+	gdb.Send("P2=9a");
+	stub.Poll();
+	std::string written = gdb.Receive();
+
+	// Check test correctness
+	EXPECT_EQ(registers, "12345624fd0080");
+	EXPECT_EQ(pc, "0080");
+	EXPECT_EQ(written, "OK");
+	EXPECT_EQ(system.cpu.PC, 0x1234);
+	EXPECT_EQ(system.cpu.Y, 0x9A);
+}
+
+TEST(GDBSTUB_TEST, ReadsAndWritesMemory) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Initialize memory
+	system.ram[0x01FF] = 0x01;
+	system.ram[0x0203] = 0x02;
+
+	// Talk to the stub
+	gdb.Send("M0200,3:0a0b0c");
+	stub.Poll();
+	std::string written = gdb.Receive();
+	gdb.Send("m01ff,5");
+	stub.Poll();
+	std::string data = gdb.Receive();
+
+	// Check test correctness
+	EXPECT_EQ(written, "OK");
+	EXPECT_EQ(data, "010a0b0c02");
+	EXPECT_EQ(system.ram[0x0201], 0x0B);
+}
+
+TEST(GDBSTUB_TEST, DescribesTheRegisters) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Talk to the stub
+	gdb.Send("qSupported:swbreak+");
+	stub.Poll();
+	std::string features = gdb.Receive();
+	gdb.Send("qXfer:features:read:target.xml:0,800");
+	stub.Poll();
+	std::string xml = gdb.Receive();
+
+	// Check test correctness
+	EXPECT_NE(features.find("qXfer:features:read+"), std::string::npos);
+	EXPECT_EQ(xml.substr(0, 6), "l<?xml");
+	EXPECT_NE(xml.find("name=\"pc\" bitsize=\"16\""), std::string::npos);
+}
+
+TEST(GDBSTUB_TEST, RejectsBadChecksum) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Talk to the stub
+	gdb.Write("$g#00");
+	stub.Poll();
+
+	// Check test correctness
+	EXPECT_EQ(gdb.Raw(), "-");
+}
+
+TEST(GDBSTUB_TEST, RejectsChecksumThatIsNotHex) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Talk to the stub, with a checksum of 0xFA once the bad digit is masked to 0xF
+	gdb.Write("$m0,1#za");
+	stub.Poll();
+
+	// Check test correctness
+	EXPECT_EQ(gdb.Raw(), "-");
+}
+
+TEST(GDBSTUB_TEST, RejectsMemoryWriteThatIsNotHex) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+	system.ram[0x0000] = 0x11;
+	system.ram[0x0001] = 0x22;
+
+	// Talk to the stub
+	gdb.Send("M0,1:zz");
+	stub.Poll();
+	std::string single = gdb.Receive();
+	gdb.Send("M0,2:33zz");
+	stub.Poll();
+	std::string partial = gdb.Receive();
+
+	// Check test correctness
+	EXPECT_EQ(single, "E01");
+	EXPECT_EQ(partial, "E01");
+	EXPECT_EQ(system.ram[0x0000], 0x11);
+	EXPECT_EQ(system.ram[0x0001], 0x22);
+}
+
+TEST(GDBSTUB_TEST, RejectsRegisterWriteThatIsNotHex) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+	system.cpu.A = 0x12;
+	system.cpu.PC = 0x8000;
+
+	// Talk to the stub
+	gdb.Send("G99345624fd00zz");
+	stub.Poll();
+
+	// Check test correctness
+	EXPECT_EQ(gdb.Receive(), "E01");
+	EXPECT_EQ(system.cpu.A, 0x12);
+	EXPECT_EQ(system.cpu.PC, 0x8000);
+}
+
+TEST(GDBSTUB_TEST, RejectsMemoryWriteLongerThanItsData) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+	system.ram[0x0000] = 0x11;
+
+	// Talk to the stub, with a length that wraps when doubled in 32 bits
+	gdb.Send("M0,80000001:00");
+	stub.Poll();
+
+	// Check test correctness
+	EXPECT_EQ(gdb.Receive(), "E01");
+	EXPECT_EQ(system.ram[0x0000], 0x11);
+}
+
+TEST(GDBSTUB_TEST, RejectsWatchpointLongerThanMemory) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Talk to the stub
+	gdb.Send("Z2,0,ffffffff");
+	stub.Poll();
+	std::string rejected = gdb.Receive();
+	gdb.Send("Z2,0,10000");
+	stub.Poll();
+	std::string accepted = gdb.Receive();
+
+	// Check test correctness
+	EXPECT_EQ(rejected, "E01");
+	EXPECT_EQ(accepted, "OK");
+	EXPECT_TRUE(system.WriteWatch(0xFFFF));
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      EXECUTION                                                                                  EXECUTION      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(GDBSTUB_TEST, StepsOneInstruction) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Initialize memory
+	system.rom[0] = INS_LDA_IM;
+	system.rom[1] = 0x01;
+	system.rom[2] = INS_LDX_IM;
+	system.rom[3] = 0x02;
+
+	// Run the expected number of cycles
+	gdb.Send("s");
+	stub.Poll();
+
+	// Check test correctness
+	EXPECT_EQ(gdb.Receive(), "S05");
+	EXPECT_TRUE(stub.Halted());
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	EXPECT_EQ(system.cpu.A, 0x01);
+	EXPECT_EQ(system.cpu.Clock(), 2u);
+}
+
+TEST(GDBSTUB_TEST, ContinuesToBreakpoint) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+	system.cpu.X = 0x00;
+
+	// Initialize memory
+	system.rom[0] = INS_INX;
+	system.rom[1] = INS_JMP_ABS;
+	system.rom[2] = 0x00;
+	system.rom[3] = 0x80;
+
+	// Run the expected number of cycles
+	gdb.Send("Z0,8001,1");
+	gdb.Send("c");
+	stub.Poll();
+	std::string set = gdb.Receive();
+	std::string resumed = gdb.Receive();
+	stub.Run(100);
+	std::string first = gdb.Receive();
+	gdb.Send("c");
+	stub.Run(100);
+	std::string second = gdb.Receive();
+
+	// Check test correctness
+	EXPECT_EQ(set, "OK");
+	EXPECT_EQ(resumed, "");
+	EXPECT_EQ(first, "T05swbreak:;");
+	EXPECT_EQ(second, "T05swbreak:;");
+	EXPECT_TRUE(stub.Halted());
+	EXPECT_EQ(system.cpu.status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8001);
+	EXPECT_EQ(system.cpu.X, 0x02);
+}
+
+TEST(GDBSTUB_TEST, ReportsWatchedAddress) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Initialize memory
+	system.rom[0] = INS_LDA_IM;
+	system.rom[1] = 0x07;
+	system.rom[2] = INS_STA_ABS;
+	system.rom[3] = 0x00;
+	system.rom[4] = 0x02;
+	system.rom[5] = INS_JMP_ABS;
+	system.rom[6] = 0x05;
+	system.rom[7] = 0x80;
+
+	// Run the expected number of cycles
+	gdb.Send("Z2,0200,1");
+	gdb.Send("c");
+	stub.Run(100);
+	gdb.Receive();
+
+	// Check test correctness
+	EXPECT_EQ(gdb.Receive(), "T05watch:0200;");
+	EXPECT_EQ(system.cpu.PC, 0x8005);
+	EXPECT_EQ(system.ram[0x0200], 0x07);
+}
+
+TEST(GDBSTUB_TEST, InterruptStopsTheSystem) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Initialize memory
+	system.rom[0] = INS_JMP_ABS;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0x80;
+
+	// Run the expected number of cycles
+	gdb.Send("c");
+	stub.Run(99);
+	gdb.Write("\x03");
+	int status = stub.Run(99);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(gdb.Receive(), "S02");
+	EXPECT_TRUE(stub.Halted());
+	EXPECT_EQ(system.cpu.Clock(), 99u);
+}
+
+TEST(GDBSTUB_TEST, ReportsErrorsUntilResumed) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Initialize memory
+	system.rom[0] = INS_LDA_ABS;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0xC0;
+
+	// Run the expected number of cycles
+	gdb.Send("c");
+	int status = stub.Run(100);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_BADR);
+	EXPECT_EQ(gdb.Receive(), "S0b");
+	EXPECT_TRUE(stub.Halted());
+	EXPECT_EQ(system.cpu.status, E_BADR);
+}
+
+TEST(GDBSTUB_TEST, DetachingLeavesTheSystemRunning) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Initialize memory
+	system.rom[0] = INS_JMP_ABS;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0x80;
+
+	// Run the expected number of cycles
+	gdb.Send("D");
+	stub.Run(99);
+	std::string detached = gdb.Receive();
+	gdb.Close();
+	stub.Run(99);
+
+	// Check test correctness
+	EXPECT_EQ(detached, "OK");
+	EXPECT_FALSE(stub.Connected());
+	EXPECT_FALSE(stub.Halted());
+	EXPECT_EQ(system.cpu.Clock(), 198u);
+}
+
+TEST(GDBSTUB_TEST, ClosedConnectionDetaches) {
+	// Initialize system
+	Bus system;
+	GdbClient gdb;
+	GdbStub stub(system, gdb.Stub(), gdb.Stub());
+
+	// Initialize memory
+	system.rom[0] = INS_JMP_ABS;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0x80;
+
+	// Run the expected number of cycles
+	gdb.Close();
+	stub.Serve(99);
+
+	// Check test correctness
+	EXPECT_FALSE(stub.Connected());
+	EXPECT_EQ(system.cpu.Clock(), 0u);
+}
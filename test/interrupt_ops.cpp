@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "device.h"
+#include "instructions.h"
+#include <cstring>
+
+// Point the NMI vector at 0x9000 and the IRQ vector at 0xA000, each holding a NOP followed by RTI,
+// and fill the rest of ROM with NOPs
+static void InitializeHandlers(Bus& system) {
+	std::memset(system.rom, INS_NOP, sizeof(system.rom));
+	system.vectors[0] = 0x00;
+	system.vectors[1] = 0x90;
+	system.vectors[4] = 0x00;
+	system.vectors[5] = 0xA0;
+	system.rom[0x1001] = INS_RTI;
+	system.rom[0x2001] = INS_RTI;
+}
+
+// Device that raises IRQ when written to
+class IrqDevice : public Device
+{
+public:
+	MOS6502* cpu = nullptr;
+
+	uint8_t read(uint16_t) override { return 0; }
+	void write(uint16_t, uint8_t data) override { cpu->SetIRQ(data != 0); }
+};
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      IRQ                                                                                              IRQ      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(IRQ_TEST, EntersHandlerInSevenCycles) {
+	// Initialize system
+	Bus system;
+	InitializeHandlers(system);
+	system.cpu.P = MOS6502::C | MOS6502::N;
+	system.cpu.SetIRQ(true);
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(7);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.Cycles, 7);
+	EXPECT_EQ(system.cpu.PC, 0xA000);
+	EXPECT_EQ(system.cpu.SP, 0xFC);
+	EXPECT_EQ(system.cpu.P, MOS6502::C | MOS6502::N | MOS6502::I);
+	EXPECT_EQ(system.ram[0x1FF], 0x80);
+	EXPECT_EQ(system.ram[0x1FE], 0x00);
+	EXPECT_EQ(system.ram[0x1FD], MOS6502::C | MOS6502::N | MOS6502::U);
+}
+
+TEST(IRQ_TEST, WaitsForInterruptDisableToClear) {
+	// Initialize system
+	Bus system;
+	InitializeHandlers(system);
+	system.rom[0x0002] = INS_CLI;
+	system.cpu.P = MOS6502::I;
+	system.cpu.SetIRQ(true);
+
+	// Run the expected number of cycles
+	system.cpu.Run(4);
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	system.cpu.Run(2 + 7);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0xA000);
+	EXPECT_EQ(system.ram[0x1FE], 0x03);
+}
+
+TEST(IRQ_TEST, LevelIsRetakenUntilReleased) {
+	// Initialize system
+	Bus system;
+	InitializeHandlers(system);
+	system.cpu.SetIRQ(true);
+
+	// Run the expected number of cycles
+	system.cpu.Run(7 + 2 + 6 + 7);
+	EXPECT_EQ(system.cpu.PC, 0xA000);
+	EXPECT_EQ(system.cpu.SP, 0xFC);
+	system.cpu.SetIRQ(false);
+	system.cpu.Run(2 + 6 + 2);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0x8001);
+	EXPECT_EQ(system.cpu.SP, 0xFF);
+}
+
+TEST(IRQ_TEST, SourcesShareTheLine) {
+	// Initialize system
+	Bus system;
+	InitializeHandlers(system);
+	system.cpu.P = MOS6502::I;
+	system.cpu.SetIRQ(true, 1 << 0);
+	system.cpu.SetIRQ(true, 1 << 1);
+	system.cpu.SetIRQ(false, 1 << 0);
+	system.cpu.P = 0;
+
+	// Run the expected number of cycles
+	system.cpu.Run(7);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0xA000);
+}
+
+TEST(IRQ_TEST, DeviceWriteInterruptsNextInstruction) {
+	// Initialize system
+	Bus system;
+	InitializeHandlers(system);
+	IrqDevice device;
+	device.cpu = &system.cpu;
+	system.MapDevice(0x40, 0x40, &device);
+	system.rom[0x0000] = INS_STA_ABS;
+	system.rom[0x0001] = 0x00;
+	system.rom[0x0002] = 0x40;
+	system.cpu.A = 0x01;
+
+	// Run the expected number of cycles
+	system.cpu.Run(4 + 7);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0xA000);
+	EXPECT_EQ(system.ram[0x1FE], 0x03);
+}
+
+TEST(IRQ_TEST, ScheduledInterruptHitsExactBoundary) {
+	// Initialize system
+	Bus system;
+	InitializeHandlers(system);
+	system.cpu.Schedule(5, [&] { system.cpu.SetIRQ(true); });
+
+	// Run the expected number of cycles
+	system.cpu.Run(6 + 7);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0xA000);
+	EXPECT_EQ(system.ram[0x1FE], 0x03);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      NMI                                                                                              NMI      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(NMI_TEST, IgnoresInterruptDisable) {
+	// Initialize system
+	Bus system;
+	InitializeHandlers(system);
+	system.cpu.P = MOS6502::I;
+	system.cpu.SetNMI(true);
+
+	// Run the expected number of cycles
+	system.cpu.Run(7);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0x9000);
+	EXPECT_EQ(system.ram[0x1FD], MOS6502::I | MOS6502::U);
+}
+
+TEST(NMI_TEST, TakenOncePerEdge) {
+	// Initialize system
+	Bus system;
+	InitializeHandlers(system);
+	system.cpu.SetNMI(true);
+
+	// Run the expected number of cycles
+	system.cpu.Run(7 + 2 + 6 + 2);
+	EXPECT_EQ(system.cpu.PC, 0x8001);
+	system.cpu.SetNMI(true);
+	system.cpu.Run(2);
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	system.cpu.SetNMI(false);
+	system.cpu.SetNMI(true);
+	system.cpu.Run(7);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0x9000);
+}
+
+TEST(NMI_TEST, TakesPriorityOverIrq) {
+	// Initialize system
+	Bus system;
+	InitializeHandlers(system);
+	system.cpu.SetIRQ(true);
+	system.cpu.SetNMI(true);
+
+	// Run the expected number of cycles
+	system.cpu.Run(7);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0x9000);
+}
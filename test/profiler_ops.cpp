@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "profiler.h"
+#include "instructions.h"
+#include <sstream>
+#include <string>
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      PROFILER                                                                                    PROFILER      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(PROFILER_TEST, CountsOpcodesAndAddresses) {
+	// Initialize system
+	Profiler profiler;
+
+	// Record executions
+	profiler.Record(0x8000, INS_LDA_IM, 2);
+	profiler.Record(0x8002, INS_STA_ABS, 4);
+	profiler.Record(0x8000, INS_LDA_IM, 2);
+
+	// Check test correctness
+	EXPECT_EQ(profiler.Opcode(INS_LDA_IM).executions, 2u);
+	EXPECT_EQ(profiler.Opcode(INS_LDA_IM).cycles, 4u);
+	EXPECT_EQ(profiler.Address(0x8002).executions, 1u);
+	EXPECT_EQ(profiler.Address(0x8002).cycles, 4u);
+	EXPECT_EQ(profiler.TotalCycles(), 8u);
+
+	std::ostringstream report;
+	profiler.WriteReport(report);
+	EXPECT_NE(report.str().find("$A9 LDA"), std::string::npos);
+	EXPECT_LT(report.str().find("$8D STA"), report.str().find("$A9 LDA")); // Equal cycles keep opcode order
+}
+
+TEST(PROFILER_TEST, AttributesCyclesToCallStacks) {
+	// Initialize system
+	Profiler profiler;
+
+	// Record executions
+	profiler.Record(0x8000, INS_JSR_ABS, 6);
+	profiler.Call(0x9000);
+	profiler.Record(0x9000, INS_JSR_ABS, 6);
+	profiler.Call(0xA000);
+	profiler.Record(0xA000, INS_RTS, 6);
+	profiler.Return();
+	profiler.Record(0x9003, INS_RTS, 6);
+	profiler.Return();
+	profiler.Return(); // Unmatched returns stay at the outermost frame
+	profiler.Record(0x8003, INS_NOP, 2);
+
+	// Check test correctness
+	std::ostringstream collapsed;
+	profiler.WriteCollapsed(collapsed);
+	EXPECT_EQ(collapsed.str(), "root 8\nroot;$9000 12\nroot;$9000;$A000 6\n");
+	EXPECT_EQ(profiler.Depth(), 0u);
+}
+
+TEST(PROFILER_TEST, StopsTrackingPastMaxDepth) {
+	// Initialize system
+	Profiler profiler;
+
+	// Recurse past the tracked depth and back out
+	for (size_t i = 0; i < Profiler::MAX_DEPTH + 10; i++)
+		profiler.Call(0x9000);
+	EXPECT_EQ(profiler.Depth(), Profiler::MAX_DEPTH);
+	for (size_t i = 0; i < 10; i++)
+		profiler.Return();
+
+	// Check test correctness
+	EXPECT_EQ(profiler.Depth(), Profiler::MAX_DEPTH);
+	profiler.Return();
+	EXPECT_EQ(profiler.Depth(), Profiler::MAX_DEPTH - 1);
+}
+
+#ifdef MOS6502_PROFILE
+TEST(PROFILER_TEST, ProfilesRun) {
+	// Initialize system
+	Bus system;
+	Profiler profiler;
+	system.cpu.EnableBlockCache(true);
+	system.cpu.AttachProfiler(&profiler);
+
+	// Initialize memory
+	system.rom[0x00] = INS_JSR_ABS;
+	system.rom[0x01] = 0x10;
+	system.rom[0x02] = 0x80;
+	system.rom[0x03] = INS_JSR_ABS;
+	system.rom[0x04] = 0x10;
+	system.rom[0x05] = 0x80;
+	system.rom[0x10] = INS_LDA_IM;
+	system.rom[0x11] = 0x01;
+	system.rom[0x12] = INS_RTS;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(28);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8006);
+	EXPECT_EQ(profiler.TotalCycles(), 28u);
+	EXPECT_EQ(profiler.Opcode(INS_JSR_ABS).executions, 2u);
+	EXPECT_EQ(profiler.Opcode(INS_JSR_ABS).cycles, 12u);
+	EXPECT_EQ(profiler.Address(0x8010).executions, 2u);
+	EXPECT_EQ(profiler.Address(0x8012).cycles, 12u);
+
+	std::ostringstream collapsed;
+	profiler.WriteCollapsed(collapsed);
+	EXPECT_EQ(collapsed.str(), "root 12\nroot;$8010 16\n");
+}
+
+TEST(PROFILER_TEST, ChargesInterruptEntryToHandler) {
+	// Initialize system
+	Bus system;
+	Profiler profiler;
+	system.cpu.AttachProfiler(&profiler);
+	system.cpu.SetIRQ(true);
+
+	// Initialize memory
+	system.vectors[4] = 0x00;
+	system.vectors[5] = 0x90;
+	system.rom[0x1000] = INS_NOP;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(9);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(profiler.Depth(), 1u);
+	std::ostringstream collapsed;
+	profiler.WriteCollapsed(collapsed);
+	EXPECT_EQ(collapsed.str(), "root;$9000 9\n");
+}
+#endif
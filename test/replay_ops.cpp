@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "device.h"
+#include "inputlog.h"
+#include "instructions.h"
+#include "exitcodes.h"
+#include <cstring>
+#include <sstream>
+
+// Device answering reads with a pseudo-random sequence, and driving IRQ from writes
+class NoisyDevice : public Device
+{
+public:
+	MOS6502* cpu = nullptr;
+	uint32_t state = 12345;
+
+	uint8_t read(uint16_t) override {
+		state = state * 1103515245 + 12345;
+		return static_cast<uint8_t>(state >> 16);
+	}
+	void write(uint16_t, uint8_t data) override { cpu->SetIRQ(data != 0); }
+};
+
+// Main loop sums device reads into 0x10. The IRQ handler stores a device read at 0x11 and releases
+// the line, and the NMI handler counts itself at 0x12
+static void InitializeProgram(Bus& system, NoisyDevice& device) {
+	device.cpu = &system.cpu;
+	system.MapDevice(0x40, 0x40, &device);
+	std::memset(system.ram, 0, sizeof(system.ram));
+
+	const uint8_t main[] = {
+		INS_LDA_ABS, 0x00, 0x40, INS_CLC, INS_ADC_ZP, 0x10, INS_STA_ZP, 0x10, INS_CLI, INS_JMP_ABS, 0x00, 0x80
+	};
+	const uint8_t irq[] = {
+		INS_PHA, INS_LDA_ABS, 0x00, 0x40, INS_STA_ZP, 0x11, INS_LDA_IM, 0x00, INS_STA_ABS, 0x00, 0x40, INS_PLA, INS_RTI
+	};
+	const uint8_t nmi[] = { INS_INC_ZP, 0x12, INS_RTI };
+	std::memcpy(&system.rom[0x0000], main, sizeof(main));
+	std::memcpy(&system.rom[0x1000], irq, sizeof(irq));
+	std::memcpy(&system.rom[0x1100], nmi, sizeof(nmi));
+	system.vectors[0] = 0x00;
+	system.vectors[1] = 0x91;
+	system.vectors[4] = 0x00;
+	system.vectors[5] = 0x90;
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      INPUT LOG                                                                                  INPUT LOG      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(INPUTLOG_TEST, EncodesInputsCompactly) {
+	// Initialize log
+	InputLog log;
+	log.Append({ 10, InputLog::Kind::READ, 0x4000, 0xAB });
+	log.Append({ 300, InputLog::Kind::IRQ, 0, 0x3 });
+	log.Append({ 300, InputLog::Kind::NMI, 0, 1 });
+	log.Append({ 5000000000ull, InputLog::Kind::READ, 0x4001, 0x01 });
+
+	// Round trip through a stream
+	std::stringstream stream;
+	log.Write(stream);
+	InputLog copy;
+	ASSERT_TRUE(copy.Read(stream));
+
+	// Check test correctness
+	EXPECT_EQ(log.Bytes(), 5u + 4u + 3u + 9u);
+	EXPECT_EQ(copy.Count(), 4u);
+	EXPECT_EQ(copy.LastCycle(), 5000000000ull);
+
+	InputLog::Reader reader(copy);
+	InputLog::Input input;
+	ASSERT_TRUE(reader.Next(input));
+	EXPECT_EQ(input.cycle, 10u);
+	EXPECT_EQ(input.addr, 0x4000);
+	EXPECT_EQ(input.value, 0xABu);
+	ASSERT_TRUE(reader.Next(input, InputLog::Kind::NMI));
+	EXPECT_EQ(input.cycle, 300u);
+	ASSERT_TRUE(reader.Next(input));
+	EXPECT_EQ(input.cycle, 5000000000ull);
+	EXPECT_EQ(input.addr, 0x4001);
+	EXPECT_FALSE(reader.Next(input));
+
+	reader.Seek(300);
+	ASSERT_TRUE(reader.Next(input));
+	EXPECT_EQ(input.kind, InputLog::Kind::IRQ);
+	EXPECT_EQ(input.value, 0x3u);
+}
+
+TEST(INPUTLOG_TEST, RejectsTruncatedLog) {
+	// Initialize log
+	InputLog log;
+	log.Append({ 10, InputLog::Kind::READ, 0x4000, 0xAB });
+	std::stringstream stream;
+	log.Write(stream);
+	std::string bytes = stream.str();
+	std::istringstream truncated(bytes.substr(0, bytes.size() - 1));
+
+	// Check test correctness
+	InputLog copy;
+	EXPECT_FALSE(copy.Read(truncated));
+}
+
+TEST(INPUTLOG_TEST, RejectsCorruptLength) {
+	// Initialize log
+	InputLog log;
+	log.Append({ 10, InputLog::Kind::READ, 0x4000, 0xAB });
+	std::stringstream stream;
+	log.Write(stream);
+	std::string bytes = stream.str();
+
+	// The byte length follows the magic, version, count and last cycle
+	for (size_t i = 0; i < 8; i++)
+		bytes[4 + 2 + 8 + 8 + i] = static_cast<char>(0xFF);
+	std::istringstream corrupt(bytes);
+
+	// Check test correctness
+	InputLog copy;
+	EXPECT_FALSE(copy.Read(corrupt));
+}
+
+TEST(INPUTLOG_TEST, SeeksWithoutDecodingFromTheStart) {
+	// Initialize log
+	InputLog log;
+	for (uint32_t i = 0; i < 5000; i++)
+		log.Append({ 10ull * i, InputLog::Kind::READ, 0x4000, i & 0xFF });
+	const InputLog::Position middle = log.End();
+	log.Append({ 50000, InputLog::Kind::NMI, 0, 1 });
+	std::stringstream stream;
+	log.Write(stream);
+	InputLog copy;
+	ASSERT_TRUE(copy.Read(stream));
+
+	// Check test correctness
+	InputLog::Reader reader(copy);
+	InputLog::Input input;
+	reader.Seek(30001);
+	ASSERT_TRUE(reader.Next(input));
+	EXPECT_EQ(input.cycle, 30010u);
+	reader.Seek(12340);
+	ASSERT_TRUE(reader.Next(input));
+	EXPECT_EQ(input.cycle, 12340u);
+	reader.Skip(4321);
+	ASSERT_TRUE(reader.Next(input));
+	EXPECT_EQ(input.cycle, 43210u);
+	EXPECT_EQ(reader.Tell().index, 4322u);
+	reader.SeekTo(middle);
+	ASSERT_TRUE(reader.Next(input));
+	EXPECT_EQ(input.kind, InputLog::Kind::NMI);
+	EXPECT_EQ(input.cycle, 50000u);
+	EXPECT_FALSE(reader.Next(input));
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      REPLAY                                                                                        REPLAY      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(REPLAY_TEST, ReproducesRecordedRun) {
+	// Record a run driven by a device and by the host
+	Bus recorded;
+	NoisyDevice device;
+	InitializeProgram(recorded, device);
+	InputLog log;
+	recorded.cpu.RecordInputs(&log);
+	for (uint64_t when = 500; when < 100000; when += 3331)
+		recorded.cpu.ScheduleAt(when, [&] { recorded.cpu.SetIRQ(true); });
+	for (uint64_t when = 777; when < 100000; when += 9001) {
+		recorded.cpu.ScheduleAt(when, [&] { recorded.cpu.SetNMI(true); });
+		recorded.cpu.ScheduleAt(when + 40, [&] { recorded.cpu.SetNMI(false); });
+	}
+	for (int i = 0; i < 100; i++)
+		recorded.cpu.Run(1000);
+
+	// Replay it with a device that would answer differently and nothing driving the interrupts
+	Bus replayed;
+	NoisyDevice other;
+	InitializeProgram(replayed, other);
+	other.state = 1;
+	replayed.cpu.EnableBlockCache(true);
+	replayed.cpu.ReplayInputs(&log);
+	for (int i = 0; i < 100; i++)
+		replayed.cpu.Run(1000);
+
+	// Check test correctness
+	EXPECT_EQ(replayed.cpu.status, 0);
+	EXPECT_GT(log.Count(), 1000u);
+	EXPECT_NE(recorded.ram[0x12], 0);
+	EXPECT_EQ(replayed.cpu.Clock(), recorded.cpu.Clock());
+	EXPECT_EQ(replayed.cpu.PC, recorded.cpu.PC);
+	EXPECT_EQ(replayed.cpu.A, recorded.cpu.A);
+	EXPECT_EQ(replayed.cpu.P, recorded.cpu.P);
+	EXPECT_EQ(replayed.cpu.SP, recorded.cpu.SP);
+	EXPECT_EQ(std::memcmp(replayed.ram, recorded.ram, sizeof(recorded.ram)), 0);
+}
+
+TEST(REPLAY_TEST, IgnoresHostInterruptsWhileReplaying) {
+	// Initialize system
+	Bus system;
+	NoisyDevice device;
+	InitializeProgram(system, device);
+	InputLog log;
+	log.Append({ 4, InputLog::Kind::READ, 0x4000, 0x21 });
+	system.cpu.ReplayInputs(&log);
+	system.cpu.SetIRQ(true);
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(4 + 2 + 3 + 3);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8008);
+	EXPECT_EQ(system.ram[0x10], 0x21);
+}
+
+TEST(REPLAY_TEST, StopsOnDivergence) {
+	// Initialize system
+	Bus system;
+	NoisyDevice device;
+	InitializeProgram(system, device);
+	InputLog log;
+	log.Append({ 3, InputLog::Kind::READ, 0x4000, 0x21 }); // The read is made on cycle 4
+	system.cpu.ReplayInputs(&log);
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(4);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_DESYNC);
+}
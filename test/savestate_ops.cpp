@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "savestate.h"
+#include "instructions.h"
+#include "exitcodes.h"
+#include <cstring>
+#include <sstream>
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      PACKING                                                                                      PACKING      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(PACK_TEST, RoundTripsMixedPages) {
+	// Initialize memory
+	uint8_t page[256];
+	for (int i = 0; i < 256; i++)
+		page[i] = (i < 100) ? 0xFF : (i < 140) ? static_cast<uint8_t>(i * 37) : (i & 0x10) ? 0x00 : 0xAA;
+
+	// Run the compressor
+	uint8_t packed[258];
+	uint8_t unpacked[256];
+	size_t length = SaveState::Pack(page, packed);
+
+	// Check test correctness
+	EXPECT_LT(length, 256u);
+	ASSERT_TRUE(SaveState::Unpack(packed, length, unpacked));
+	EXPECT_EQ(std::memcmp(page, unpacked, 256), 0);
+}
+
+TEST(PACK_TEST, IncompressiblePageStaysBounded) {
+	// Initialize memory
+	uint8_t page[256];
+	for (int i = 0; i < 256; i++)
+		page[i] = static_cast<uint8_t>(i);
+
+	// Run the compressor
+	uint8_t packed[258];
+	uint8_t unpacked[256];
+	size_t length = SaveState::Pack(page, packed);
+
+	// Check test correctness
+	EXPECT_EQ(length, 258u);
+	ASSERT_TRUE(SaveState::Unpack(packed, length, unpacked));
+	EXPECT_EQ(std::memcmp(page, unpacked, 256), 0);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      SAVE STATE                                                                                SAVE STATE      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(SAVESTATE_TEST, FullStateRoundTrips) {
+	// Initialize system
+	Bus system;
+	std::memset(system.rom, 0x00, sizeof(system.rom));
+	system.rom[0x0000] = INS_LDA_IM;
+	system.rom[0x0001] = 0x42;
+	system.rom[0x0002] = INS_STA_ABS;
+	system.rom[0x0003] = 0x00;
+	system.rom[0x0004] = 0x30;
+	system.rom[0x0005] = 0x02;
+	int status = system.cpu.Run(20);
+
+	// Run the save state through a stream
+	std::stringstream stream;
+	SaveState::Write(stream, system.TakeSnapshot());
+	Snapshot loaded;
+	ASSERT_TRUE(SaveState::Read(stream, loaded));
+	Bus restored;
+	restored.Restore(loaded);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_INV);
+	EXPECT_LT(stream.str().size(), 2048u);
+	EXPECT_EQ(restored.cpu.PC, system.cpu.PC);
+	EXPECT_EQ(restored.cpu.A, 0x42);
+	EXPECT_EQ(restored.cpu.P, system.cpu.P);
+	EXPECT_EQ(restored.cpu.Cycles, system.cpu.Cycles);
+	EXPECT_EQ(restored.cpu.Clock(), system.cpu.Clock());
+	EXPECT_EQ(restored.cpu.status, E_INV);
+	EXPECT_EQ(restored.ram[0x3000], 0x42);
+	EXPECT_EQ(std::memcmp(restored.ram, system.ram, sizeof(system.ram)), 0);
+	EXPECT_EQ(std::memcmp(restored.rom, system.rom, sizeof(system.rom)), 0);
+	EXPECT_EQ(std::memcmp(restored.vectors, system.vectors, sizeof(system.vectors)), 0);
+}
+
+TEST(SAVESTATE_TEST, DeltaOnlyHoldsChangedPages) {
+	// Initialize system
+	Bus system;
+	for (int i = 0; i < 0x4000; i++)
+		system.ram[i] = static_cast<uint8_t>(i * 13);
+	Snapshot base = system.TakeSnapshot();
+	system.write(0x1234, 0x00);
+	system.cpu.A = 0x99;
+	Snapshot state = system.TakeSnapshot();
+
+	// Run the save states through streams
+	std::stringstream full, delta;
+	SaveState::Write(full, state);
+	SaveState::Write(delta, state, &base);
+	Snapshot loaded;
+	ASSERT_TRUE(SaveState::Read(delta, loaded, &base));
+
+	// Check test correctness
+	EXPECT_LT(delta.str().size(), 400u);
+	EXPECT_LT(delta.str().size(), full.str().size());
+	EXPECT_EQ(loaded.A, 0x99);
+	EXPECT_EQ(loaded.SharedPages(base), Snapshot::PAGES - 1);
+	EXPECT_EQ((*loaded.pages[0x12])[0x34], 0x00);
+	EXPECT_EQ((*loaded.pages[0x12])[0x35], static_cast<uint8_t>(0x1235 * 13));
+}
+
+TEST(SAVESTATE_TEST, DeltaRejectsTheWrongBase) {
+	// Initialize system
+	Bus system;
+	Snapshot base = system.TakeSnapshot();
+	system.write(0x0000, 0x01);
+	Snapshot state = system.TakeSnapshot();
+	system.write(0x0001, 0x02);
+	Snapshot other = system.TakeSnapshot();
+
+	// Run the save state through a stream
+	std::stringstream delta;
+	SaveState::Write(delta, state, &base);
+	std::string bytes = delta.str();
+	Snapshot loaded;
+
+	// Check test correctness
+	std::stringstream wrongBase(bytes), noBase(bytes), truncated(bytes.substr(0, bytes.size() - 1));
+	EXPECT_FALSE(SaveState::Read(wrongBase, loaded, &other));
+	EXPECT_FALSE(SaveState::Read(noBase, loaded));
+	EXPECT_FALSE(SaveState::Read(truncated, loaded, &base));
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "scheduler.h"
+#include "instructions.h"
+#include <cstring>
+#include <vector>
+
+// Fill ROM with 2-cycle NOPs
+static void FillNops(Bus& system) {
+	std::memset(system.rom, INS_NOP, sizeof(system.rom));
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      SCHEDULER                                                                                  SCHEDULER      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(SCHEDULER_TEST, OrdersEventsByTimeThenSubmission) {
+	// Initialize system
+	Scheduler scheduler;
+	std::vector<int> order;
+	scheduler.Add(20, [&] { order.push_back(3); });
+	scheduler.Add(10, [&] { order.push_back(1); });
+	scheduler.Add(10, [&] { order.push_back(2); });
+	Scheduler::EventId cancelled = scheduler.Add(5, [&] { order.push_back(0); });
+
+	// Run the events
+	EXPECT_TRUE(scheduler.Cancel(cancelled));
+	EXPECT_FALSE(scheduler.Cancel(cancelled));
+	EXPECT_EQ(scheduler.Next(), 10u);
+	scheduler.RunDue(15);
+
+	// Check test correctness
+	EXPECT_EQ(order, (std::vector<int>{ 1, 2 }));
+	EXPECT_EQ(scheduler.Next(), 20u);
+	EXPECT_EQ(scheduler.Pending(), 1u);
+}
+
+TEST(SCHEDULER_TEST, FiresAtFirstInstructionBoundary) {
+	// Initialize system
+	Bus system;
+	FillNops(system);
+	uint64_t firedAt = 0;
+	uint16_t firedPC = 0;
+	system.cpu.Schedule(5, [&] {
+		firedAt = system.cpu.Clock();
+		firedPC = system.cpu.PC;
+	});
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(20);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(firedAt, 6u);
+	EXPECT_EQ(firedPC, 0x8003);
+	EXPECT_EQ(system.cpu.PC, 0x800A);
+	EXPECT_EQ(system.cpu.Clock(), 20u);
+}
+
+TEST(SCHEDULER_TEST, EventsCarryAcrossRuns) {
+	// Initialize system
+	Bus system;
+	FillNops(system);
+	int fired = 0;
+	system.cpu.ScheduleAt(15, [&] { fired++; });
+
+	// Run the expected number of cycles
+	system.cpu.Run(10);
+	EXPECT_EQ(fired, 0);
+	system.cpu.Run(10);
+
+	// Check test correctness
+	EXPECT_EQ(fired, 1);
+	EXPECT_EQ(system.cpu.Clock(), 20u);
+}
+
+TEST(SCHEDULER_TEST, PeriodicEventReschedulesItself) {
+	// Initialize system
+	Bus system;
+	FillNops(system);
+	std::vector<uint64_t> ticks;
+	std::function<void()> tick = [&] {
+		ticks.push_back(system.cpu.Clock());
+		system.cpu.Schedule(10, tick);
+	};
+	system.cpu.Schedule(10, tick);
+
+	// Run the expected number of cycles
+	system.cpu.Run(50);
+
+	// Check test correctness
+	EXPECT_EQ(ticks, (std::vector<uint64_t>{ 10, 20, 30, 40, 50 }));
+}
+
+TEST(SCHEDULER_TEST, CallbackSeesCompleteStatus) {
+	// Initialize system
+	Bus system;
+	system.rom[0x0000] = INS_LDA_IM;
+	system.rom[0x0001] = 0x00;
+	system.rom[0x0002] = INS_NOP;
+	uint8_t seen = 0;
+	system.cpu.Schedule(1, [&] { seen = system.cpu.P; });
+
+	// Run the expected number of cycles
+	system.cpu.Run(4);
+
+	// Check test correctness
+	EXPECT_EQ(seen & MOS6502::Z, MOS6502::Z);
+}
+
+TEST(SCHEDULER_TEST, FiresInsideCachedBlocks) {
+	// Initialize system
+	Bus system;
+	FillNops(system);
+	system.cpu.EnableBlockCache(true);
+	uint16_t firedPC = 0;
+	system.cpu.Schedule(7, [&] { firedPC = system.cpu.PC; });
+
+	// Run the expected number of cycles
+	system.cpu.Run(20);
+
+	// Check test correctness
+	EXPECT_EQ(firedPC, 0x8004);
+}
+
+TEST(SCHEDULER_TEST, EventScheduledDuringRunEndsTheSlice) {
+	// Initialize system
+	Bus system;
+	FillNops(system);
+	uint64_t firedAt = 0;
+	system.cpu.Schedule(4, [&] {
+		system.cpu.Schedule(1, [&] { firedAt = system.cpu.Clock(); });
+	});
+
+	// Run the expected number of cycles
+	system.cpu.Run(100);
+
+	// Check test correctness
+	EXPECT_EQ(firedAt, 6u);
+}
@@ -0,0 +1,355 @@
+#pragma once
+#include "logbus.h"
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Single-step conformance cases
+//    Each file of the corpus is an array of cases, one instruction each:
+//        { "name": "a9 8b 2b",
+//          "initial": { "pc": 49152, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36, "ram": [[49152, 169], ...] },
+//          "final":   { ... },
+//          "cycles":  [[49152, 169, "read"], ...] }
+//
+//    Files are parsed a buffer at a time into fixed-size cases, so nothing is allocated per case.
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      PARSER                                                                                        PARSER      */
+/*----------------------------------------------------------------------------------------------------------------*/
+struct SingleStepState {
+	static constexpr int MAX_RAM = 64;
+
+	uint16_t pc = 0;
+	uint8_t  s = 0, a = 0, x = 0, y = 0, p = 0;
+	int      ramCount = 0;
+	uint16_t ramAddr[MAX_RAM];
+	uint8_t  ramData[MAX_RAM];
+};
+
+struct SingleStepCase {
+	static constexpr int MAX_CYCLES = 16;
+
+	char            name[32];
+	SingleStepState initial;
+	SingleStepState expected; // "final"
+	int             cycleCount = 0;
+	LogBus::Access  cycles[MAX_CYCLES];
+};
+
+// Streaming reader for one corpus file. Only the subset of JSON the corpus uses is understood:
+// objects, arrays, strings without escapes and non-negative integers
+class SingleStepReader
+{
+public:
+	explicit SingleStepReader(const std::filesystem::path& path) : file(std::fopen(path.string().c_str(), "rb")) {}
+	~SingleStepReader() {
+		if (file)
+			std::fclose(file);
+	}
+
+	SingleStepReader(const SingleStepReader&) = delete;
+	SingleStepReader& operator=(const SingleStepReader&) = delete;
+
+	// Parse the next case. Returns false at the end of the file or if it is malformed
+	bool Next(SingleStepCase& test) {
+		if (!file || failed)
+			return Fail();
+		SkipSpace();
+		if (!started) {
+			if (!Expect('['))
+				return false;
+			started = true;
+			SkipSpace();
+		}
+		else if (Peek() == ',') {
+			Get();
+			SkipSpace();
+		}
+		if (Peek() == ']')
+			return false;
+		return Case(test);
+	}
+
+	bool Failed() const { return failed || !file; }
+
+private:
+	static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+	std::FILE* file;
+	char   buffer[BUFFER_SIZE];
+	size_t pos = 0;
+	size_t end = 0;
+	bool   started = false;
+	bool   failed = false;
+
+	int Peek() {
+		if (pos == end) {
+			end = std::fread(buffer, 1, BUFFER_SIZE, file);
+			pos = 0;
+			if (end == 0)
+				return EOF;
+		}
+		return static_cast<unsigned char>(buffer[pos]);
+	}
+	int Get() {
+		int c = Peek();
+		if (c != EOF)
+			pos++;
+		return c;
+	}
+
+	bool Fail() {
+		failed = true;
+		return false;
+	}
+
+	void SkipSpace() {
+		for (int c = Peek(); c == ' ' || c == '\n' || c == '\r' || c == '\t'; c = Peek())
+			pos++;
+	}
+
+	bool Expect(char expected) {
+		SkipSpace();
+		return Get() == expected || Fail();
+	}
+
+	// After an element, consume the separator and report whether another element follows
+	bool More(char close) {
+		SkipSpace();
+		int c = Get();
+		if (c == ',')
+			return true;
+		if (c != close)
+			Fail();
+		return false;
+	}
+
+	bool Number(uint32_t& value) {
+		SkipSpace();
+		value = 0;
+		int c = Peek();
+		if (c < '0' || c > '9')
+			return Fail();
+		for (; c >= '0' && c <= '9'; c = Peek()) {
+			value = value * 10 + (c - '0');
+			pos++;
+		}
+		return true;
+	}
+
+	// Copy a string, truncated to fit
+	bool String(char* out, size_t capacity) {
+		if (!Expect('"'))
+			return false;
+		size_t length = 0;
+		for (int c = Get(); c != '"'; c = Get()) {
+			if (c == EOF || c == '\\')
+				return Fail();
+			if (length + 1 < capacity)
+				out[length++] = static_cast<char>(c);
+		}
+		out[length] = '\0';
+		return true;
+	}
+
+	// Skip a value of any type
+	bool Skip() {
+		SkipSpace();
+		int c = Peek();
+		if (c == '"') {
+			char ignored[1];
+			return String(ignored, sizeof(ignored));
+		}
+		if (c == '{' || c == '[') {
+			const char close = (c == '{') ? '}' : ']';
+			Get();
+			SkipSpace();
+			if (Peek() == close) {
+				Get();
+				return true;
+			}
+			do {
+				if (c == '{') {
+					char key[1];
+					if (!String(key, sizeof(key)) || !Expect(':'))
+						return false;
+				}
+				if (!Skip())
+					return false;
+			} while (More(close));
+			return !failed;
+		}
+		for (c = Peek(); c != EOF && c != ',' && c != '}' && c != ']' && !std::isspace(c); c = Peek())
+			pos++;
+		return true;
+	}
+
+	template<typename T>
+	bool Field(T& field) {
+		uint32_t value;
+		if (!Number(value))
+			return false;
+		field = static_cast<T>(value);
+		return true;
+	}
+
+	// Array of [address, value] pairs
+	bool Ram(SingleStepState& state) {
+		state.ramCount = 0;
+		if (!Expect('['))
+			return false;
+		SkipSpace();
+		if (Peek() == ']') {
+			Get();
+			return true;
+		}
+		do {
+			if (state.ramCount == SingleStepState::MAX_RAM)
+				return Fail();
+			const int i = state.ramCount++;
+			if (!Expect('[') || !Field(state.ramAddr[i]) || !Expect(',') || !Field(state.ramData[i]) || !Expect(']'))
+				return false;
+		} while (More(']'));
+		return !failed;
+	}
+
+	bool State(SingleStepState& state) {
+		if (!Expect('{'))
+			return false;
+		do {
+			char key[8];
+			if (!String(key, sizeof(key)) || !Expect(':'))
+				return false;
+			const std::string_view name = key;
+			bool parsed = (name == "pc") ? Field(state.pc)
+				: (name == "s") ? Field(state.s)
+				: (name == "a") ? Field(state.a)
+				: (name == "x") ? Field(state.x)
+				: (name == "y") ? Field(state.y)
+				: (name == "p") ? Field(state.p)
+				: (name == "ram") ? Ram(state)
+				: Skip();
+			if (!parsed)
+				return false;
+		} while (More('}'));
+		return !failed;
+	}
+
+	// Array of [address, value, "read" or "write"]
+	bool Cycles(SingleStepCase& test) {
+		test.cycleCount = 0;
+		if (!Expect('['))
+			return false;
+		SkipSpace();
+		if (Peek() == ']') {
+			Get();
+			return true;
+		}
+		do {
+			if (test.cycleCount == SingleStepCase::MAX_CYCLES)
+				return Fail();
+			LogBus::Access& access = test.cycles[test.cycleCount++];
+			char kind[8];
+			if (!Expect('[') || !Field(access.addr) || !Expect(',') || !Field(access.data) || !Expect(',') ||
+				!String(kind, sizeof(kind)) || !Expect(']'))
+				return false;
+			access.write = (std::string_view(kind) == "write");
+		} while (More(']'));
+		return !failed;
+	}
+
+	bool Case(SingleStepCase& test) {
+		test.name[0] = '\0';
+		if (!Expect('{'))
+			return false;
+		do {
+			char key[16];
+			if (!String(key, sizeof(key)) || !Expect(':'))
+				return false;
+			const std::string_view name = key;
+			bool parsed = (name == "name") ? String(test.name, sizeof(test.name))
+				: (name == "initial") ? State(test.initial)
+				: (name == "final") ? State(test.expected)
+				: (name == "cycles") ? Cycles(test)
+				: Skip();
+			if (!parsed)
+				return false;
+		} while (More('}'));
+		return !failed;
+	}
+};
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      RUNNER                                                                                        RUNNER      */
+/*----------------------------------------------------------------------------------------------------------------*/
+// Bits 4 and 5 are not stored by the chip, so only the six flags are compared
+inline constexpr uint8_t FLAG_MASK = static_cast<uint8_t>(~(MOS6502Core<LogBus>::B | MOS6502Core<LogBus>::U));
+
+inline std::string Describe(const char* what, unsigned expected, unsigned actual) {
+	char text[64];
+	std::snprintf(text, sizeof(text), "%s: expected $%02X, got $%02X", what, expected, actual);
+	return text;
+}
+
+// Run one case, returning an empty string if it passed or why it failed
+inline std::string RunCase(LogBus& system, const SingleStepCase& test) {
+	MOS6502Core<LogBus>& cpu = system.cpu;
+	const SingleStepState& initial = test.initial;
+	const SingleStepState& expected = test.expected;
+
+	for (int i = 0; i < initial.ramCount; i++)
+		system.memory[initial.ramAddr[i]] = initial.ramData[i];
+	cpu.PC = initial.pc;
+	cpu.SP = initial.s;
+	cpu.A = initial.a;
+	cpu.X = initial.x;
+	cpu.Y = initial.y;
+	cpu.P = initial.p;
+	cpu.status = 0;
+	system.ClearLog();
+
+	cpu.Run(1);
+
+	if (cpu.status != 0)
+		return "stopped with status " + std::to_string(cpu.status);
+	if (cpu.PC != expected.pc)
+		return Describe("pc", expected.pc, cpu.PC);
+	if (cpu.SP != expected.s)
+		return Describe("s", expected.s, cpu.SP);
+	if (cpu.A != expected.a)
+		return Describe("a", expected.a, cpu.A);
+	if (cpu.X != expected.x)
+		return Describe("x", expected.x, cpu.X);
+	if (cpu.Y != expected.y)
+		return Describe("y", expected.y, cpu.Y);
+	if ((cpu.P & FLAG_MASK) != (expected.p & FLAG_MASK))
+		return Describe("p", expected.p, cpu.P);
+	for (int i = 0; i < expected.ramCount; i++)
+		if (system.memory[expected.ramAddr[i]] != expected.ramData[i]) {
+			char what[16];
+			std::snprintf(what, sizeof(what), "ram $%04X", expected.ramAddr[i]);
+			return Describe(what, expected.ramData[i], system.memory[expected.ramAddr[i]]);
+		}
+	if (cpu.Cycles != test.cycleCount)
+		return "cycles: expected " + std::to_string(test.cycleCount) + ", took " + std::to_string(cpu.Cycles);
+
+	// The core leaves out the dummy reads and writes of the real chip, so its accesses must appear
+	// in the expected bus activity in order, with the same address, data and direction
+	if (system.logged > LogBus::CAPACITY)
+		return "too many bus accesses";
+	int next = 0;
+	for (size_t i = 0; i < system.logged; i++) {
+		const LogBus::Access& access = system.log[i];
+		while (next < test.cycleCount && (test.cycles[next].addr != access.addr || test.cycles[next].data != access.data ||
+			test.cycles[next].write != access.write))
+			next++;
+		if (next++ == test.cycleCount) {
+			char text[64];
+			std::snprintf(text, sizeof(text), "bus: unexpected %s of $%02X at $%04X, access %zu", access.write ? "write" : "read",
+				access.data, access.addr, i);
+			return text;
+		}
+	}
+	return "";
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "singlestep.h"
+#include <memory>
+#include <string>
+
+// Hand-written cases in the single-step corpus format, checked in so the parser and the case runner
+// are tested without the corpus. Two cases pass; the rest each fail one comparison
+static const std::string CASES = std::string(MOS6502_TEST_DATA_DIR) + "/singlestep/cases.json";
+static const std::string MALFORMED = std::string(MOS6502_TEST_DATA_DIR) + "/singlestep/malformed.json";
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      PARSER                                                                                        PARSER      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(SINGLESTEP_TEST, ParsesCases) {
+	// Initialize reader
+	SingleStepReader reader(CASES);
+	auto test = std::make_unique<SingleStepCase>();
+
+	// Check test correctness
+	ASSERT_TRUE(reader.Next(*test));
+	EXPECT_STREQ(test->name, "a9 8b");
+	EXPECT_EQ(test->initial.pc, 0xC000);
+	EXPECT_EQ(test->initial.s, 0xFD);
+	EXPECT_EQ(test->initial.p, 0x24);
+	ASSERT_EQ(test->initial.ramCount, 2);
+	EXPECT_EQ(test->initial.ramAddr[1], 0xC001);
+	EXPECT_EQ(test->initial.ramData[1], 0x8B);
+	EXPECT_EQ(test->expected.pc, 0xC002);
+	EXPECT_EQ(test->expected.a, 0x8B);
+	EXPECT_EQ(test->expected.p, 0xA4);
+	ASSERT_EQ(test->cycleCount, 2);
+	EXPECT_EQ(test->cycles[1].addr, 0xC001);
+	EXPECT_EQ(test->cycles[1].data, 0x8B);
+	EXPECT_FALSE(test->cycles[1].write);
+
+	// Unknown fields are skipped, whatever they hold
+	ASSERT_TRUE(reader.Next(*test));
+	EXPECT_STREQ(test->name, "e6 10");
+	ASSERT_EQ(test->cycleCount, 5);
+	EXPECT_TRUE(test->cycles[3].write);
+	EXPECT_TRUE(test->cycles[4].write);
+	EXPECT_EQ(test->cycles[4].data, 0x00);
+
+	ASSERT_TRUE(reader.Next(*test));
+	EXPECT_EQ(test->expected.ramCount, 0);
+	ASSERT_TRUE(reader.Next(*test));
+	ASSERT_TRUE(reader.Next(*test));
+	EXPECT_STREQ(test->name, "a5 30 wrong bus");
+	EXPECT_FALSE(reader.Next(*test));
+	EXPECT_FALSE(reader.Failed());
+}
+
+TEST(SINGLESTEP_TEST, RejectsMalformedFile) {
+	// Initialize reader
+	SingleStepReader reader(MALFORMED);
+	auto test = std::make_unique<SingleStepCase>();
+
+	// Check test correctness
+	ASSERT_TRUE(reader.Next(*test));
+	EXPECT_STREQ(test->name, "a9 01");
+	EXPECT_FALSE(reader.Next(*test));
+	EXPECT_TRUE(reader.Failed());
+	EXPECT_FALSE(reader.Next(*test));
+}
+
+TEST(SINGLESTEP_TEST, RejectsMissingFile) {
+	// Initialize reader
+	SingleStepReader reader(std::string(MOS6502_TEST_DATA_DIR) + "/singlestep/missing.json");
+	auto test = std::make_unique<SingleStepCase>();
+
+	// Check test correctness
+	EXPECT_FALSE(reader.Next(*test));
+	EXPECT_TRUE(reader.Failed());
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      RUNNER                                                                                        RUNNER      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(SINGLESTEP_TEST, RunsCases) {
+	// Initialize system
+	auto system = std::make_unique<LogBus>();
+	auto test = std::make_unique<SingleStepCase>();
+	SingleStepReader reader(CASES);
+	std::string results[5];
+
+	// Run every case on the same bus, as the corpus workers do
+	for (std::string& result : results) {
+		ASSERT_TRUE(reader.Next(*test));
+		result = RunCase(*system, *test);
+	}
+
+	// Check test correctness
+	EXPECT_EQ(results[0], "");
+	EXPECT_EQ(results[1], ""); // The dummy write of the old value is allowed to be missing
+	EXPECT_EQ(results[2], "x: expected $06, got $05");
+	EXPECT_EQ(results[3], "ram $0020: expected $43, got $42");
+	EXPECT_EQ(results[4], "bus: unexpected read of $07 at $0030, access 2");
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "farm.h"
+#include "instructions.h"
+#include "exitcodes.h"
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      SNAPSHOT                                                                                    SNAPSHOT      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(SNAPSHOT_TEST, RestoreReturnsRegistersAndMemory) {
+	// Initialize system
+	Bus system;
+	system.cpu.A = 0x42;
+	system.cpu.X = 0x17;
+	system.cpu.P = 0b11000001;
+
+	// Initialize memory
+	system.rom[0x0000] = INS_STA_ZP;
+	system.rom[0x0001] = 0x10;
+	system.rom[0x0002] = INS_INX;
+	system.ram[0x1234] = 0x99;
+
+	// Run the expected number of cycles
+	Snapshot snapshot = system.TakeSnapshot();
+	system.cpu.Run(5);
+	system.ram[0x1234] = 0x00;
+	system.rom[0x0002] = INS_DEX;
+	system.Restore(snapshot);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.PC, 0x8000);
+	EXPECT_EQ(system.cpu.A, 0x42);
+	EXPECT_EQ(system.cpu.X, 0x17);
+	EXPECT_EQ(system.cpu.P, 0b11000001);
+	EXPECT_EQ(system.ram[0x0010], 0xFF);
+	EXPECT_EQ(system.ram[0x1234], 0x99);
+	EXPECT_EQ(system.rom[0x0002], INS_INX);
+}
+
+TEST(SNAPSHOT_TEST, SnapshotsShareUnchangedPages) {
+	// Initialize system
+	Bus system;
+	Snapshot base = system.TakeSnapshot();
+
+	// Initialize memory
+	system.ram[0x0010] = 0x01;
+	system.ram[0x2000] = 0x02;
+
+	// Check test correctness
+	Snapshot fork = system.TakeSnapshot();
+	EXPECT_EQ(fork.SharedPages(base), Snapshot::PAGES - 2);
+	EXPECT_NE(fork.pages[0x00], base.pages[0x00]);
+	EXPECT_NE(fork.pages[0x20], base.pages[0x20]);
+	EXPECT_EQ((*base.pages[0x00])[0x10], 0xFF);
+	EXPECT_EQ((*fork.pages[0x00])[0x10], 0x01);
+}
+
+TEST(SNAPSHOT_TEST, RestoredCodeIsNotServedFromTheBlockCache) {
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+
+	// Initialize memory
+	system.ram[0x0200] = INS_LDA_IM;
+	system.ram[0x0201] = 0x11;
+	system.ram[0x0202] = 0x02;
+	Snapshot snapshot = system.TakeSnapshot();
+
+	// Run the expected number of cycles
+	system.ram[0x0201] = 0x22;
+	system.cpu.PC = 0x0200;
+	system.cpu.Run(2);
+	EXPECT_EQ(system.cpu.A, 0x22);
+	system.Restore(snapshot);
+	system.cpu.PC = 0x0200;
+	system.cpu.Run(2);
+
+	// Check test correctness
+	EXPECT_EQ(system.cpu.A, 0x11);
+}
+
+TEST(SNAPSHOT_TEST, FarmJobsForkFromASnapshot) {
+	// Initialize system
+	Bus system;
+	system.rom[0x0000] = INS_ADC_ZP;
+	system.rom[0x0001] = 0x10;
+	system.rom[0x0002] = INS_STA_ZP;
+	system.rom[0x0003] = 0x11;
+	system.rom[0x0004] = 0x02;
+	system.ram[0x0010] = 0x05;
+	auto snapshot = std::make_shared<const Snapshot>(system.TakeSnapshot());
+
+	// Run the expected number of cycles
+	SystemFarm farm(2);
+	std::vector<std::future<FarmResult>> results;
+	for (int i = 0; i < 8; i++) {
+		FarmJob job;
+		job.snapshot = snapshot;
+		job.cycles = 100;
+		job.captureRam = true;
+		results.push_back(farm.Submit(job));
+	}
+
+	// Check test correctness
+	for (auto& future : results) {
+		FarmResult result = future.get();
+		EXPECT_EQ(result.exitCode, E_INV);
+		EXPECT_EQ(result.A, 0x05);
+		EXPECT_EQ(result.ram[0x11], 0x05);
+	}
+}
@@ -152,4 +152,49 @@ TEST(SEI_TEST, SetsInterruptFlag) {
 	EXPECT_EQ(status, 0);
 	EXPECT_EQ(system.cpu.PC, 0x8001);
 	EXPECT_EQ(system.cpu.P, system.cpu.I);
-}
\ No newline at end of file
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      STATUS                                                                                        STATUS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(STATUS_TEST, ExternallySetFlagsAreSeenByBranches) {
+	// 2 Bytes, 3 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.P = system.cpu.Z | system.cpu.N;
+
+	// Initialize memory
+	system.rom[0] = INS_BEQ;
+	system.rom[1] = 0x10;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(3);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8012);
+	EXPECT_EQ(system.cpu.P, system.cpu.Z | system.cpu.N);
+}
+
+TEST(STATUS_TEST, FlagsPersistBetweenRuns) {
+	// 2 + 1 Bytes, 2 + 3 Cycles
+
+	// Initialize system
+	Bus system;
+
+	// Initialize memory
+	system.rom[0] = INS_LDA_IM;
+	system.rom[1] = 0x80;
+	system.rom[2] = INS_PHP;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(2);
+	EXPECT_EQ(system.cpu.P, system.cpu.N);
+	status = system.cpu.Run(3);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8003);
+	EXPECT_EQ(system.ram[0x1FF], system.cpu.N);
+}
@@ -2,6 +2,8 @@
 #include "bus.h"
 #include "MOS6502.h"
 #include "instructions.h"
+#include "exitcodes.h"
+#include "decode.h"
 
 /*----------------------------------------------------------------------------------------------------------------*/
 /*      BRK                                                                                              BRK      */
@@ -232,4 +234,34 @@ TEST(RTI_TEST, CorrectlyPullsInfoFromStack) {
 	EXPECT_EQ(system.ram[0x1FE], 0x02);
 	EXPECT_EQ(system.ram[0x1FD], 0b11011111);
 	EXPECT_EQ(system.cpu.SP, 0xFF);
-}
\ No newline at end of file
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      INVALID                                                                                      INVALID      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(INVALID_TEST, StopsOnUndefinedOpcode) {
+	// 1 Bytes, 1 Cycles
+
+	// Initialize system
+	Bus system;
+
+	// Initialize memory
+	system.rom[0] = 0x02;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(2);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_INV);
+	EXPECT_EQ(system.cpu.PC, 0x8001);
+}
+
+TEST(INVALID_TEST, DecodeTableMatchesOpcodeConstants) {
+	// Check test correctness
+	EXPECT_EQ(decode_table[INS_LDA_IM].instruction, Instruction::LDA);
+	EXPECT_EQ(decode_table[INS_LDA_IM].mode, IMMEDIATE);
+	EXPECT_EQ(decode_table[INS_JMP_IND].instruction, Instruction::JMP);
+	EXPECT_EQ(decode_table[INS_JMP_IND].mode, ABS_INDIRECT);
+	EXPECT_EQ(decode_table[INS_BRK].instruction, Instruction::BRK);
+	EXPECT_EQ(decode_table[0xFF].instruction, Instruction::INVALID);
+}
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "device.h"
+#include "timetravel.h"
+#include "instructions.h"
+#include <cstring>
+#include <memory>
+
+// Device answering reads with a pseudo-random sequence, and raising IRQ on every 64th read
+class TimerDevice : public Device
+{
+public:
+	MOS6502* cpu = nullptr;
+	uint32_t state = 99;
+	int      reads = 0;
+
+	uint8_t read(uint16_t) override {
+		if (++reads % 64 == 0)
+			cpu->SetIRQ(true);
+		state = state * 1103515245 + 12345;
+		return static_cast<uint8_t>(state >> 16);
+	}
+	void write(uint16_t, uint8_t) override { cpu->SetIRQ(false); }
+};
+
+// A system that mixes device reads into a checksum at 0x10 and counts interrupts at 0x11
+struct TimeSystem {
+	Bus         system;
+	TimerDevice device;
+
+	TimeSystem() {
+		device.cpu = &system.cpu;
+		system.MapDevice(0x40, 0x40, &device);
+		std::memset(system.ram, 0, sizeof(system.ram));
+
+		const uint8_t main[] = {
+			INS_CLI, INS_LDA_ABS, 0x00, 0x40, INS_EOR_ZP, 0x10, INS_ASL_ACC, INS_ADC_IM, 0x01, INS_STA_ZP, 0x10,
+			INS_INX, INS_JMP_ABS, 0x01, 0x80
+		};
+		const uint8_t irq[] = { INS_INC_ZP, 0x11, INS_STA_ABS, 0x00, 0x40, INS_RTI };
+		std::memcpy(&system.rom[0x0000], main, sizeof(main));
+		std::memcpy(&system.rom[0x1000], irq, sizeof(irq));
+		system.vectors[4] = 0x00;
+		system.vectors[5] = 0x90;
+	}
+};
+
+// State of a fresh system run straight to the given cycle, one instruction at a time
+static std::unique_ptr<TimeSystem> Reference(uint64_t cycle) {
+	auto reference = std::make_unique<TimeSystem>();
+	while (reference->system.cpu.Clock() < cycle)
+		reference->system.cpu.Run(1);
+	return reference;
+}
+
+static void ExpectSameState(const Bus& system, const Bus& reference) {
+	EXPECT_EQ(system.cpu.Clock(), reference.cpu.Clock());
+	EXPECT_EQ(system.cpu.PC, reference.cpu.PC);
+	EXPECT_EQ(system.cpu.A, reference.cpu.A);
+	EXPECT_EQ(system.cpu.X, reference.cpu.X);
+	EXPECT_EQ(system.cpu.P, reference.cpu.P);
+	EXPECT_EQ(system.cpu.SP, reference.cpu.SP);
+	EXPECT_EQ(std::memcmp(system.ram, reference.ram, sizeof(system.ram)), 0);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      TIME TRAVEL                                                                              TIME TRAVEL      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(TIMETRAVEL_TEST, SeeksBackThroughReplayedInputs) {
+	// Initialize system
+	TimeSystem machine;
+	TimeTravel history(machine.system, 1000);
+
+	// Run the expected number of cycles
+	machine.system.cpu.Run(50000);
+	const uint64_t present = machine.system.cpu.Clock();
+	ASSERT_TRUE(history.Seek(12345));
+
+	// Check test correctness
+	EXPECT_EQ(machine.system.cpu.status, 0);
+	EXPECT_TRUE(history.InPast());
+	EXPECT_EQ(history.Present(), present);
+	EXPECT_GT(machine.system.ram[0x11], 0);
+	ExpectSameState(machine.system, Reference(12345)->system);
+	EXPECT_FALSE(history.Seek(present + 1));
+}
+
+TEST(TIMETRAVEL_TEST, RunningPastThePresentResumesRecording) {
+	// Initialize system
+	TimeSystem machine;
+	TimeTravel history(machine.system, 1000);
+
+	// Run the expected number of cycles
+	machine.system.cpu.Run(20000);
+	const uint64_t present = machine.system.cpu.Clock();
+	ASSERT_TRUE(history.Seek(5000));
+	machine.system.cpu.Run(static_cast<int32_t>(present - machine.system.cpu.Clock() + 10000));
+
+	// Check test correctness
+	EXPECT_EQ(machine.system.cpu.status, 0);
+	EXPECT_FALSE(history.InPast());
+	ExpectSameState(machine.system, Reference(machine.system.cpu.Clock())->system);
+	ASSERT_TRUE(history.Seek(present + 5000));
+	ExpectSameState(machine.system, Reference(present + 5000)->system);
+}
+
+TEST(TIMETRAVEL_TEST, ReverseStepGoesBackOneInstruction) {
+	// Initialize system
+	TimeSystem machine;
+	TimeTravel history(machine.system, 1000);
+
+	// Run the expected number of cycles
+	machine.system.cpu.Run(3000);
+	auto reference = std::make_unique<TimeSystem>();
+	uint64_t previous = 0;
+	while (reference->system.cpu.Clock() < machine.system.cpu.Clock()) {
+		previous = reference->system.cpu.Clock();
+		reference->system.cpu.Run(1);
+	}
+	ASSERT_TRUE(history.ReverseStep());
+
+	// Check test correctness
+	EXPECT_EQ(machine.system.cpu.Clock(), previous);
+	ExpectSameState(machine.system, Reference(previous)->system);
+}
+
+TEST(TIMETRAVEL_TEST, ReverseContinueFindsLatestMatch) {
+	// Initialize system
+	TimeSystem machine;
+	TimeTravel history(machine.system, 1000);
+	auto interrupted = [&] { return machine.system.cpu.PC == 0x9000; };
+
+	// Find the last interrupt entry in a reference run
+	auto reference = std::make_unique<TimeSystem>();
+	uint64_t last = 0;
+	while (reference->system.cpu.Clock() < 30000) {
+		if (reference->system.cpu.PC == 0x9000)
+			last = reference->system.cpu.Clock();
+		reference->system.cpu.Run(1);
+	}
+	ASSERT_NE(last, 0u);
+
+	// Run the expected number of cycles
+	machine.system.cpu.Run(static_cast<int32_t>(reference->system.cpu.Clock()));
+	ASSERT_TRUE(history.ReverseContinue(interrupted));
+
+	// Check test correctness
+	EXPECT_EQ(machine.system.cpu.Clock(), last);
+	EXPECT_EQ(machine.system.cpu.PC, 0x9000);
+	EXPECT_FALSE(history.ReverseContinue([] { return false; }));
+	EXPECT_EQ(machine.system.cpu.Clock(), last);
+}
+
+TEST(TIMETRAVEL_TEST, ThinsCheckpointsOnLongRuns) {
+	// Initialize system
+	TimeSystem machine;
+	TimeTravel history(machine.system, 100, 8);
+
+	// Run the expected number of cycles
+	for (int i = 0; i < 20; i++)
+		machine.system.cpu.Run(5000);
+	ASSERT_TRUE(history.Seek(150));
+
+	// Check test correctness
+	EXPECT_LE(history.Checkpoints(), 8u);
+	EXPECT_GE(history.Interval(), 100u * 64);
+	ExpectSameState(machine.system, Reference(150)->system);
+}
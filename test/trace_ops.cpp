@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "trace.h"
+#include "instructions.h"
+#include "exitcodes.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Fill the first page of ROM with NOPs followed by a jump back to 0x8000, a 515 cycle loop
+static void InitializeLoop(Bus& system) {
+	std::memset(system.rom, INS_NOP, 0x100);
+	system.rom[0x100] = INS_JMP_ABS;
+	system.rom[0x101] = 0x00;
+	system.rom[0x102] = 0x80;
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      TRACE                                                                                          TRACE      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(TRACE_TEST, RecordsStateBeforeEachInstruction) {
+	// Initialize system
+	Bus system;
+	Trace trace(0);
+	system.cpu.AttachTrace(&trace);
+	system.cpu.SP = 0xFD;
+	system.cpu.P = MOS6502::C;
+
+	// Initialize memory
+	system.rom[0] = INS_LDA_IM;
+	system.rom[1] = 0x80;
+	system.rom[2] = INS_TAX;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(4);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	std::vector<Trace::Entry> entries = trace.Entries();
+	ASSERT_EQ(entries.size(), 2u);
+	EXPECT_EQ(entries[0].pc, 0x8000);
+	EXPECT_EQ(entries[0].opcode, INS_LDA_IM);
+	EXPECT_EQ(entries[0].operands[0], 0x80);
+	EXPECT_EQ(entries[0].operands[1], INS_TAX);
+	EXPECT_EQ(entries[0].Cycle(), 0u);
+	EXPECT_EQ(entries[1].pc, 0x8002);
+	EXPECT_EQ(entries[1].opcode, INS_TAX);
+	EXPECT_EQ(entries[1].A, 0x80);
+	EXPECT_EQ(entries[1].X, 0x00);
+	EXPECT_EQ(entries[1].SP, 0xFD);
+	EXPECT_EQ(entries[1].P, MOS6502::C | MOS6502::N);
+	EXPECT_EQ(entries[1].Cycle(), 2u);
+}
+
+TEST(TRACE_TEST, KeepsTheMostRecentEntries) {
+	// Initialize system
+	Bus system;
+	InitializeLoop(system);
+	Trace trace(0);
+	system.cpu.EnableBlockCache(true);
+	system.cpu.AttachTrace(&trace);
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(515 * 40);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(trace.Recorded(), 257u * 40);
+	EXPECT_EQ(trace.Size(), trace.Capacity());
+	std::vector<Trace::Entry> entries = trace.Entries();
+	EXPECT_EQ(entries.back().pc, 0x8100);
+	EXPECT_EQ(entries.back().Cycle(), 515u * 40 - 3);
+
+	std::ostringstream dump;
+	trace.Dump(dump);
+	EXPECT_EQ(dump.str().size(), trace.Capacity() * sizeof(Trace::Entry));
+	EXPECT_EQ(std::memcmp(dump.str().data(), entries.data(), dump.str().size()), 0);
+}
+
+TEST(TRACE_TEST, StreamsEveryEntryToFile) {
+	// Initialize system
+	Bus system;
+	InitializeLoop(system);
+	Trace trace(0);
+	system.cpu.AttachTrace(&trace);
+	std::string path = (std::filesystem::temp_directory_path() / "mos6502_trace.bin").string();
+	ASSERT_TRUE(trace.StreamTo(path));
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(515 * 100);
+	trace.StopStreaming();
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	std::ifstream file(path, std::ios::binary);
+	std::vector<Trace::Entry> entries(trace.Recorded() + 1);
+	file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(Trace::Entry));
+	ASSERT_EQ(static_cast<size_t>(file.gcount()), trace.Recorded() * sizeof(Trace::Entry));
+
+	uint64_t cycle = 0;
+	for (size_t i = 0; i < trace.Recorded(); i++) {
+		ASSERT_EQ(entries[i].Cycle(), cycle);
+		cycle += (entries[i].opcode == INS_JMP_ABS) ? 3 : 2;
+	}
+	EXPECT_EQ(cycle, 515u * 100);
+}
+
+TEST(TRACE_TEST, RecordsAnInstructionResumedFromABreakpointOnce) {
+	// Initialize system
+	Bus system;
+	Trace trace(0);
+	system.cpu.AttachTrace(&trace);
+	system.SetBreakpoint(0x8002);
+
+	// Initialize memory
+	system.rom[0] = INS_LDA_IM;
+	system.rom[1] = 0x42;
+	system.rom[2] = INS_TAX;
+	system.rom[3] = INS_INX;
+
+	// Run the expected number of cycles
+	int stopped = system.cpu.Run(6);
+	system.cpu.status = 0;
+	int status = system.cpu.Run(4);
+
+	// Check test correctness
+	EXPECT_EQ(stopped, E_BREAK);
+	EXPECT_EQ(status, 0);
+	std::vector<Trace::Entry> entries = trace.Entries();
+	ASSERT_EQ(entries.size(), 3u);
+	EXPECT_EQ(entries[0].pc, 0x8000);
+	EXPECT_EQ(entries[1].pc, 0x8002);
+	EXPECT_EQ(entries[1].opcode, INS_TAX);
+	EXPECT_EQ(entries[1].operands[0], INS_INX);
+	EXPECT_EQ(entries[1].Cycle(), 2u);
+	EXPECT_EQ(entries[2].pc, 0x8003);
+	EXPECT_EQ(entries[2].X, 0x42);
+}
+
+TEST(TRACE_TEST, RecordsTheSameThroughTheJit) {
+	// Initialize system
+	Bus plain;
+	Bus compiled;
+	InitializeLoop(plain);
+	InitializeLoop(compiled);
+	Trace plainTrace(0);
+	Trace compiledTrace(0);
+	plain.cpu.EnableBlockCache(false);
+	plain.cpu.EnableJit(false);
+	compiled.cpu.EnableJit(true, 0);
+	plain.cpu.AttachTrace(&plainTrace);
+	compiled.cpu.AttachTrace(&compiledTrace);
+
+	// Run the expected number of cycles
+	int plainStatus = plain.cpu.Run(515 * 10);
+	int compiledStatus = compiled.cpu.Run(515 * 10);
+
+	// Check test correctness
+	EXPECT_EQ(plainStatus, 0);
+	EXPECT_EQ(compiledStatus, 0);
+	ASSERT_EQ(plainTrace.Recorded(), 257u * 10);
+	ASSERT_EQ(compiledTrace.Recorded(), plainTrace.Recorded());
+	std::vector<Trace::Entry> expected = plainTrace.Entries();
+	std::vector<Trace::Entry> actual = compiledTrace.Entries();
+	EXPECT_EQ(std::memcmp(actual.data(), expected.data(), actual.size() * sizeof(Trace::Entry)), 0);
+}
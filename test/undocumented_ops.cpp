@@ -0,0 +1,367 @@
+#include <gtest/gtest.h>
+#include "MOS6502.h"
+#include "bus.h"
+#include "decode.h"
+#include "instructions.h"
+#include "exitcodes.h"
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      DECODE                                                                                        DECODE      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(UNDOCUMENTED_TEST, StopsUnlessEnabled) {
+	// 2 Bytes, 3 Cycles
+
+	// Initialize system
+	Bus system;
+
+	// Initialize memory
+	system.rom[0] = INS_LAX_ZP;
+	system.rom[1] = 0x10;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(3);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_INV);
+	EXPECT_FALSE(system.cpu.UndocumentedEnabled());
+}
+
+TEST(UNDOCUMENTED_TEST, JamOpcodesStillStop) {
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+
+	// Initialize memory
+	system.rom[0] = 0x02;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(2);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_INV);
+	EXPECT_EQ(nmos_decode_table[0x02].instruction, Instruction::INVALID);
+	EXPECT_EQ(nmos_decode_table[0xAB].instruction, Instruction::INVALID); // Unstable LAX #imm
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      LAX / SAX                                                                                  LAX / SAX      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(LAX_TEST, IndirectYWithPageCross) {
+	// 2 Bytes, 6 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.Y = 0x10;
+
+	// Initialize memory
+	system.rom[0] = INS_LAX_INDY;
+	system.rom[1] = 0x20;
+	system.ram[0x20] = 0xF8;
+	system.ram[0x21] = 0x40;
+	system.ram[0x4108] = 0x85;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(6);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	EXPECT_EQ(system.cpu.A, 0x85);
+	EXPECT_EQ(system.cpu.X, 0x85);
+	EXPECT_EQ(system.cpu.P, system.cpu.N);
+}
+
+TEST(SAX_TEST, ZeroPageY) {
+	// 2 Bytes, 4 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.A = 0b11001100;
+	system.cpu.X = 0b10101010;
+	system.cpu.Y = 0x02;
+
+	// Initialize memory
+	system.rom[0] = INS_SAX_ZPY;
+	system.rom[1] = 0x40;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(4);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	EXPECT_EQ(system.ram[0x42], 0b10001000);
+	EXPECT_EQ(system.cpu.P, 0);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      READ-MODIFY-WRITE                                                                  READ-MODIFY-WRITE      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(DCP_TEST, AbsoluteX) {
+	// 3 Bytes, 7 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.A = 0x40;
+	system.cpu.X = 0x01;
+
+	// Initialize memory
+	system.rom[0] = INS_DCP_ABSX;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0x30;
+	system.ram[0x3001] = 0x41;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(7);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8003);
+	EXPECT_EQ(system.ram[0x3001], 0x40);
+	EXPECT_EQ(system.cpu.P, system.cpu.Z | system.cpu.C);
+}
+
+TEST(ISC_TEST, ZeroPage) {
+	// 2 Bytes, 5 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.A = 0x50;
+	system.cpu.P = system.cpu.C;
+
+	// Initialize memory
+	system.rom[0] = INS_ISC_ZP;
+	system.rom[1] = 0x10;
+	system.ram[0x10] = 0x0F;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(5);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.ram[0x10], 0x10);
+	EXPECT_EQ(system.cpu.A, 0x40);
+	EXPECT_EQ(system.cpu.P, system.cpu.C);
+}
+
+TEST(ISC_TEST, ClearsCarryFlagOnBorrow) {
+	// 2 Bytes, 5 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.A = 0x05;
+	system.cpu.P = system.cpu.C;
+
+	// Initialize memory
+	system.rom[0] = INS_ISC_ZP;
+	system.rom[1] = 0x10;
+	system.ram[0x10] = 0x0F;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(5);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.ram[0x10], 0x10);
+	EXPECT_EQ(system.cpu.A, 0xF5);
+	EXPECT_EQ(system.cpu.P, system.cpu.N);
+}
+
+TEST(SLO_TEST, IndirectX) {
+	// 2 Bytes, 8 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.A = 0x01;
+	system.cpu.X = 0x04;
+
+	// Initialize memory
+	system.rom[0] = INS_SLO_INDX;
+	system.rom[1] = 0x20;
+	system.ram[0x24] = 0x00;
+	system.ram[0x25] = 0x30;
+	system.ram[0x3000] = 0xC0;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(8);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	EXPECT_EQ(system.ram[0x3000], 0x80);
+	EXPECT_EQ(system.cpu.A, 0x81);
+	EXPECT_EQ(system.cpu.P, system.cpu.C | system.cpu.N);
+}
+
+TEST(RLA_TEST, ZeroPageX) {
+	// 2 Bytes, 6 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.A = 0x0F;
+	system.cpu.X = 0x01;
+	system.cpu.P = system.cpu.C;
+
+	// Initialize memory
+	system.rom[0] = INS_RLA_ZPX;
+	system.rom[1] = 0x10;
+	system.ram[0x11] = 0x05;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(6);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.ram[0x11], 0x0B);
+	EXPECT_EQ(system.cpu.A, 0x0B);
+	EXPECT_EQ(system.cpu.P, 0);
+}
+
+TEST(SRE_TEST, Absolute) {
+	// 3 Bytes, 6 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.A = 0xFF;
+
+	// Initialize memory
+	system.rom[0] = INS_SRE_ABS;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0x12;
+	system.ram[0x1200] = 0x03;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(6);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8003);
+	EXPECT_EQ(system.ram[0x1200], 0x01);
+	EXPECT_EQ(system.cpu.A, 0xFE);
+	EXPECT_EQ(system.cpu.P, system.cpu.C | system.cpu.N);
+}
+
+TEST(RRA_TEST, AbsoluteY) {
+	// 3 Bytes, 7 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.A = 0x10;
+	system.cpu.Y = 0xFF;
+
+	// Initialize memory
+	system.rom[0] = INS_RRA_ABSY;
+	system.rom[1] = 0x01;
+	system.rom[2] = 0x20;
+	system.ram[0x2100] = 0x05;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(7);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8003);
+	EXPECT_EQ(system.ram[0x2100], 0x02);
+	EXPECT_EQ(system.cpu.A, 0x13); // 0x10 + 0x02 + the carry shifted out
+	EXPECT_EQ(system.cpu.P, 0);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      IMMEDIATE                                                                                  IMMEDIATE      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(UNDOCUMENTED_TEST, ImmediateCombinations) {
+	// 2 Bytes, 2 Cycles each
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.A = 0xF0;
+	system.cpu.X = 0x3C;
+
+	// Initialize memory
+	system.rom[0] = INS_ANC_IM_0B;
+	system.rom[1] = 0x8F;  // A = 0x80, C = 1
+	system.rom[2] = INS_ALR_IM;
+	system.rom[3] = 0xFF;  // A = 0x40, C = 0
+	system.rom[4] = INS_ARR_IM;
+	system.rom[5] = 0xC0;  // A = 0x20, C = 0, V = 1
+	system.rom[6] = INS_SBX_IM;
+	system.rom[7] = 0x01;  // X = (0x20 & 0x3C) - 1 = 0x1F, C = 1
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(8);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.PC, 0x8008);
+	EXPECT_EQ(system.cpu.A, 0x20);
+	EXPECT_EQ(system.cpu.X, 0x1F);
+	EXPECT_EQ(system.cpu.P, system.cpu.C | system.cpu.V);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      NOP                                                                                              NOP      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(UNDOCUMENTED_TEST, NopsSkipTheirOperands) {
+	// 1 + 2 + 2 + 2 + 3 + 3 Bytes, 2 + 2 + 3 + 4 + 4 + 5 Cycles
+
+	// Initialize system
+	Bus system;
+	system.cpu.EnableUndocumented(true);
+	system.cpu.X = 0x01;
+
+	// Initialize memory
+	system.rom[0] = INS_NOP_1A;
+	system.rom[1] = INS_NOP_IM_80;
+	system.rom[2] = 0xFF;
+	system.rom[3] = INS_NOP_ZP_04;
+	system.rom[4] = 0x10;
+	system.rom[5] = INS_NOP_ZPX_14;
+	system.rom[6] = 0x10;
+	system.rom[7] = INS_NOP_ABS_0C;
+	system.rom[8] = 0x00;
+	system.rom[9] = 0x20;
+	system.rom[10] = INS_NOP_ABSX_1C;
+	system.rom[11] = 0xFF;
+	system.rom[12] = 0x20;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(20);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.Cycles, 20);
+	EXPECT_EQ(system.cpu.PC, 0x800D);
+	EXPECT_EQ(system.cpu.P, 0);
+}
+
+TEST(UNDOCUMENTED_TEST, SwitchingDropsCachedBlocks) {
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+
+	// Initialize memory
+	system.rom[0] = INS_LAX_ZP;
+	system.rom[1] = 0x10;
+	system.ram[0x10] = 0x42;
+
+	// Run the expected number of cycles
+	EXPECT_EQ(system.cpu.Run(3), E_INV);
+	system.cpu.status = 0;
+	system.cpu.PC = 0x8000;
+	system.cpu.EnableUndocumented(true);
+	int status = system.cpu.Run(3);
+
+	// Check test correctness
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(system.cpu.X, 0x42);
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include "bus.h"
+#include "instructions.h"
+#include "exitcodes.h"
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      BREAKPOINTS                                                                              BREAKPOINTS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(BREAKPOINT_TEST, StopsBeforeTheInstruction) {
+	// Initialize system
+	Bus system;
+	system.SetBreakpoint(0x8002);
+
+	// Initialize memory
+	system.rom[0] = INS_LDA_IM;
+	system.rom[1] = 0x01;
+	system.rom[2] = INS_LDX_IM;
+	system.rom[3] = 0x02;
+	system.rom[4] = INS_LDY_IM;
+	system.rom[5] = 0x03;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(100);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_BREAK);
+	EXPECT_EQ(system.LastHit(), 0x8002);
+	EXPECT_EQ(system.cpu.PC, 0x8002);
+	EXPECT_EQ(system.cpu.Cycles, 2);
+	EXPECT_EQ(system.cpu.A, 0x01);
+	EXPECT_NE(system.cpu.X, 0x02);
+}
+
+TEST(BREAKPOINT_TEST, ResumesAndStopsOnTheNextVisit) {
+	// Initialize system
+	Bus system;
+	system.cpu.X = 0x00;
+	system.SetBreakpoint(0x8000);
+
+	// Initialize memory
+	system.rom[0] = INS_INX;
+	system.rom[1] = INS_JMP_ABS;
+	system.rom[2] = 0x00;
+	system.rom[3] = 0x80;
+
+	// Run the expected number of cycles
+	EXPECT_EQ(system.cpu.Run(100), E_BREAK);
+	EXPECT_EQ(system.cpu.X, 0x00);
+	system.cpu.status = 0;
+	int status = system.cpu.Run(100);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_BREAK);
+	EXPECT_EQ(system.cpu.Cycles, 5);
+	EXPECT_EQ(system.cpu.X, 0x01);
+	EXPECT_EQ(system.cpu.Clock(), 5u);
+}
+
+TEST(BREAKPOINT_TEST, DropsCachedBlocksOnThePage) {
+	// Initialize system
+	Bus system;
+	system.cpu.EnableJit(true, 0);
+	system.cpu.Y = 0x00;
+
+	// Initialize memory
+	system.rom[0] = INS_INY;
+	system.rom[1] = INS_INX;
+	system.rom[2] = INS_JMP_ABS;
+	system.rom[3] = 0x00;
+	system.rom[4] = 0x80;
+
+	// Run the expected number of cycles
+	EXPECT_EQ(system.cpu.Run(70), 0);
+	system.SetBreakpoint(0x8001);
+	int status = system.cpu.Run(100);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_BREAK);
+	EXPECT_EQ(system.cpu.PC, 0x8001);
+	EXPECT_EQ(system.cpu.Y, 11);
+	system.SetBreakpoint(0x8001, false);
+	EXPECT_FALSE(system.Breakpoint(0x8001));
+	system.cpu.status = 0;
+	EXPECT_EQ(system.cpu.Run(7), 0);
+}
+
+/*----------------------------------------------------------------------------------------------------------------*/
+/*      WATCHPOINTS                                                                              WATCHPOINTS      */
+/*----------------------------------------------------------------------------------------------------------------*/
+TEST(WATCHPOINT_TEST, ReadStopsAfterTheInstruction) {
+	// Initialize system
+	Bus system;
+	system.SetReadWatch(0x1234);
+
+	// Initialize memory
+	system.ram[0x1233] = 0x11;
+	system.ram[0x1234] = 0x22;
+	system.rom[0] = INS_LDA_ABS;
+	system.rom[1] = 0x33;
+	system.rom[2] = 0x12;
+	system.rom[3] = INS_LDX_ABS;
+	system.rom[4] = 0x34;
+	system.rom[5] = 0x12;
+	system.rom[6] = INS_NOP;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(100);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_WATCHR);
+	EXPECT_EQ(system.LastHit(), 0x1234);
+	EXPECT_EQ(system.cpu.PC, 0x8006);
+	EXPECT_EQ(system.cpu.A, 0x11);
+	EXPECT_EQ(system.cpu.X, 0x22);
+	EXPECT_EQ(system.cpu.Cycles, 8);
+}
+
+TEST(WATCHPOINT_TEST, WriteStopsAfterTheStore) {
+	// Initialize system
+	Bus system;
+	system.cpu.EnableBlockCache(true);
+	system.cpu.A = 0x77;
+	system.SetWriteWatch(0x0200);
+
+	// Initialize memory
+	system.rom[0] = INS_STA_ABS;
+	system.rom[1] = 0x00;
+	system.rom[2] = 0x02;
+	system.rom[3] = INS_STA_ABS;
+	system.rom[4] = 0x01;
+	system.rom[5] = 0x02;
+
+	// Run the expected number of cycles
+	int status = system.cpu.Run(100);
+
+	// Check test correctness
+	EXPECT_EQ(status, E_WATCHW);
+	EXPECT_EQ(system.LastHit(), 0x0200);
+	EXPECT_EQ(system.cpu.PC, 0x8003);
+	EXPECT_EQ(system.ram[0x0200], 0x77);
+	system.ClearWatches();
+	EXPECT_FALSE(system.WriteWatch(0x0200));
+	system.cpu.status = 0;
+	EXPECT_EQ(system.cpu.Run(4), 0);
+	EXPECT_EQ(system.ram[0x0201], 0x77);
+}